@@ -184,12 +184,16 @@ namespace sofs18
         printf("   Total number of data blocks: %u\n", sbp->dz_total);
         printf("   Number of free data blocks: %u\n", sbp->dz_free);
         printf("   Head of list of free data blocks: ");
-        if (sbp->fblt_head == NullReference) 
+        if (sbp->fblt_head == FREE_BLOCK_BITMAP)
+            printf("(bitmap)\n");
+        else if (sbp->fblt_head == NullReference)
             printf("(nil)\n");
         else
             printf("%" PRIu32 "\n", sbp->fblt_head);
         printf("   Tail of list of free data blocks: ");
-        if (sbp->fblt_tail == NullReference) 
+        if (sbp->fblt_tail == FREE_BLOCK_BITMAP)
+            printf("(bitmap)\n");
+        else if (sbp->fblt_tail == NullReference)
             printf("(nil)\n");
         else
             printf("%" PRIu32 "\n", sbp->fblt_tail);
@@ -320,6 +324,29 @@ namespace sofs18
             printf("ctime = %s\n", timebuf);
         }
 
+        /* print extents, for an inode mapped by them */
+        if (ip->i2[N_DOUBLE_INDIRECT - 1] == INODE_EXTENTS)
+        {
+            SOInodeExtents *ie = (SOInodeExtents *)ip->d;
+            printf("extent[*] = {");
+            for (int i = 0; i < N_INLINE_EXTENTS; i++) {
+                if (i > 0)
+                    printf(" ");
+                if (ie->extent[i].count == 0)
+                    printf("(nil)");
+                else
+                    printf("%" PRIu32 ":%" PRIu32 "+%" PRIu32 "", ie->extent[i].fbn,
+                            ie->extent[i].bn, ie->extent[i].count);
+            }
+            printf("}, root = ");
+            if (ie->root == NullReference)
+                printf("(nil)\n");
+            else
+                printf("%" PRIu32 "\n", ie->root);
+            printf("----------------\n");
+            return;
+        }
+
         /* print direct references */
         printf("d[*] = {");
         for (int i = 0; i < N_DIRECT; i++) {
@@ -35,6 +35,54 @@ namespace sofs18
         char name[SOFS18_MAX_NAME + 1];
     };
 
+    /* ***************************************** */
+
+    /** 
+     * \brief magic number of the blocks of a directory index
+     */
+#define DIRINDEX_MAGIC 0x58444953
+
+    /** 
+     * \brief number of entries of a block of a directory index
+     */
+#define DIRINDEX_ENTRIES 62
+
+    /** \brief Definition of an entry of a directory index block. */
+    struct SODirIndexEntry
+    {
+        /** 
+         * \brief lowest name hash covered by the entry;
+         * bit 0 is set if the previous entry may cover the same hash 
+         */
+        uint32_t hash;
+        /** \brief file block number of the directory block, or index node, covering it */
+        uint32_t fbn;
+    };
+
+    /** 
+     * \brief Definition of a block of a directory index.
+     *
+     * A hashed directory keeps its entries in ordinary directory blocks (the leaves),
+     * each one holding the names of a range of hash values.
+     * The leaves are reached through the index root, stored in the last file block
+     * of the directory, optionally through a level of index nodes, stored in the
+     * file blocks before it. These are past the directory size, so a directory
+     * with an index can still be read as a plain array of directory entries.
+     */
+    struct SODirIndexBlock
+    {
+        /** \brief \c DIRINDEX_MAGIC */
+        uint32_t magic;
+        /** \brief number of index levels (root only): 1, entries point to leaves; 2, to index nodes */
+        uint32_t levels;
+        /** \brief number of entries in use */
+        uint32_t count;
+        /** \brief number of index nodes (root only) */
+        uint32_t nnodes;
+        /** \brief the entries, sorted by hash */
+        SODirIndexEntry entry[DIRINDEX_ENTRIES];
+    };
+
     /** @} */
 
 };
@@ -67,6 +67,82 @@ namespace sofs18
         uint32_t i2[N_DOUBLE_INDIRECT];
     };
 
+    /* ***************************************** */
+
+    /** 
+     * \brief marker, kept in the last double indirect reference, of an inode whose data blocks
+     * are mapped by extents (see \c SOInodeExtents) 
+     */
+#define INODE_EXTENTS 0xFFFFFFFD
+
+    /** \brief number of extents kept in the inode itself */
+#define N_INLINE_EXTENTS 2
+
+    /** \brief Definition of an extent: a run of file blocks stored in a run of data blocks. */
+    struct SOExtent
+    {
+        /** \brief first file block number */
+        uint32_t fbn;
+        /** \brief first data block number */
+        uint32_t bn;
+        /** \brief number of blocks (0 if the extent is not in use) */
+        uint32_t count;
+    };
+
+    /** 
+     * \brief The references of an inode whose data blocks are mapped by extents.
+     *
+     * They take the place of the \c d, \c i1 and \c i2 arrays.
+     * The extents are kept in the inode, sorted by file block number, while they fit;
+     * otherwise, all of them are kept in an extent tree, whose root is referred to by \c root.
+     */
+    struct SOInodeExtents
+    {
+        /** \brief the extents, while there is no extent tree */
+        SOExtent extent[N_INLINE_EXTENTS];
+        /** \brief root block of the extent tree, or \c NullReference */
+        uint32_t root;
+        /** \brief \c INODE_EXTENTS */
+        uint32_t magic;
+    };
+
+    /** \brief magic number of the blocks of an extent tree */
+#define EXTENT_MAGIC 0x54584553
+
+    /** \brief number of extents of a leaf block of an extent tree */
+#define EXTENT_ENTRIES 41
+
+    /** \brief number of entries of an index block of an extent tree */
+#define EXTENT_INDEXES 62
+
+    /** \brief Definition of an entry of an index block of an extent tree. */
+    struct SOExtentIndex
+    {
+        /** \brief lowest file block number covered by the child block (ignored for the first entry) */
+        uint32_t fbn;
+        /** \brief the child block */
+        uint32_t bn;
+    };
+
+    /** \brief Definition of a block of an extent tree. */
+    struct SOExtentBlock
+    {
+        /** \brief \c EXTENT_MAGIC */
+        uint32_t magic;
+        /** \brief 0 for a leaf, holding extents; otherwise, the number of index levels below */
+        uint32_t depth;
+        /** \brief number of entries in use */
+        uint32_t count;
+        /** \brief the entries, sorted by file block number */
+        union
+        {
+            SOExtent extent[EXTENT_ENTRIES];
+            SOExtentIndex index[EXTENT_INDEXES];
+        };
+        /** \brief not used */
+        uint32_t reserved;
+    };
+
     /** @} */
 
 };
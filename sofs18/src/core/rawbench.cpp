@@ -0,0 +1,198 @@
+/**
+ *  \defgroup rawbench rawbench
+ *  \ingroup tools
+ *  \brief The \b sofs18 raw disk benchmark program.
+ *
+ *  \details
+ *      It measures the throughput of single block transfers through the
+ *      rawdisk layer, for every access mode and a range of queue depths.<br/>
+ *      At each queue depth, that many transfers are submitted before waiting
+ *      for them to complete. The raw block cache is disabled.
+ *
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <libgen.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+
+#include <vector>
+
+#include "rawdisk.h"
+#include "core.h"
+
+/*
+ * print help message
+ */
+static void printUsage(char *cmd_name)
+{
+    printf("Sinopsis: %s [ OPTION ] supp-file\n"
+           "  OPTIONS:\n"
+           "  -n num     --- number of block transfers per run (default: 20000)\n"
+           "  -q list    --- comma separated list of queue depths (default: 1,4,16,64)\n"
+           "  -s         --- sequential access (default: random)\n"
+           "  -w         --- write blocks instead of reading them (destroys the disk contents)\n"
+           "  -h         --- print this help\n", cmd_name);
+}
+
+/* print error message */
+static void printError(int errcode, char *cmd_name)
+{
+    fprintf(stderr, "%s: error #%d - %s.\n", cmd_name, errcode,
+        strerror(errcode));
+}
+
+using namespace sofs18;
+
+/* run the benchmark once, returning the elapsed time in seconds */
+static double runOnce(const char *devname, uint32_t mode, uint32_t depth,
+        uint32_t n, bool sequential, bool write)
+{
+    soSetRawCacheSize(0);
+    soSetRawDiskMode(mode);
+    soSetRawQueueDepth(depth);
+
+    uint32_t ntotal;
+    soOpenRawDisk(devname, &ntotal);
+
+    std::vector<uint8_t> buf((size_t)depth * BlockSize, 0xA5);
+    unsigned int seed = 1;
+    uint32_t bn = 0;
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (uint32_t i = 0; i < n; i += depth)
+    {
+        for (uint32_t j = 0; j < depth and i + j < n; j++)
+        {
+            bn = sequential ? (bn + 1) % ntotal : rand_r(&seed) % ntotal;
+            if (write)
+                soSubmitWriteRawBlocks(bn, 1, &buf[(size_t)j * BlockSize]);
+            else
+                soSubmitReadRawBlocks(bn, 1, &buf[(size_t)j * BlockSize]);
+        }
+        soWaitRawBlocks();
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    soCloseRawDisk();
+
+    return (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+}
+
+/* The main function */
+
+int main(int argc, char *argv[])
+{
+    /* process command line options */
+    int opt;
+    uint32_t n = 20000;
+    const char *qlist = "1,4,16,64";
+    bool sequential = false;
+    bool write = false;
+
+    while ((opt = getopt(argc, argv, "n:q:swh")) != -1)
+    {
+        switch (opt)
+        {
+            case 'n':
+            {
+                n = atoi(optarg);
+                if (n == 0)
+                {
+                    fprintf(stderr, "%s: Bad argument to 'n' option.\n", basename(argv[0]));
+                    printUsage(basename(argv[0]));
+                    return EXIT_FAILURE;
+                }
+                break;
+            }
+            case 'q':
+            {
+                qlist = optarg;
+                break;
+            }
+            case 's':
+            {
+                sequential = true;
+                break;
+            }
+            case 'w':
+            {
+                write = true;
+                break;
+            }
+            case 'h':
+            {
+                printUsage(basename(argv[0]));
+                return EXIT_SUCCESS;
+            }
+            default:
+            {
+                fprintf(stderr, "%s: It should not have happened.\n", basename(argv[0]));
+                printUsage(basename(argv[0]));
+                return EXIT_FAILURE;
+            }
+        }
+    }
+
+    /* check existence of mandatory argument: storage device name */
+    if ((argc - optind) != 1)
+    {
+        fprintf(stderr, "%s: Wrong number of mandatory arguments.\n", basename(argv[0]));
+        printUsage(basename(argv[0]));
+        return EXIT_FAILURE;
+    }
+
+    /* parse the list of queue depths */
+    std::vector<uint32_t> depths;
+    for (const char *p = qlist; *p != '\0'; )
+    {
+        char *end;
+        long d = strtol(p, &end, 10);
+        if (end == p or d <= 0 or d > 4096 or (*end != ',' and *end != '\0'))
+        {
+            fprintf(stderr, "%s: Bad argument to 'q' option.\n", basename(argv[0]));
+            printUsage(basename(argv[0]));
+            return EXIT_FAILURE;
+        }
+        depths.push_back(d);
+        p = (*end == ',') ? end + 1 : end;
+    }
+
+    /* run the benchmark for every mode and depth */
+    struct { uint32_t mode; const char *name; } modes[] = {
+        { RAWDISK_FILE, "read/write" },
+        { RAWDISK_URING, "io_uring" },
+        { RAWDISK_DIRECT, "O_DIRECT" },
+        { RAWDISK_RAM, "RAM" },
+    };
+
+    printf("%s of %u blocks, %s access\n", write ? "Writes" : "Reads", n,
+            sequential ? "sequential" : "random");
+    printf("%-12s %6s %12s %12s\n", "mode", "depth", "IOPS", "MB/s");
+    for (auto & m : modes)
+    {
+        for (uint32_t d : depths)
+        {
+            try
+            {
+                double t = runOnce(argv[optind], m.mode, d, n, sequential, write);
+                printf("%-12s %6u %12.0f %12.2f\n", m.name, d, n / t,
+                        (double)n * BlockSize / t / (1024 * 1024));
+            }
+            catch (SOException & err)
+            {
+                printError(err.en, basename(argv[0]));
+                return EXIT_FAILURE;
+            }
+        }
+    }
+
+    /* that's all */
+    return EXIT_SUCCESS;
+
+}                /* end of main */
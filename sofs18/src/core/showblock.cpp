@@ -141,45 +141,51 @@ int main(int argc, char *argv[])
         return EXIT_FAILURE;
     }
 
-    /* process request */
-    char buf[BlockSize];
+    /* process request, reading the range in chunks of contiguous blocks */
+    const uint32_t chunk = 64;
+    static char cbuf[chunk * BlockSize];
     uint32_t off = 0;
-    for (uint32_t i = i1; i <= i2; i++)
+    for (uint32_t c = i1; c <= i2; c += chunk)
     {
+        uint32_t cnt = (i2 - c + 1 < chunk) ? i2 - c + 1 : chunk;
         try
         {
-            soReadRawBlock(i, buf);
+            soReadRawBlocks(c, cnt, cbuf);
         }
         catch (int err)
         {
             printError(err, basename(argv[0]));
             return EXIT_FAILURE;
         }
-        switch(sopt)
+        for (uint32_t i = 0; i < cnt; i++)
         {
-            case 'x':
-                printBlockAsHex(buf, off);
-                off += BlockSize;
-                break;
-            case 'a':
-                printBlockAsAscii(buf, off);
-                off += BlockSize;
-                break;
-            case 'i':
-                printBlockOfInodes(buf, off);
-                off += InodesPerBlock;
-                break;
-            case 'd':
-                printBlockOfDirents(buf, off);
-                off += DirentriesPerBlock;
-                break;
-            case 'r':
-                printBlockOfRefs(buf, off);
-                off += ReferencesPerBlock;
-                break;
-            case 's':
-                printSuperBlock(buf);
-                break;
+            char *buf = cbuf + i * BlockSize;
+            switch(sopt)
+            {
+                case 'x':
+                    printBlockAsHex(buf, off);
+                    off += BlockSize;
+                    break;
+                case 'a':
+                    printBlockAsAscii(buf, off);
+                    off += BlockSize;
+                    break;
+                case 'i':
+                    printBlockOfInodes(buf, off);
+                    off += InodesPerBlock;
+                    break;
+                case 'd':
+                    printBlockOfDirents(buf, off);
+                    off += DirentriesPerBlock;
+                    break;
+                case 'r':
+                    printBlockOfRefs(buf, off);
+                    off += ReferencesPerBlock;
+                    break;
+                case 's':
+                    printSuperBlock(buf);
+                    break;
+            }
         }
     }
 
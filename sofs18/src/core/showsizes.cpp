@@ -12,6 +12,8 @@ int main(void)
         "sizeof(SOSuperBlock): " << sizeof(SOSuperBlock) << endl <<
         "sizeof(SOInode): " << sizeof(SOInode) << endl <<
         "sizeof(SODirEntry): " << sizeof(SODirEntry) << endl <<
+        "sizeof(SODirIndexBlock): " << sizeof(SODirIndexBlock) << endl <<
+        "sizeof(SOExtentBlock): " << sizeof(SOExtentBlock) << endl <<
         "InodesPerBlock: " << InodesPerBlock << endl <<
         "DirentriesPerBlock: " << DirentriesPerBlock << endl <<
         "ReferencesPerBlock: " << ReferencesPerBlock << endl;
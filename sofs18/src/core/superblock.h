@@ -44,6 +44,14 @@ namespace sofs18
      */
 #define BLOCK_REFERENCE_CACHE_SIZE 31
 
+    /** \brief value of both \c fblt_head and \c fblt_tail when the free block list table area
+     * holds a free block bitmap instead
+     * \details Bit \c i of the bitmap, counting from the least significant bit of its first byte,
+     * is 1 if data block \c i is free. The block reference caches are not used, and are kept empty.
+     * \ingroup superblock
+     */
+#define FREE_BLOCK_BITMAP 0xFFFFFFFE
+
     /**
      *  \ingroup superblock
      *  \brief Definition of the inode cache data type.
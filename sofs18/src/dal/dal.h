@@ -7,6 +7,9 @@
 #define __SOFS18_DAL__
 
 #include <inttypes.h>
+#include <sys/types.h>
+
+#include <mutex>
 
 #include "superblock.h"
 #include "inode.h"
@@ -26,8 +29,8 @@ namespace sofs18
     /**
      * \brief Open disk at sofs18 abstraction level
      *
-     * Open disk at raw level and then open superblok (SB)
-     * and inode table (IT) abstraction modules.
+     * Open disk at raw level and then open superblok (SB),
+     * inode table (IT) and free block bitmap (FBM) abstraction modules.
      * The other sofs18 abstraction modules do not need to be initialized.
      * They are: free inode list table (FILT) module,
      * free block list table (FBLT) module,
@@ -45,13 +48,37 @@ namespace sofs18
      */
     void soCloseDisk();
 
+    /* ***************************************** */
+
+    /**
+     * \brief Synchronize disk at sofs18 abstraction level
+     *
+     * All blocks kept dirty in memory are written back to
+     * the storage device, after the sync handler, if any, is called.
+     */
+    void soSyncDisk();
+
+    /* ***************************************** */
+
+    /**
+     * \brief Set the function soSyncDisk calls first
+     *
+     * It lets an upper layer write back what it keeps in memory,
+     * before the blocks of the lower ones are written.
+     *
+     * \param handler the function (\c NULL for none)
+     */
+    void soSetSyncHandler(void (*handler)());
+
     /* ***************************************** */
     /* ***************************************** */
 
     /**
      * \brief Open the superblock dealer
      *
-     * Prepare the internal data structure of the superblock dealer
+     * Prepare the internal data structure of the superblock dealer.
+     * The superblock is marked as not properly unmounted, its mount count is
+     * incremented, and it is written and synchronized right away.
      */
     void soSBOpen();
 
@@ -60,22 +87,56 @@ namespace sofs18
     /**
      * \brief Close the superblock dealer
      *
-     * Save superblock to disk and close dealer
+     * Mark the superblock as properly unmounted, save it to disk and close dealer
      * Do nothing if not loaded
      */
     void soSBClose();
 
     /* ***************************************** */
 
+    /**
+     * \brief default number of seconds the superblock may be kept unsaved
+     */
+#define SUPERBLOCK_DEFAULT_SAVE_INTERVAL 5
+
     /**
      * \brief Save superblock to disk
      *
-     * Do nothing if not loaded
+     * Do nothing if not loaded.
+     * While the dealer is open, saving is deferred: the superblock is only marked dirty,
+     * and is written by soSBFlush, by soSBClose, or by a later save once it has been dirty
+     * for the save interval (see soSBSetSaveInterval).
      */
     void soSBSave();
 
     /* ***************************************** */
 
+    /**
+     * \brief Write the superblock to disk, if it is dirty
+     */
+    void soSBFlush();
+
+    /**
+     * \brief Write the superblock to disk, if it has been dirty for the save interval
+     *
+     * It is meant to be called periodically, so an idle superblock is not kept unsaved.
+     *
+     * \return true, if the superblock was written
+     */
+    bool soSBFlushOld();
+
+    /* ***************************************** */
+
+    /**
+     * \brief Set the number of seconds the superblock may be kept unsaved
+     *
+     * \param secs save interval (0 makes every save write the superblock);
+     *      default: \c SUPERBLOCK_DEFAULT_SAVE_INTERVAL
+     */
+    void soSBSetSaveInterval(uint32_t secs);
+
+    /* ***************************************** */
+
     /**
      * \brief Get a pointer to the superblock
      *
@@ -85,6 +146,20 @@ namespace sofs18
      */
     SOSuperBlock * soSBGetPointer();
 
+    /* ***************************************** */
+
+    /**
+     * \brief Get the lock of the superblock
+     *
+     * It must be held while the free lists, and their caches in the superblock,
+     * are changed, as well as while the superblock is saved.
+     * It is recursive, as free list functions call each other.
+     * It may be held while inodes are open or closed, but not the other way around.
+     *
+     * \return Reference to the lock
+     */
+    std::recursive_mutex & soSBLock();
+
     /* ***************************************** */
     /* ***************************************** */
 
@@ -173,15 +248,60 @@ namespace sofs18
 
     /* ***************************************** */
 
+    /**
+     * \brief maximum number of inodes kept dirty in memory
+     */
+#define INODE_DIRTY_MAX_INODES 64
+
+    /**
+     * \brief maximum number of seconds an inode is kept dirty in memory
+     */
+#define INODE_DIRTY_MAX_AGE 5
+
     /**
      * \brief Save an open inode to disk
      *
      * The inode is not closed.
+     * Saving is deferred: the inode is only marked dirty, and is written
+     * when it is closed for the last time, when soITFlushInodes is called,
+     * or when more than \c INODE_DIRTY_MAX_INODES inodes, or inodes dirty for
+     * \c INODE_DIRTY_MAX_AGE seconds, are found on a later save or by soITFlushOldInodes.
+     * Dirty inodes sharing an inode table block are written together.
      *
      * \param ih inode handler
      */
     void soITSaveInode(int ih);
 
+    /**
+     * \brief Set the time of last access of an open inode to now, and save it
+     *
+     * Unlike changing the inode and calling soITSaveInode, it can be done
+     * by several threads sharing the inode, as the change is made under the
+     * lock of the inode table.
+     *
+     * \param ih inode handler
+     */
+    void soITTouchInode(int ih);
+
+    /* ***************************************** */
+
+    /**
+     * \brief Write all dirty inodes to disk
+     *
+     * Each inode table block holding dirty inodes is written once.
+     */
+    void soITFlushInodes();
+
+    /**
+     * \brief Write all dirty inodes to disk, if some has been dirty for
+     * \c INODE_DIRTY_MAX_AGE seconds
+     *
+     * It is meant to be called periodically, so idle inodes are not kept unsaved.
+     *
+     * \return true, if the inodes were written
+     */
+    bool soITFlushOldInodes();
+
     /* ***************************************** */
 
     /**
@@ -203,6 +323,19 @@ namespace sofs18
      */
     uint32_t soITGetInodeID(int ih);
 
+    /* ***************************************** */
+
+    /**
+     * \brief Load the inode table blocks holding a run of inodes ahead of use
+     *
+     * The blocks are brought into the raw block cache, possibly asynchronously
+     * (see soPrefetchRawBlocks), so opening those inodes later does not wait for the disk.
+     *
+     * \param[in] in number of the first inode
+     * \param[in] count number of inodes
+     */
+    void soITPrefetchInodes(uint32_t in, uint32_t count);
+
     /* ***************************************** */
     /* ***************************************** */
 
@@ -250,6 +383,96 @@ namespace sofs18
     /* ***************************************** */
     /* ***************************************** */
 
+    /**
+     * \brief Open the free block bitmap dealer
+     *
+     * If the disk keeps its free blocks in a bitmap (see \c FREE_BLOCK_BITMAP),
+     * the bitmap is loaded and the tree of free extents, runs of contiguous free blocks
+     * indexed both by first block and by length, is built from it.
+     */
+    void soFBMOpen();
+
+    /* ***************************************** */
+
+    /**
+     * \brief Close the free block bitmap dealer, saving the bitmap
+     */
+    void soFBMClose();
+
+    /* ***************************************** */
+
+    /**
+     * \brief Write the changed blocks of the free block bitmap to disk
+     *
+     * Only frees are left to be written here, as allocations are written
+     * to the device as they are made, before the blocks can be referred to.
+     */
+    void soFBMFlush();
+
+    /* ***************************************** */
+
+    /**
+     * \brief Tell whether the free blocks of the open disk are kept in a bitmap
+     */
+    bool soFBMActive();
+
+    /* ***************************************** */
+
+    /**
+     * \brief Allocate a run of contiguous free data blocks from the free block bitmap
+     *
+     * \details
+     * The run starts at \c hint, if it is free;
+     * otherwise, it is the free extent that follows \c hint, if it has \c count blocks,
+     * or else the smallest free extent with \c count blocks, or else the largest free extent.
+     * Each search takes logarithmic time in the number of free extents.
+     * The number of free blocks in the superblock is updated.
+     *
+     * \param [in] count maximum number of blocks to allocate
+     * \param [in] hint preferred first block of the run (\c NullReference for none)
+     * \param [out] first number of the first block of the run
+     * \return the number of blocks allocated, between 1 and \c count;
+     *      error \c ENOSPC is thrown if there are no free blocks
+     */
+    uint32_t soFBMAllocRun(uint32_t count, uint32_t hint, uint32_t *first);
+
+    /* ***************************************** */
+
+    /**
+     * \brief maximum number of free extents looked at by soFBMFindExtent
+     */
+#define FBM_SEARCH_MAX_EXTENTS 64
+
+    /**
+     * \brief Find a free extent close after a block in the free block bitmap
+     *
+     * \param [in] hint the block to start at
+     * \param [in] length minimum number of blocks of the extent, unless it holds \c hint
+     * \return \c hint, if it is free; otherwise, the first block of the first free extent
+     *      after \c hint with \c length blocks, among the next \c FBM_SEARCH_MAX_EXTENTS;
+     *      \c NullReference if there is none
+     */
+    uint32_t soFBMFindExtent(uint32_t hint, uint32_t length);
+
+    /* ***************************************** */
+
+    /**
+     * \brief Mark a data block as free in the free block bitmap
+     *
+     * \param [in] bn number of the block
+     */
+    void soFBMFree(uint32_t bn);
+
+    /* ***************************************** */
+
+    /**
+     * \brief Get the number of free extents of the free block bitmap
+     */
+    uint32_t soFBMExtentCount();
+
+    /* ***************************************** */
+    /* ***************************************** */
+
     /**
      * \brief Read a block of the data zone
      *
@@ -268,6 +491,173 @@ namespace sofs18
      */
     void soWriteDataBlock(uint32_t bn, void *buf);
 
+    /* ***************************************** */
+
+    /**
+     * \brief Read a run of contiguous blocks of the data zone
+     *
+     * \param[in] bn number of the first block to be read
+     * \param[in] count number of blocks to be read
+     * \param[in] buf pointer to the buffer where the data must be read into
+     */
+    void soReadDataBlocks(uint32_t bn, uint32_t count, void *buf);
+
+    /* ***************************************** */
+
+    /**
+     * \brief Write a run of contiguous blocks of the data zone
+     *
+     * \param[in] bn number of the first block to be written
+     * \param[in] count number of blocks to be written
+     * \param[in] buf pointer to the buffer where the data must be written from
+     */
+    void soWriteDataBlocks(uint32_t bn, uint32_t count, void *buf);
+
+    /* ***************************************** */
+
+    /**
+     * \brief Load a run of contiguous blocks of the data zone ahead of use
+     *
+     * The blocks are brought into the raw block cache, possibly asynchronously
+     * (see soPrefetchRawBlocks), so later reads of them do not wait for the disk.
+     *
+     * \param[in] bn number of the first block to be loaded
+     * \param[in] count number of blocks to be loaded
+     */
+    void soPrefetchDataBlocks(uint32_t bn, uint32_t count);
+
+    /* ***************************************** */
+
+    /**
+     * \brief Get the descriptor of the support file through which a run of contiguous
+     *   blocks of the data zone can be transferred directly
+     *
+     * See soRawBlocksFd.
+     *
+     * \param[in] bn number of the first block of the run
+     * \param[in] count number of blocks of the run
+     * \param[in] write true, if the run is to be written through the descriptor
+     * \param[out] pos pointer to where the byte position of the run in the support file is stored
+     * \return the descriptor, or -1 if the access mode of the disk does not allow it
+     */
+    int soDataBlocksFd(uint32_t bn, uint32_t count, bool write, off_t *pos);
+
+    /* ***************************************** */
+    /* ***************************************** */
+
+    /**
+     * \brief maximum number of indirect blocks kept in the block map cache
+     */
+#define BLOCKMAP_MAX_BLOCKS 4096
+
+    /**
+     * \brief Get a reference stored in an indirect block of an inode, from the block map cache
+     *
+     * The block map cache keeps, per inode, the contents of the indirect blocks
+     * (i1 and i2 blocks, and the blocks they point to) read so far, so translating
+     * file block numbers into data block numbers can be done in memory.
+     * On a miss, the block is read from the data zone.
+     * The cache must be invalidated whenever the references of the inode change.
+     * The reference is returned by value, as other threads may change the cache
+     * right after.
+     *
+     * \param[in] in number of the inode the block belongs to
+     * \param[in] bn number of the indirect block, in the data zone
+     * \param[in] idx index of the reference within the block
+     * \return the reference at position idx of the block
+     */
+    uint32_t soBlockMapGetRef(uint32_t in, uint32_t bn, uint32_t idx);
+
+    /* ***************************************** */
+
+    /**
+     * \brief Drop the block map cache of an inode
+     *
+     * \param[in] in number of the inode
+     */
+    void soBlockMapInvalidate(uint32_t in);
+
+    /* ***************************************** */
+
+    /**
+     * \brief Drop the whole block map cache
+     */
+    void soBlockMapClear();
+
+    /* ***************************************** */
+
+    /**
+     * \brief Get the version of the references of an inode
+     *
+     * The version changes whenever the block map cache of the inode is invalidated,
+     * so a translation of a file block number made under some version
+     * remains valid while the version does not change.
+     *
+     * \param[in] in number of the inode
+     * \return the current version
+     */
+    uint64_t soBlockMapVersion(uint32_t in);
+
+    /* ***************************************** */
+    /* ***************************************** */
+
+    /**
+     * \brief maximum number of names kept in the dentry cache
+     */
+#define DENTRY_CACHE_MAX_ENTRIES 8192
+
+    /**
+     * \brief Look a name up in the dentry cache
+     *
+     * The dentry cache keeps, per directory, the inode numbers its names
+     * were last found to be associated to, including names found not to exist
+     * (negative entries), so path traversal can be done in memory.
+     *
+     * \param[in] pin number of the inode of the directory
+     * \param[in] name name of the entry
+     * \param[out] cin pointer to where the inode number is to be stored;
+     *      \c NullReference for a negative entry
+     * \return true if the name is in the cache
+     */
+    bool soDentryCacheGet(uint32_t pin, const char *name, uint32_t *cin);
+
+    /* ***************************************** */
+
+    /**
+     * \brief Put a name into the dentry cache
+     *
+     * \param[in] pin number of the inode of the directory
+     * \param[in] name name of the entry
+     * \param[in] cin inode number associated to the name, or \c NullReference if it does not exist
+     */
+    void soDentryCachePut(uint32_t pin, const char *name, uint32_t cin);
+
+    /* ***************************************** */
+
+    /**
+     * \brief Drop a name from the dentry cache
+     *
+     * \param[in] pin number of the inode of the directory
+     * \param[in] name name of the entry
+     */
+    void soDentryCacheInvalidate(uint32_t pin, const char *name);
+
+    /* ***************************************** */
+
+    /**
+     * \brief Drop all names of a directory from the dentry cache
+     *
+     * \param[in] pin number of the inode of the directory
+     */
+    void soDentryCacheInvalidateDir(uint32_t pin);
+
+    /* ***************************************** */
+
+    /**
+     * \brief Drop the whole dentry cache
+     */
+    void soDentryCacheClear();
+
     /* ***************************************** */
     /** @} close group dal */
     /* ***************************************** */
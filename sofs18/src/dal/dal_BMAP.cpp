@@ -0,0 +1,112 @@
+#include "dal.h"
+
+#include "core.h"
+
+#include <inttypes.h>
+#include <errno.h>
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace sofs18
+{
+
+    /* ***************************************** */
+
+    /*
+     * contents of the indirect blocks of each inode,
+     * indexed by inode number and then by the number of the indirect block
+     */
+    typedef std::unordered_map<uint32_t, std::vector<uint32_t> > SOBlockMap;
+    static std::unordered_map<uint32_t, SOBlockMap> bmap;
+
+    /* total number of blocks in the cache */
+    static uint32_t bmcount = 0;
+
+    /* 
+     * versions of the references of each inode, changed on every invalidation;
+     * those of all inodes change when the whole cache is dropped
+     */
+    static std::unordered_map<uint32_t, uint32_t> bmversion;
+    static uint32_t bmepoch = 0;
+
+    /* access to the cache by concurrent threads */
+    static std::mutex bmlock;
+
+    /* ***************************************** */
+
+    uint32_t soBlockMapGetRef(uint32_t in, uint32_t bn, uint32_t idx)
+    {
+        soProbe(551, "%s(%u, %u, %u)\n", __FUNCTION__, in, bn, idx);
+
+        if (idx >= ReferencesPerBlock)
+            throw SOException(EINVAL, __FUNCTION__);
+
+        std::lock_guard<std::mutex> guard(bmlock);
+
+        SOBlockMap & m = bmap[in];
+        SOBlockMap::iterator it = m.find(bn);
+        if (it != m.end())
+            return it->second[idx];
+
+        /* make room, the simple way */
+        if (bmcount >= BLOCKMAP_MAX_BLOCKS)
+        {
+            bmap.clear();
+            bmcount = 0;
+        }
+
+        std::vector<uint32_t> refs(ReferencesPerBlock);
+        soReadDataBlock(bn, refs.data());
+        std::vector<uint32_t> & v = (bmap[in][bn] = std::move(refs));
+        bmcount++;
+        return v[idx];
+    }
+
+    /* ***************************************** */
+
+    void soBlockMapInvalidate(uint32_t in)
+    {
+        soProbe(552, "%s(%u)\n", __FUNCTION__, in);
+
+        std::lock_guard<std::mutex> guard(bmlock);
+
+        bmversion[in]++;
+
+        std::unordered_map<uint32_t, SOBlockMap>::iterator it = bmap.find(in);
+        if (it == bmap.end())
+            return;
+
+        bmcount -= it->second.size();
+        bmap.erase(it);
+    }
+
+    /* ***************************************** */
+
+    void soBlockMapClear()
+    {
+        soProbe(553, "%s()\n", __FUNCTION__);
+
+        std::lock_guard<std::mutex> guard(bmlock);
+
+        bmap.clear();
+        bmcount = 0;
+        bmepoch++;
+    }
+
+    /* ***************************************** */
+
+    uint64_t soBlockMapVersion(uint32_t in)
+    {
+        soProbe(559, "%s(%u)\n", __FUNCTION__, in);
+
+        std::lock_guard<std::mutex> guard(bmlock);
+
+        std::unordered_map<uint32_t, uint32_t>::iterator it = bmversion.find(in);
+        uint32_t v = (it != bmversion.end()) ? it->second : 0;
+        return ((uint64_t)bmepoch << 32) | v;
+    }
+
+    /* ***************************************** */
+};
@@ -0,0 +1,117 @@
+#include "dal.h"
+
+#include "core.h"
+
+#include <inttypes.h>
+#include <errno.h>
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace sofs18
+{
+
+    /* ***************************************** */
+
+    /*
+     * inode number associated to each name of each directory,
+     * indexed by directory inode number and then by name
+     */
+    typedef std::unordered_map<std::string, uint32_t> SODentryMap;
+    static std::unordered_map<uint32_t, SODentryMap> dcache;
+
+    /* total number of names in the cache */
+    static uint32_t dccount = 0;
+
+    /* access to the cache by concurrent threads */
+    static std::mutex dclock;
+
+    /* ***************************************** */
+
+    bool soDentryCacheGet(uint32_t pin, const char *name, uint32_t *cin)
+    {
+        soProbe(554, "%s(%u, %s, %p)\n", __FUNCTION__, pin, name, cin);
+
+        std::lock_guard<std::mutex> guard(dclock);
+
+        std::unordered_map<uint32_t, SODentryMap>::iterator it = dcache.find(pin);
+        if (it == dcache.end())
+            return false;
+
+        SODentryMap::iterator e = it->second.find(name);
+        if (e == it->second.end())
+            return false;
+
+        *cin = e->second;
+        return true;
+    }
+
+    /* ***************************************** */
+
+    void soDentryCachePut(uint32_t pin, const char *name, uint32_t cin)
+    {
+        soProbe(555, "%s(%u, %s, %u)\n", __FUNCTION__, pin, name, cin);
+
+        std::lock_guard<std::mutex> guard(dclock);
+
+        /* make room, the simple way */
+        if (dccount >= DENTRY_CACHE_MAX_ENTRIES)
+        {
+            dcache.clear();
+            dccount = 0;
+        }
+
+        SODentryMap & m = dcache[pin];
+        std::pair<SODentryMap::iterator, bool> r = m.insert(std::make_pair(std::string(name), cin));
+        if (r.second)
+            dccount++;
+        else
+            r.first->second = cin;
+    }
+
+    /* ***************************************** */
+
+    void soDentryCacheInvalidate(uint32_t pin, const char *name)
+    {
+        soProbe(556, "%s(%u, %s)\n", __FUNCTION__, pin, name);
+
+        std::lock_guard<std::mutex> guard(dclock);
+
+        std::unordered_map<uint32_t, SODentryMap>::iterator it = dcache.find(pin);
+        if (it == dcache.end())
+            return;
+
+        dccount -= it->second.erase(name);
+    }
+
+    /* ***************************************** */
+
+    void soDentryCacheInvalidateDir(uint32_t pin)
+    {
+        soProbe(557, "%s(%u)\n", __FUNCTION__, pin);
+
+        std::lock_guard<std::mutex> guard(dclock);
+
+        std::unordered_map<uint32_t, SODentryMap>::iterator it = dcache.find(pin);
+        if (it == dcache.end())
+            return;
+
+        dccount -= it->second.size();
+        dcache.erase(it);
+    }
+
+    /* ***************************************** */
+
+    void soDentryCacheClear()
+    {
+        soProbe(558, "%s()\n", __FUNCTION__);
+
+        std::lock_guard<std::mutex> guard(dclock);
+
+        dcache.clear();
+        dccount = 0;
+    }
+
+    /* ***************************************** */
+};
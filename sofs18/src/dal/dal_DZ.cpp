@@ -5,6 +5,7 @@
 #include "core.h"
 
 #include <inttypes.h>
+#include <errno.h>
 
 namespace sofs18
 {
@@ -22,5 +23,57 @@ namespace sofs18
     }
 
     /* ***************************************** */
+
+    void soReadDataBlocks(uint32_t bn, uint32_t count, void *buf)
+    {
+        soProbe(563, "%s(%u, %u, %p)\n", __FUNCTION__, bn, count, buf);
+
+        SOSuperBlock *sbp = soSBGetPointer();
+        if ((uint64_t)bn + count > sbp->dz_total)
+            throw SOException(EINVAL, __FUNCTION__);
+
+        soReadRawBlocks(sbp->dz_start + bn, count, buf);
+    }
+
+    /* ***************************************** */
+
+    void soWriteDataBlocks(uint32_t bn, uint32_t count, void *buf)
+    {
+        soProbe(564, "%s(%u, %u, %p)\n", __FUNCTION__, bn, count, buf);
+
+        SOSuperBlock *sbp = soSBGetPointer();
+        if ((uint64_t)bn + count > sbp->dz_total)
+            throw SOException(EINVAL, __FUNCTION__);
+
+        soWriteRawBlocks(sbp->dz_start + bn, count, buf);
+    }
+
+    /* ***************************************** */
+
+    void soPrefetchDataBlocks(uint32_t bn, uint32_t count)
+    {
+        soProbe(565, "%s(%u, %u)\n", __FUNCTION__, bn, count);
+
+        SOSuperBlock *sbp = soSBGetPointer();
+        if ((uint64_t)bn + count > sbp->dz_total)
+            throw SOException(EINVAL, __FUNCTION__);
+
+        soPrefetchRawBlocks(sbp->dz_start + bn, count);
+    }
+
+    /* ***************************************** */
+
+    int soDataBlocksFd(uint32_t bn, uint32_t count, bool write, off_t *pos)
+    {
+        soProbe(567, "%s(%u, %u, %d, %p)\n", __FUNCTION__, bn, count, write, pos);
+
+        SOSuperBlock *sbp = soSBGetPointer();
+        if ((uint64_t)bn + count > sbp->dz_total)
+            throw SOException(EINVAL, __FUNCTION__);
+
+        return soRawBlocksFd(sbp->dz_start + bn, count, write, pos);
+    }
+
+    /* ***************************************** */
 };
 
@@ -1,29 +1,54 @@
 #include "dal.h"
 #include "bin_dal.h"
 
+#include "rawdisk.h"
+#include "core.h"
+
 #include <inttypes.h>
+#include <errno.h>
 
 namespace sofs18
 {
     /* ***************************************** */
 
+    /* 
+     * if the disk is in memory (mmap or RAM mode), the block is handed out in place,
+     * bypassing the bin dealer and its staging copy
+     */
+    static uint32_t *fbltp = NULL;
+
+    /* ***************************************** */
+
     uint32_t * soFBLTOpenBlock(uint32_t bn)
     {
-        return bin::soFBLTOpenBlock(bn);
+        SOSuperBlock *sbp = soSBGetPointer();
+        void *p = (bn < sbp->fblt_size) ? soRawBlockPointer(sbp->fblt_start + bn) : NULL;
+        if (p == NULL)
+            return bin::soFBLTOpenBlock(bn);
+
+        if (fbltp != NULL)
+            throw SOException(EPERM, __FUNCTION__);
+        fbltp = (uint32_t *)p;
+        return fbltp;
     }
 
     /* ***************************************** */
 
     void soFBLTSaveBlock()
     {
-        bin::soFBLTSaveBlock();
+        /* an in place block is already part of the disk */
+        if (fbltp == NULL)
+            bin::soFBLTSaveBlock();
     }
 
     /* ***************************************** */
 
     void soFBLTCloseBlock()
     {
-        bin::soFBLTCloseBlock();
+        if (fbltp != NULL)
+            fbltp = NULL;
+        else
+            bin::soFBLTCloseBlock();
     }
 
     /* ***************************************** */
@@ -0,0 +1,313 @@
+#include "dal.h"
+
+#include "core.h"
+#include "rawdisk.h"
+
+#include <inttypes.h>
+#include <errno.h>
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+namespace sofs18
+{
+    /* ***************************************** */
+
+    /* number of data blocks covered by each bitmap block */
+#define BitsPerBlock (BlockSize * 8)
+
+    /* is the bitmap in use, and its contents, loaded when the dealer is opened */
+    static bool fbmactive = false;
+    static std::vector<uint8_t> fbm;
+
+    /* 
+     * the bitmap as written to disk: allocations are written right away,
+     * before anything can refer to the blocks, while frees are only written on flush,
+     * so a crash may leak blocks but never leave a block in use marked as free 
+     */
+    static std::vector<uint8_t> fbmdisk;
+
+    /* bitmap blocks with frees not yet written */
+    static std::set<uint32_t> fbmdirty;
+
+    /* free extents, indexed by first block (to their length) and by length (and first block) */
+    static std::map<uint32_t, uint32_t> fbmstart;
+    static std::set<std::pair<uint32_t, uint32_t> > fbmlength;
+
+    /* ***************************************** */
+
+    static inline bool soFBMIsFree(uint32_t bn)
+    {
+        return (fbm[bn / 8] >> (bn % 8)) & 1;
+    }
+
+    /* ***************************************** */
+
+    static void soFBMMark(uint32_t first, uint32_t count, bool free)
+    {
+        for (uint32_t bn = first; bn < first + count; bn++)
+        {
+            if (free)
+                fbm[bn / 8] |= (uint8_t)(1 << (bn % 8));
+            else
+            {
+                fbm[bn / 8] &= (uint8_t)~(1 << (bn % 8));
+                fbmdisk[bn / 8] &= (uint8_t)~(1 << (bn % 8));
+            }
+        }
+
+        /* multi-block writes go through the raw block cache, so they reach the device now */
+        uint32_t start = soSBGetPointer()->fblt_start;
+        for (uint32_t blk = first / BitsPerBlock; blk <= (first + count - 1) / BitsPerBlock; blk++)
+        {
+            if (free)
+                fbmdirty.insert(blk);
+            else
+                soWriteRawBlocks(start + blk, 1, &fbmdisk[blk * BlockSize]);
+        }
+    }
+
+    /* ***************************************** */
+
+    static void soFBMAddExtent(uint32_t start, uint32_t length)
+    {
+        fbmstart[start] = length;
+        fbmlength.insert(std::make_pair(length, start));
+    }
+
+    /* ***************************************** */
+
+    static void soFBMRemoveExtent(std::map<uint32_t, uint32_t>::iterator it)
+    {
+        fbmlength.erase(std::make_pair(it->second, it->first));
+        fbmstart.erase(it);
+    }
+
+    /* ***************************************** */
+
+    void soFBMOpen()
+    {
+        soProbe(570, "%s()\n", __FUNCTION__);
+
+        std::lock_guard<std::recursive_mutex> guard(soSBLock());
+
+        fbmactive = false;
+        fbm.clear();
+        fbmdisk.clear();
+        fbmdirty.clear();
+        fbmstart.clear();
+        fbmlength.clear();
+
+        SOSuperBlock *sbp = soSBGetPointer();
+        if (sbp->fblt_head != FREE_BLOCK_BITMAP)
+            return;
+
+        uint32_t nblocks = (sbp->dz_total + BitsPerBlock - 1) / BitsPerBlock;
+        if (nblocks > sbp->fblt_size)
+            throw SOException(EINVAL, __FUNCTION__);
+        fbm.resize(nblocks * BlockSize);
+        soReadRawBlocks(sbp->fblt_start, nblocks, fbm.data());
+        fbmdisk = fbm;
+
+        /* the extents are built a byte at a time where there are no free blocks */
+        uint32_t nfree = 0;
+        uint32_t bn = 0;
+        while (bn < sbp->dz_total)
+        {
+            if (bn % 8 == 0 and fbm[bn / 8] == 0)
+            {
+                bn += 8;
+                continue;
+            }
+            if (not soFBMIsFree(bn))
+            {
+                bn++;
+                continue;
+            }
+            uint32_t start = bn;
+            while (bn < sbp->dz_total and soFBMIsFree(bn))
+                bn++;
+            soFBMAddExtent(start, bn - start);
+            nfree += bn - start;
+        }
+
+        /* the bitmap prevails, as the superblock may have not been saved along with it */
+        if (sbp->dz_free != nfree)
+        {
+            sbp->dz_free = nfree;
+            soSBSave();
+        }
+        fbmactive = true;
+    }
+
+    /* ***************************************** */
+
+    void soFBMFlush()
+    {
+        soProbe(571, "%s()\n", __FUNCTION__);
+
+        std::lock_guard<std::recursive_mutex> guard(soSBLock());
+
+        if (not fbmactive)
+            return;
+
+        uint32_t start = soSBGetPointer()->fblt_start;
+        for (std::set<uint32_t>::iterator it = fbmdirty.begin(); it != fbmdirty.end(); it++)
+        {
+            std::copy(&fbm[*it * BlockSize], &fbm[(*it + 1) * BlockSize], &fbmdisk[*it * BlockSize]);
+            soWriteRawBlock(start + *it, &fbmdisk[*it * BlockSize]);
+        }
+        fbmdirty.clear();
+    }
+
+    /* ***************************************** */
+
+    void soFBMClose()
+    {
+        soProbe(572, "%s()\n", __FUNCTION__);
+
+        std::lock_guard<std::recursive_mutex> guard(soSBLock());
+
+        soFBMFlush();
+        fbmactive = false;
+        fbm.clear();
+        fbmdisk.clear();
+        fbmstart.clear();
+        fbmlength.clear();
+    }
+
+    /* ***************************************** */
+
+    bool soFBMActive()
+    {
+        return fbmactive;
+    }
+
+    /* ***************************************** */
+
+    uint32_t soFBMAllocRun(uint32_t count, uint32_t hint, uint32_t *first)
+    {
+        soProbe(573, "%s(%u, %u, %p)\n", __FUNCTION__, count, hint, first);
+
+        std::lock_guard<std::recursive_mutex> guard(soSBLock());
+
+        if (not fbmactive or count == 0 or first == NULL)
+            throw SOException(EINVAL, __FUNCTION__);
+        if (fbmstart.empty())
+            throw SOException(ENOSPC, __FUNCTION__);
+
+        /* the extent holding the hint, if any */
+        std::map<uint32_t, uint32_t>::iterator it = fbmstart.end();
+        if (hint != NullReference)
+        {
+            it = fbmstart.upper_bound(hint);
+            if (it != fbmstart.begin() and std::prev(it)->first + std::prev(it)->second > hint)
+                it--;
+            else if (it != fbmstart.end() and it->second < count)
+                it = fbmstart.end();
+        }
+
+        /* otherwise, the smallest one that fits, or else the largest one */
+        if (it == fbmstart.end())
+        {
+            std::set<std::pair<uint32_t, uint32_t> >::iterator s =
+                fbmlength.lower_bound(std::make_pair(count, 0));
+            if (s == fbmlength.end())
+                s--;
+            it = fbmstart.find(s->second);
+        }
+
+        uint32_t estart = it->first;
+        uint32_t elength = it->second;
+        uint32_t start = (hint >= estart and hint < estart + elength) ? hint : estart;
+        uint32_t n = std::min(count, estart + elength - start);
+
+        /* what is left of the extent, on either side of the run */
+        soFBMRemoveExtent(it);
+        if (start > estart)
+            soFBMAddExtent(estart, start - estart);
+        if (start + n < estart + elength)
+            soFBMAddExtent(start + n, estart + elength - start - n);
+
+        soFBMMark(start, n, false);
+        soSBGetPointer()->dz_free -= n;
+        soSBSave();
+
+        *first = start;
+        return n;
+    }
+
+    /* ***************************************** */
+
+    uint32_t soFBMFindExtent(uint32_t hint, uint32_t length)
+    {
+        soProbe(575, "%s(%u, %u)\n", __FUNCTION__, hint, length);
+
+        std::lock_guard<std::recursive_mutex> guard(soSBLock());
+
+        if (not fbmactive or hint >= soSBGetPointer()->dz_total)
+            throw SOException(EINVAL, __FUNCTION__);
+        if (soFBMIsFree(hint))
+            return hint;
+
+        std::map<uint32_t, uint32_t>::iterator it = fbmstart.upper_bound(hint);
+        for (uint32_t i = 0; i < FBM_SEARCH_MAX_EXTENTS and it != fbmstart.end(); i++, it++)
+        {
+            if (it->second >= length)
+                return it->first;
+        }
+        return NullReference;
+    }
+
+    /* ***************************************** */
+
+    void soFBMFree(uint32_t bn)
+    {
+        soProbe(574, "%s(%u)\n", __FUNCTION__, bn);
+
+        std::lock_guard<std::recursive_mutex> guard(soSBLock());
+
+        SOSuperBlock *sbp = soSBGetPointer();
+        if (not fbmactive or bn >= sbp->dz_total or soFBMIsFree(bn))
+            throw SOException(EINVAL, __FUNCTION__);
+
+        /* merge with the extents right after and right before */
+        uint32_t start = bn;
+        uint32_t length = 1;
+        std::map<uint32_t, uint32_t>::iterator next = fbmstart.upper_bound(bn);
+        if (next != fbmstart.begin())
+        {
+            std::map<uint32_t, uint32_t>::iterator prev = std::prev(next);
+            if (prev->first + prev->second == bn)
+            {
+                start = prev->first;
+                length += prev->second;
+                soFBMRemoveExtent(prev);
+            }
+        }
+        if (next != fbmstart.end() and next->first == bn + 1)
+        {
+            length += next->second;
+            soFBMRemoveExtent(next);
+        }
+        soFBMAddExtent(start, length);
+
+        soFBMMark(bn, 1, true);
+        sbp->dz_free++;
+        soSBSave();
+    }
+
+    /* ***************************************** */
+
+    uint32_t soFBMExtentCount()
+    {
+        std::lock_guard<std::recursive_mutex> guard(soSBLock());
+        return fbmstart.size();
+    }
+
+    /* ***************************************** */
+};
+
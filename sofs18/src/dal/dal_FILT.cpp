@@ -1,28 +1,53 @@
 #include "dal.h"
 #include "bin_dal.h"
 
+#include "rawdisk.h"
+#include "core.h"
+
 #include <inttypes.h>
+#include <errno.h>
 
 namespace sofs18
 {
 
+    /* 
+     * if the disk is in memory (mmap or RAM mode), the block is handed out in place,
+     * bypassing the bin dealer and its staging copy
+     */
+    static uint32_t *filtp = NULL;
+
+    /* ***************************************** */
+
     uint32_t * soFILTOpenBlock(uint32_t bn)
     {
-        return bin::soFILTOpenBlock(bn);
+        SOSuperBlock *sbp = soSBGetPointer();
+        void *p = (bn < sbp->filt_size) ? soRawBlockPointer(sbp->filt_start + bn) : NULL;
+        if (p == NULL)
+            return bin::soFILTOpenBlock(bn);
+
+        if (filtp != NULL)
+            throw SOException(EPERM, __FUNCTION__);
+        filtp = (uint32_t *)p;
+        return filtp;
     }
 
     /* ***************************************** */
 
     void soFILTSaveBlock()
     {
-        bin::soFILTSaveBlock();
+        /* an in place block is already part of the disk */
+        if (filtp == NULL)
+            bin::soFILTSaveBlock();
     }
 
     /* ***************************************** */
 
     void soFILTCloseBlock()
     {
-        bin::soFILTCloseBlock();
+        if (filtp != NULL)
+            filtp = NULL;
+        else
+            bin::soFILTCloseBlock();
     }
 
     /* ***************************************** */
@@ -1,16 +1,79 @@
 #include "dal.h"
 #include "bin_dal.h"
 
+#include "rawdisk.h"
 #include "core.h"
 
 #include <inttypes.h>
+#include <errno.h>
+#include <time.h>
+
+#include <map>
+#include <mutex>
+#include <unordered_map>
 
 namespace sofs18
 {
     /* ************************************** */
 
+    /* 
+     * access to the table of open inodes by concurrent threads;
+     * recursive, as some operations are built on others 
+     */
+    static std::recursive_mutex itlock;
+
+    /* number of times each handler is open, so its last close is known */
+    static std::unordered_map<int, uint32_t> itopens;
+
+    /* 
+     * handlers of the inodes changed but not yet saved, indexed by inode number,
+     * so the ones sharing an inode table block are next to each other
+     */
+    static std::map<uint32_t, int> itdirty;
+
+    /* time the oldest of them became dirty */
+    static time_t itdirtysince = 0;
+
+    /* ************************************** */
+
+    /* write the dirty inodes of the inode table block holding inode in, in a single transfer */
+    static void soITFlushBlock(uint32_t in)
+    {
+        SOSuperBlock *sbp = soSBGetPointer();
+        uint32_t blk = in / InodesPerBlock;
+
+        SOInode inodes[InodesPerBlock];
+        soReadRawBlock(sbp->it_start + blk, inodes);
+
+        std::map<uint32_t, int>::iterator first = itdirty.lower_bound(blk * InodesPerBlock);
+        std::map<uint32_t, int>::iterator it = first;
+        for (; it != itdirty.end() and it->first / InodesPerBlock == blk; it++)
+            inodes[it->first % InodesPerBlock] = *bin::soITGetInodePointer(it->second);
+
+        /* the inodes are only taken as clean once written */
+        soWriteRawBlock(sbp->it_start + blk, inodes);
+        itdirty.erase(first, it);
+    }
+
+    /* ************************************** */
+
+    void soITFlushInodes()
+    {
+        soProbe(568, "%s()\n", __FUNCTION__);
+
+        std::lock_guard<std::recursive_mutex> guard(itlock);
+
+        while (not itdirty.empty())
+            soITFlushBlock(itdirty.begin()->first);
+    }
+
+    /* ************************************** */
+
     void soITOpen()
     {
+        std::lock_guard<std::recursive_mutex> guard(itlock);
+        itopens.clear();
+        itdirty.clear();
         bin::soITOpen();
     }
 
@@ -18,6 +81,9 @@ namespace sofs18
 
     void soITClose()
     {
+        std::lock_guard<std::recursive_mutex> guard(itlock);
+        soITFlushInodes();
+        itopens.clear();
         bin::soITClose();
     }
 
@@ -25,20 +91,67 @@ namespace sofs18
 
     int soITOpenInode(uint32_t in)
     {
-        return bin::soITOpenInode(in);
+        std::lock_guard<std::recursive_mutex> guard(itlock);
+        int ih = bin::soITOpenInode(in);
+        itopens[ih]++;
+        return ih;
     }
 
     /* ************************************** */
 
     void soITSaveInode(int ih)
     {
-        bin::soITSaveInode(ih);
+        std::lock_guard<std::recursive_mutex> guard(itlock);
+        /* the inode is only marked dirty; it is written when closed for the last time */
+        if (itdirty.empty())
+            itdirtysince = time(NULL);
+        itdirty[bin::soITGetInodeID(ih)] = ih;
+
+        /* too many dirty inodes, or dirty for too long, are all written */
+        if (itdirty.size() > INODE_DIRTY_MAX_INODES)
+            soITFlushInodes();
+        else
+            soITFlushOldInodes();
+    }
+
+    /* ************************************** */
+
+    bool soITFlushOldInodes()
+    {
+        std::lock_guard<std::recursive_mutex> guard(itlock);
+
+        if (itdirty.empty() or time(NULL) - itdirtysince < INODE_DIRTY_MAX_AGE)
+            return false;
+
+        soITFlushInodes();
+        return true;
+    }
+
+    /* ************************************** */
+
+    void soITTouchInode(int ih)
+    {
+        soProbe(576, "%s(%d)\n", __FUNCTION__, ih);
+
+        std::lock_guard<std::recursive_mutex> guard(itlock);
+        __atomic_store_n(&bin::soITGetInodePointer(ih)->atime, (uint32_t)time(NULL), __ATOMIC_RELAXED);
+        soITSaveInode(ih);
     }
 
     /* ************************************** */
 
     void soITCloseInode(int ih)
     {
+        std::lock_guard<std::recursive_mutex> guard(itlock);
+        std::unordered_map<int, uint32_t>::iterator it = itopens.find(ih);
+        if (it == itopens.end() or --it->second == 0)
+        {
+            uint32_t in = bin::soITGetInodeID(ih);
+            if (itdirty.find(in) != itdirty.end())
+                soITFlushBlock(in);
+            if (it != itopens.end())
+                itopens.erase(it);
+        }
         bin::soITCloseInode(ih);
     }
 
@@ -46,6 +159,7 @@ namespace sofs18
 
     SOInode* soITGetInodePointer(int ih)
     {
+        std::lock_guard<std::recursive_mutex> guard(itlock);
         return bin::soITGetInodePointer(ih);
     }
 
@@ -53,11 +167,28 @@ namespace sofs18
 
     uint32_t soITGetInodeID(int ih)
     {
+        std::lock_guard<std::recursive_mutex> guard(itlock);
         return bin::soITGetInodeID(ih);
     }
 
     /* ************************************** */
 
+    void soITPrefetchInodes(uint32_t in, uint32_t count)
+    {
+        soProbe(566, "%s(%u, %u)\n", __FUNCTION__, in, count);
+
+        SOSuperBlock *sbp = soSBGetPointer();
+        if (count == 0 or (uint64_t)in + count > sbp->itotal)
+            throw SOException(EINVAL, __FUNCTION__);
+
+        /* no lock is needed, as only the raw block cache is touched */
+        uint32_t first = in / InodesPerBlock;
+        uint32_t last = (in + count - 1) / InodesPerBlock;
+        soPrefetchRawBlocks(sbp->it_start + first, last - first + 1);
+    }
+
+    /* ************************************** */
+
 };
 
 
@@ -8,23 +8,51 @@
 namespace sofs18
 {
 
+    /* called by soSyncDisk before writing back the blocks kept dirty */
+    static void (*synchandler)() = NULL;
+
     void soOpenDisk(const char * devname)
     {
         soProbe(SOPROBE_GREEN, 501, "%s(%s)\n", __FUNCTION__, devname);
 
         soOpenRawDisk(devname);
         soSBOpen();
+        soFBMOpen();
         soITOpen();
+        soBlockMapClear();
+        soDentryCacheClear();
     }
 
     void soCloseDisk()
     {
         soProbe(SOPROBE_GREEN, 502, "%s()\n", __FUNCTION__);
 
+        soBlockMapClear();
+        soDentryCacheClear();
         soITClose();
+        soFBMClose();
         soSBClose();
         soCloseRawDisk();
     }
 
+    void soSyncDisk()
+    {
+        soProbe(SOPROBE_GREEN, 503, "%s()\n", __FUNCTION__);
+
+        if (synchandler != NULL)
+            synchandler();
+        soITFlushInodes();
+        soFBMFlush();
+        soSBFlush();
+        soSyncRawDisk();
+    }
+
+    void soSetSyncHandler(void (*handler)())
+    {
+        soProbe(SOPROBE_GREEN, 504, "%s(%p)\n", __FUNCTION__, handler);
+
+        synchandler = handler;
+    }
+
 };
 
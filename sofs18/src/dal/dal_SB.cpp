@@ -1,29 +1,115 @@
 #include "dal.h"
 #include "bin_dal.h"
 
+#include "core.h"
+#include "rawdisk.h"
+
 #include <string.h>
 #include <inttypes.h>
+#include <time.h>
 
 namespace sofs18
 {
     /* ***************************************** */
 
+    /* access to the superblock by concurrent threads */
+    static std::recursive_mutex sblock;
+
+    /* saves are deferred only once the dealer is open */
+    static bool sbdefer = false;
+
+    /* has the superblock been changed since last written, and since when */
+    static bool sbdirty = false;
+    static time_t sbdirtysince = 0;
+
+    /* maximum number of seconds the superblock is kept dirty */
+    static uint32_t sbinterval = SUPERBLOCK_DEFAULT_SAVE_INTERVAL;
+
+    /* ***************************************** */
+
     void soSBOpen()
     {
+        std::lock_guard<std::recursive_mutex> guard(sblock);
+        sbdefer = false;
+        sbdirty = false;
         bin::soSBOpen();
+
+        /* the disk is recorded as in use right away, so an unclean shutdown is detected */
+        SOSuperBlock *sbp = bin::soSBGetPointer();
+        sbp->mntstat = 0;
+        sbp->mntcnt++;
+        bin::soSBSave();
+        soSyncRawDisk();
+        sbdefer = true;
     }
 
     /* ***************************************** */
 
     void soSBSave()
     {
-        bin::soSBSave();
+        std::lock_guard<std::recursive_mutex> guard(sblock);
+
+        if (not sbdefer or sbinterval == 0)
+        {
+            bin::soSBSave();
+            sbdirty = false;
+            return;
+        }
+
+        if (not sbdirty)
+        {
+            sbdirty = true;
+            sbdirtysince = time(NULL);
+        }
+        else
+            soSBFlushOld();
+    }
+
+    /* ***************************************** */
+
+    bool soSBFlushOld()
+    {
+        std::lock_guard<std::recursive_mutex> guard(sblock);
+
+        if (not sbdirty or time(NULL) - sbdirtysince < (time_t)sbinterval)
+            return false;
+
+        soSBFlush();
+        return true;
+    }
+
+    /* ***************************************** */
+
+    void soSBFlush()
+    {
+        soProbe(569, "%s()\n", __FUNCTION__);
+
+        std::lock_guard<std::recursive_mutex> guard(sblock);
+
+        if (sbdirty)
+        {
+            bin::soSBSave();
+            sbdirty = false;
+        }
+    }
+
+    /* ***************************************** */
+
+    void soSBSetSaveInterval(uint32_t secs)
+    {
+        std::lock_guard<std::recursive_mutex> guard(sblock);
+        sbinterval = secs;
     }
 
     /* ***************************************** */
 
     void soSBClose()
     {
+        std::lock_guard<std::recursive_mutex> guard(sblock);
+        sbdefer = false;
+        bin::soSBGetPointer()->mntstat = 1;
+        bin::soSBSave();
+        sbdirty = false;
         bin::soSBClose();
     }
 
@@ -35,5 +121,12 @@ namespace sofs18
     }
 
     /* ***************************************** */
+
+    std::recursive_mutex & soSBLock()
+    {
+        return sblock;
+    }
+
+    /* ***************************************** */
 };
 
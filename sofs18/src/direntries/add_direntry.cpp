@@ -3,6 +3,8 @@
 #include "work_direntries.h"
 
 #include "core.h"
+#include "dal.h"
+#include "fileblocks.h"
 
 #include <errno.h>
 #include <string.h>
@@ -13,10 +15,29 @@ namespace sofs18
 
     void soAddDirEntry(int pih, const char *name, uint32_t cin)
     {
-        if (soBinSelected(202))
-            return bin::soAddDirEntry(pih, name, cin);
+        uint32_t pin = soITGetInodeID(pih);
+        soDentryCacheInvalidate(pin, name);
+
+        /* the blocks of the child are to go near those of the directory */
+        uint32_t pbn = soGetFileBlock(pih, 0);
+        if (pbn != NullReference)
+            soSetFileGoal(cin, pbn + 1);
+
+        if (soDirIndexed(pih))
+            soDirIndexAdd(pih, name, cin);
         else
-            return work::soAddDirEntry(pih, name, cin);
+        {
+            if (soBinSelected(202))
+                bin::soAddDirEntry(pih, name, cin);
+            else
+                work::soAddDirEntry(pih, name, cin);
+
+            /* a directory that grew large enough gets a hashed index */
+            if (soITGetInodePointer(pih)->size / BlockSize >= DIRINDEX_MIN_BLOCKS)
+                soDirIndexBuild(pih);
+        }
+
+        soDentryCachePut(pin, name, cin);
     }
 
 };
@@ -3,6 +3,7 @@
 #include "work_direntries.h"
 
 #include "core.h"
+#include "dal.h"
 
 #include <errno.h>
 #include <string.h>
@@ -13,10 +14,19 @@ namespace sofs18
 
     uint32_t soDeleteDirEntry(int pih, const char *name)
     {
-        if (soBinSelected(203))
-            return bin::soDeleteDirEntry(pih, name);
+        uint32_t pin = soITGetInodeID(pih);
+        soDentryCacheInvalidate(pin, name);
+
+        uint32_t cin;
+        if (soDirIndexed(pih))
+            cin = soDirIndexDelete(pih, name);
+        else if (soBinSelected(203))
+            cin = bin::soDeleteDirEntry(pih, name);
         else
-            return work::soDeleteDirEntry(pih, name);
+            cin = work::soDeleteDirEntry(pih, name);
+
+        soDentryCachePut(pin, name, NullReference);
+        return cin;
     }
 
 };
@@ -14,6 +14,8 @@
 
 #include <inttypes.h>
 
+#include "direntry.h"
+
 namespace sofs18
 {
 
@@ -149,6 +151,122 @@ namespace sofs18
      */
     bool soCheckDirEmpty(int ih);
 
+    /* ************************************************** */
+
+    /**
+     *  \brief minimum number of blocks of a directory for it to get an index
+     *
+     *  Below 8 blocks (64 entries) a linear scan is as fast as the index,
+     *  whose root and half empty leaves take more blocks.
+     */
+#define DIRINDEX_MIN_BLOCKS 8
+
+    /**
+     *  \brief Check if a directory has a hashed index
+     *
+     *  \param [in] pih inode handler of the directory
+     *  \return true if the directory has an index
+     */
+    bool soDirIndexed(int pih);
+
+    /* ************************************************** */
+
+    /**
+     *  \brief Build the hashed index of a directory
+     *
+     *  The entries of the directory, except "." and "..", which stay in block 0, 
+     *  are sorted by hash and laid out in half full leaves, following block 0.
+     *  The index root and nodes are then written past the directory size.
+     *  From then on, soGetDirEntry, soAddDirEntry, soDeleteDirEntry and
+     *  soRenameDirEntry go through the index, reading a bounded number of blocks.
+     *
+     *  \param [in] pih inode handler of the directory
+     *
+     *  \remarks
+     *
+     *  \li Error \c ENOSPC is thrown if the directory is too large to be indexed
+     *  \li Nothing is done if the directory already has an index
+     */
+    void soDirIndexBuild(int pih);
+
+    /* ************************************************** */
+
+    /**
+     *  \brief Get the inode associated to a given name, in a directory with an index
+     *  \sa soGetDirEntry
+     */
+    uint32_t soDirIndexGet(int pih, const char *name);
+
+    /* ************************************************** */
+
+    /**
+     *  \brief Add a new entry to a directory with an index
+     *
+     *  If the leaf of the name hash is full, it is split in two and
+     *  a new entry is added to the index.
+     *
+     *  \sa soAddDirEntry
+     *  \remarks Error \c ENOSPC is thrown if the index is full
+     */
+    void soDirIndexAdd(int pih, const char *name, uint32_t cin);
+
+    /* ************************************************** */
+
+    /**
+     *  \brief Delete an entry from a directory with an index
+     *  \sa soDeleteDirEntry
+     */
+    uint32_t soDirIndexDelete(int pih, const char *name);
+
+    /* ************************************************** */
+
+    /**
+     *  \brief Rename an entry of a directory with an index
+     *
+     *  The entry is moved to the leaf of the new name hash.
+     *
+     *  \sa soRenameDirEntry
+     */
+    void soDirIndexRename(int pih, const char *name, const char *newName);
+
+    /* ************************************************** */
+
+    /**
+     *  \brief position, as given by soDirIndexReaddir, of the first entry in the index
+     *
+     *  The positions below it are those of "." and "..", which are not indexed
+     *  and stay in the first two slots of block 0.
+     */
+#define DIRINDEX_FIRST_POS (2 * sizeof(SODirEntry))
+
+    /**
+     *  \brief Function called by soDirIndexReaddir with a batch of entries.
+     *
+     *  \param ctx the context given to soDirIndexReaddir
+     *  \param de the entries, in hash order
+     *  \param next position to resume reading from, after each entry
+     *  \param n number of entries
+     *
+     *  \return 0, to go on; non-zero, to stop
+     */
+    typedef int (*SODirIndexFiller)(void *ctx, SODirEntry *de, int32_t *next, uint32_t n);
+
+    /**
+     *  \brief Read the entries of a directory with an index, in hash order
+     *
+     *  The position of an entry is \c DIRINDEX_FIRST_POS plus its hash, less its
+     *  two lowest bits, so, unlike the slots of the entries, it does not change when
+     *  leaves are split or the index is built.
+     *  Entries whose positions are equal are given in the same batch, so reading resumed
+     *  from a position given to \c filler may repeat some of them, but never skips any.
+     *
+     *  \param [in] pih inode handler of the directory
+     *  \param [in] pos position to start from, not below \c DIRINDEX_FIRST_POS
+     *  \param [in] filler function called for each batch of entries
+     *  \param [in] ctx context passed to \c filler
+     */
+    void soDirIndexReaddir(int pih, int32_t pos, SODirIndexFiller filler, void *ctx);
+
     /* ************************************************** */
     /** @} close group direntries */
     /* ************************************************** */
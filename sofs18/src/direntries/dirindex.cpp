@@ -0,0 +1,700 @@
+#include "direntries.h"
+
+#include "core.h"
+#include "dal.h"
+#include "fileblocks.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace sofs18
+{
+
+    /* ***************************************** */
+
+    /* the index root is kept in the last possible file block, the nodes in the ones before it */
+#define DIRINDEX_ROOT_FBN (N_DIRECT + N_INDIRECT * ReferencesPerBlock \
+        + N_DOUBLE_INDIRECT * ReferencesPerBlock * ReferencesPerBlock - 1)
+
+    /* number of entries put in a leaf, or node, when it is created or split */
+#define DIRINDEX_LEAF_FILL (DirentriesPerBlock / 2)
+#define DIRINDEX_NODE_FILL (DIRINDEX_ENTRIES / 2)
+
+    /* path from the root to a leaf */
+    struct SODirIndexPath
+    {
+        SODirIndexBlock root;
+        uint32_t rpos;          ///< position in the root
+        SODirIndexBlock node;   ///< index node, if the root has 2 levels
+        uint32_t nfbn;          ///< file block of the index node
+        uint32_t npos;          ///< position in the index node
+    };
+
+    /* ***************************************** */
+
+    /* FNV-1a hash of a name; bit 0 is used as the continuation flag */
+    static uint32_t soDirIndexHash(const char *name)
+    {
+        uint32_t h = 2166136261u;
+        for (const char *p = name; *p != '\0'; p++)
+        {
+            h ^= (uint8_t)*p;
+            h *= 16777619u;
+        }
+        return h & ~1u;
+    }
+
+    /* ***************************************** */
+
+    /* key of a name, from which its position is got by soDirIndexReaddir */
+    static uint32_t soDirIndexKey(const char *name)
+    {
+        return soDirIndexHash(name) >> 2;
+    }
+
+    /* ***************************************** */
+
+    /* check the name of an entry */
+    static void soDirIndexCheckName(const char *name, const char *fname)
+    {
+        if (name[0] == '\0' or strchr(name, '/') != NULL)
+            throw SOException(EINVAL, fname);
+
+        if (strlen(name) > SOFS18_MAX_NAME)
+            throw SOException(ENAMETOOLONG, fname);
+    }
+
+    /* ***************************************** */
+
+    /* file block of an index node */
+    static uint32_t soDirIndexNodeFbn(uint32_t k)
+    {
+        return DIRINDEX_ROOT_FBN - 1 - k;
+    }
+
+    /* ***************************************** */
+
+    /* the table of leaves of a path and the position in it */
+    static SODirIndexBlock *soDirIndexTable(SODirIndexPath & path)
+    {
+        return (path.root.levels == 1) ? &path.root : &path.node;
+    }
+
+    static uint32_t & soDirIndexPos(SODirIndexPath & path)
+    {
+        return (path.root.levels == 1) ? path.rpos : path.npos;
+    }
+
+    /* ***************************************** */
+
+    /* position of the last entry of an index block with hash not above h */
+    static uint32_t soDirIndexSearch(SODirIndexBlock *ib, uint32_t h)
+    {
+        uint32_t lo = 0;
+        uint32_t hi = ib->count;
+        while (hi - lo > 1)
+        {
+            uint32_t mid = (lo + hi) / 2;
+            if (ib->entry[mid].hash <= h)
+                lo = mid;
+            else
+                hi = mid;
+        }
+        return lo;
+    }
+
+    /* ***************************************** */
+
+    /* go from the root down to the first leaf that may hold hash h */
+    static void soDirIndexProbe(int pih, uint32_t h, SODirIndexPath & path)
+    {
+        soReadFileBlock(pih, DIRINDEX_ROOT_FBN, &path.root);
+        if (path.root.magic != DIRINDEX_MAGIC or path.root.count == 0)
+            throw SOException(EIO, __FUNCTION__);
+
+        path.rpos = soDirIndexSearch(&path.root, h);
+        if (path.root.levels == 2)
+        {
+            path.nfbn = path.root.entry[path.rpos].fbn;
+            soReadFileBlock(pih, path.nfbn, &path.node);
+            if (path.node.magic != DIRINDEX_MAGIC or path.node.count == 0)
+                throw SOException(EIO, __FUNCTION__);
+            path.npos = soDirIndexSearch(&path.node, h);
+        }
+    }
+
+    /* ***************************************** */
+
+    /*
+     * move to the next leaf, if it may also hold hash h
+     * (that is, if it continues the current one)
+     */
+    static bool soDirIndexNext(int pih, uint32_t h, SODirIndexPath & path)
+    {
+        SODirIndexBlock *tb = soDirIndexTable(path);
+        uint32_t & pos = soDirIndexPos(path);
+
+        if (pos + 1 < tb->count)
+        {
+            if (tb->entry[pos + 1].hash != (h | 1))
+                return false;
+            pos++;
+            return true;
+        }
+
+        /* the next leaf is in the next node */
+        if (path.root.levels == 1 or path.rpos + 1 >= path.root.count)
+            return false;
+        SODirIndexBlock next;
+        soReadFileBlock(pih, path.root.entry[path.rpos + 1].fbn, &next);
+        if (next.entry[0].hash != (h | 1))
+            return false;
+        path.rpos++;
+        path.nfbn = path.root.entry[path.rpos].fbn;
+        path.node = next;
+        path.npos = 0;
+        return true;
+    }
+
+    /* ***************************************** */
+
+    /* move to the leaf that follows in the index, if any */
+    static bool soDirIndexNextLeaf(int pih, SODirIndexPath & path)
+    {
+        SODirIndexBlock *tb = soDirIndexTable(path);
+        uint32_t & pos = soDirIndexPos(path);
+
+        if (pos + 1 < tb->count)
+        {
+            pos++;
+            return true;
+        }
+
+        if (path.root.levels == 1 or path.rpos + 1 >= path.root.count)
+            return false;
+        path.rpos++;
+        path.nfbn = path.root.entry[path.rpos].fbn;
+        soReadFileBlock(pih, path.nfbn, &path.node);
+        path.npos = 0;
+        return true;
+    }
+
+    /* ***************************************** */
+
+    /* position of name in a directory block, or -1 */
+    static int soDirIndexFind(SODirEntry *d, const char *name)
+    {
+        for (uint32_t j = 0; j < DirentriesPerBlock; j++)
+            if (d[j].name[0] != '\0' and strcmp(d[j].name, name) == 0)
+                return j;
+        return -1;
+    }
+
+    /* ***************************************** */
+
+    /*
+     * look name up, leaving in path and d the leaf holding it, if found;
+     * return its position in d, or -1
+     */
+    static int soDirIndexLookup(int pih, const char *name, SODirIndexPath & path, SODirEntry *d)
+    {
+        uint32_t h = soDirIndexHash(name);
+        soDirIndexProbe(pih, h, path);
+        do
+        {
+            soReadFileBlock(pih, soDirIndexTable(path)->entry[soDirIndexPos(path)].fbn, d);
+            int j = soDirIndexFind(d, name);
+            if (j >= 0)
+                return j;
+        } while (soDirIndexNext(pih, h, path));
+        return -1;
+    }
+
+    /* ***************************************** */
+
+    /* fill an index block header */
+    static void soDirIndexInit(SODirIndexBlock *ib, uint32_t levels)
+    {
+        memset(ib, 0, sizeof(SODirIndexBlock));
+        ib->magic = DIRINDEX_MAGIC;
+        ib->levels = levels;
+    }
+
+    /* ***************************************** */
+
+    /* fill a directory block with the given entries, the remaining ones free */
+    static void soDirIndexFillLeaf(SODirEntry *d, const SODirEntry *src, uint32_t n)
+    {
+        memset(d, 0, BlockSize);
+        for (uint32_t j = 0; j < DirentriesPerBlock; j++)
+            d[j].in = NullReference;
+        if (n > 0)
+            memcpy(d, src, n * sizeof(SODirEntry));
+    }
+
+    /* ***************************************** */
+
+    /*
+     * number of index nodes soDirIndexInsert adds to insert an entry at the current
+     * position of the table of leaves; ENOSPC is thrown if the index has no room for them
+     */
+    static uint32_t soDirIndexNodesNeeded(SODirIndexPath & path)
+    {
+        uint32_t needed = 0;
+        uint32_t rcount = path.root.count;
+        if (path.root.levels == 1 and path.root.count == DIRINDEX_ENTRIES)
+        {
+            /* the root becomes a node, full, so it is split too */
+            needed = 2;
+            rcount = 1;
+        }
+        else if (path.root.levels == 2 and path.node.count == DIRINDEX_ENTRIES)
+            needed = 1;
+
+        if (needed > 0 and (rcount == DIRINDEX_ENTRIES or path.root.nnodes + needed > DIRINDEX_ENTRIES))
+            throw SOException(ENOSPC, __FUNCTION__);
+        return needed;
+    }
+
+    /* ***************************************** */
+
+    /*
+     * insert entry (hash, fbn) after the current position of the table of leaves,
+     * splitting the index node, or adding a level to the index, if it is full
+     */
+    static void soDirIndexInsert(int pih, SODirIndexPath & path, uint32_t hash, uint32_t fbn)
+    {
+        /* a full root of a single level: move its entries to a node */
+        if (path.root.levels == 1 and path.root.count == DIRINDEX_ENTRIES)
+        {
+            if (path.root.nnodes >= DIRINDEX_ENTRIES)
+                throw SOException(ENOSPC, __FUNCTION__);
+            path.node = path.root;
+            path.node.levels = 1;
+            path.node.nnodes = 0;
+            path.nfbn = soDirIndexNodeFbn(path.root.nnodes++);
+            path.npos = path.rpos;
+            path.root.levels = 2;
+            path.root.count = 1;
+            path.root.entry[0].hash = 0;
+            path.root.entry[0].fbn = path.nfbn;
+            path.rpos = 0;
+        }
+
+        /* a full node: split it in two halves */
+        if (path.root.levels == 2 and path.node.count == DIRINDEX_ENTRIES)
+        {
+            if (path.root.count == DIRINDEX_ENTRIES or path.root.nnodes >= DIRINDEX_ENTRIES)
+                throw SOException(ENOSPC, __FUNCTION__);
+
+            SODirIndexBlock upper;
+            soDirIndexInit(&upper, 1);
+            uint32_t m = DIRINDEX_NODE_FILL;
+            upper.count = path.node.count - m;
+            memcpy(upper.entry, &path.node.entry[m], upper.count * sizeof(SODirIndexEntry));
+            path.node.count = m;
+            uint32_t ufbn = soDirIndexNodeFbn(path.root.nnodes++);
+
+            /* add the new node to the root */
+            SODirIndexEntry *re = path.root.entry;
+            memmove(&re[path.rpos + 2], &re[path.rpos + 1],
+                    (path.root.count - path.rpos - 1) * sizeof(SODirIndexEntry));
+            re[path.rpos + 1].hash = upper.entry[0].hash;
+            re[path.rpos + 1].fbn = ufbn;
+            path.root.count++;
+
+            /* and continue in the half holding the current position */
+            if (path.npos >= m)
+            {
+                soWriteFileBlock(pih, path.nfbn, &path.node);
+                path.node = upper;
+                path.nfbn = ufbn;
+                path.npos -= m;
+                path.rpos++;
+            }
+            else
+                soWriteFileBlock(pih, ufbn, &upper);
+        }
+
+        /* insert the entry */
+        SODirIndexBlock *tb = soDirIndexTable(path);
+        uint32_t pos = soDirIndexPos(path);
+        memmove(&tb->entry[pos + 2], &tb->entry[pos + 1], (tb->count - pos - 1) * sizeof(SODirIndexEntry));
+        tb->entry[pos + 1].hash = hash;
+        tb->entry[pos + 1].fbn = fbn;
+        tb->count++;
+
+        /* the root is written last, as it makes the new blocks reachable */
+        if (path.root.levels == 2)
+            soWriteFileBlock(pih, path.nfbn, &path.node);
+        soWriteFileBlock(pih, DIRINDEX_ROOT_FBN, &path.root);
+    }
+
+    /* ***************************************** */
+
+    bool soDirIndexed(int pih)
+    {
+        soProbe(206, "%s(%d)\n", __FUNCTION__, pih);
+
+        SOInode *ip = soITGetInodePointer(pih);
+        if (not S_ISDIR(ip->mode))
+            return false;
+
+        if (soGetFileBlock(pih, DIRINDEX_ROOT_FBN) == NullReference)
+            return false;
+
+        SODirIndexBlock root;
+        soReadFileBlock(pih, DIRINDEX_ROOT_FBN, &root);
+        return root.magic == DIRINDEX_MAGIC;
+    }
+
+    /* ***************************************** */
+
+    void soDirIndexBuild(int pih)
+    {
+        soProbe(207, "%s(%d)\n", __FUNCTION__, pih);
+
+        SOInode *ip = soITGetInodePointer(pih);
+        if (not S_ISDIR(ip->mode))
+            throw SOException(ENOTDIR, __FUNCTION__);
+
+        if (soDirIndexed(pih))
+            return;
+
+        /* collect the entries; "." and ".." stay where they are, in block 0 */
+        uint32_t nblocks = ip->size / BlockSize;
+        SODirEntry d[DirentriesPerBlock];
+        SODirEntry d0[DirentriesPerBlock];
+        std::vector<SODirEntry> ents;
+        for (uint32_t i = 0; i < nblocks; i++)
+        {
+            soReadFileBlock(pih, i, d);
+            for (uint32_t j = 0; j < DirentriesPerBlock; j++)
+            {
+                if (d[j].name[0] == '\0')
+                    continue;
+                if (i == 0 and (strcmp(d[j].name, ".") == 0 or strcmp(d[j].name, "..") == 0))
+                    continue;
+                ents.push_back(d[j]);
+                d[j].name[0] = '\0';
+            }
+            if (i == 0)
+                memcpy(d0, d, BlockSize);
+        }
+        std::stable_sort(ents.begin(), ents.end(),
+                [](const SODirEntry & a, const SODirEntry & b)
+                { return soDirIndexHash(a.name) < soDirIndexHash(b.name); });
+
+        /* lay the leaves out, half full, and their index entries */
+        uint32_t nleaves = std::max((uint32_t)1, (uint32_t)((ents.size() + DIRINDEX_LEAF_FILL - 1) / DIRINDEX_LEAF_FILL));
+        uint32_t nnodes = (nleaves <= DIRINDEX_ENTRIES) ? 0 : (nleaves + DIRINDEX_NODE_FILL - 1) / DIRINDEX_NODE_FILL;
+        if (nnodes > DIRINDEX_ENTRIES or 1 + nleaves > DIRINDEX_ROOT_FBN - nnodes)
+            throw SOException(ENOSPC, __FUNCTION__);
+
+        std::vector<SODirIndexEntry> lent(nleaves);
+        for (uint32_t k = 0; k < nleaves; k++)
+        {
+            uint32_t first = k * DIRINDEX_LEAF_FILL;
+            uint32_t n = std::min((uint32_t)ents.size() - std::min(first, (uint32_t)ents.size()),
+                    (uint32_t)DIRINDEX_LEAF_FILL);
+            soDirIndexFillLeaf(d, ents.data() + first, n);
+            soWriteFileBlock(pih, 1 + k, d);
+
+            lent[k].fbn = 1 + k;
+            if (k == 0)
+                lent[k].hash = 0;
+            else
+            {
+                uint32_t h = soDirIndexHash(ents[first].name);
+                lent[k].hash = (h == soDirIndexHash(ents[first - 1].name)) ? (h | 1) : h;
+            }
+        }
+
+        /* old blocks beyond the leaves are left free of entries */
+        soDirIndexFillLeaf(d, NULL, 0);
+        for (uint32_t i = 1 + nleaves; i < nblocks; i++)
+            soWriteFileBlock(pih, i, d);
+        soWriteFileBlock(pih, 0, d0);
+        if (1 + nleaves > nblocks)
+        {
+            ip->size = (1 + nleaves) * BlockSize;
+            soITSaveInode(pih);
+        }
+
+        /* write the nodes, if any, and then the root */
+        SODirIndexBlock root;
+        soDirIndexInit(&root, (nnodes == 0) ? 1 : 2);
+        if (nnodes == 0)
+        {
+            root.count = nleaves;
+            memcpy(root.entry, lent.data(), nleaves * sizeof(SODirIndexEntry));
+        }
+        else
+        {
+            SODirIndexBlock node;
+            for (uint32_t k = 0; k < nnodes; k++)
+            {
+                soDirIndexInit(&node, 1);
+                uint32_t first = k * DIRINDEX_NODE_FILL;
+                node.count = std::min(nleaves - first, (uint32_t)DIRINDEX_NODE_FILL);
+                memcpy(node.entry, &lent[first], node.count * sizeof(SODirIndexEntry));
+                soWriteFileBlock(pih, soDirIndexNodeFbn(k), &node);
+
+                root.entry[k].hash = lent[first].hash;
+                root.entry[k].fbn = soDirIndexNodeFbn(k);
+            }
+            root.count = root.nnodes = nnodes;
+        }
+        soWriteFileBlock(pih, DIRINDEX_ROOT_FBN, &root);
+    }
+
+    /* ***************************************** */
+
+    uint32_t soDirIndexGet(int pih, const char *name)
+    {
+        soProbe(208, "%s(%d, %s)\n", __FUNCTION__, pih, name);
+
+        if (name[0] == '\0' or strchr(name, '/') != NULL)
+            throw SOException(EINVAL, __FUNCTION__);
+
+        SODirEntry d[DirentriesPerBlock];
+
+        /* "." and ".." are not indexed */
+        if (strcmp(name, ".") == 0 or strcmp(name, "..") == 0)
+        {
+            soReadFileBlock(pih, 0, d);
+            int j = soDirIndexFind(d, name);
+            return (j < 0) ? NullReference : d[j].in;
+        }
+
+        SODirIndexPath path;
+        int j = soDirIndexLookup(pih, name, path, d);
+        return (j < 0) ? NullReference : d[j].in;
+    }
+
+    /* ***************************************** */
+
+    void soDirIndexAdd(int pih, const char *name, uint32_t cin)
+    {
+        soProbe(209, "%s(%d, %s, %u)\n", __FUNCTION__, pih, name, cin);
+
+        soDirIndexCheckName(name, __FUNCTION__);
+
+        SODirEntry d[DirentriesPerBlock];
+        SODirIndexPath path;
+        if (soDirIndexLookup(pih, name, path, d) >= 0)
+            throw SOException(EEXIST, __FUNCTION__);
+
+        SODirEntry ne;
+        memset(&ne, 0, sizeof(ne));
+        strcpy(ne.name, name);
+        ne.in = cin;
+
+        /* use a free slot in the leaves of the hash */
+        uint32_t h = soDirIndexHash(name);
+        soDirIndexProbe(pih, h, path);
+        uint32_t lfbn;
+        while (true)
+        {
+            lfbn = soDirIndexTable(path)->entry[soDirIndexPos(path)].fbn;
+            soReadFileBlock(pih, lfbn, d);
+            for (uint32_t j = 0; j < DirentriesPerBlock; j++)
+            {
+                if (d[j].name[0] == '\0')
+                {
+                    d[j] = ne;
+                    soWriteFileBlock(pih, lfbn, d);
+                    return;
+                }
+            }
+            if (not soDirIndexNext(pih, h, path))
+                break;
+        }
+
+        /*
+         * the last of them is full: split its entries, plus the new one, by hash,
+         * taking the boundary closest to the middle; if all hashes are equal, the
+         * upper half is flagged as continuing the lower one
+         */
+        SODirEntry all[DirentriesPerBlock + 1];
+        memcpy(all, d, BlockSize);
+        all[DirentriesPerBlock] = ne;
+        std::stable_sort(all, all + DirentriesPerBlock + 1,
+                [](const SODirEntry & a, const SODirEntry & b)
+                { return soDirIndexHash(a.name) < soDirIndexHash(b.name); });
+
+        uint32_t n = DirentriesPerBlock + 1;
+        uint32_t m = 0;
+        for (uint32_t k = 0; k < n / 2 and m == 0; k++)
+        {
+            if (soDirIndexHash(all[n / 2 - k - 1].name) != soDirIndexHash(all[n / 2 - k].name))
+                m = n / 2 - k;
+            else if (n / 2 + k + 1 < n and
+                    soDirIndexHash(all[n / 2 + k].name) != soDirIndexHash(all[n / 2 + k + 1].name))
+                m = n / 2 + k + 1;
+        }
+        uint32_t shash;
+        if (m == 0)
+        {
+            m = n / 2;
+            shash = soDirIndexHash(all[m].name) | 1;
+        }
+        else
+            shash = soDirIndexHash(all[m].name);
+
+        /*
+         * the upper part goes to a new leaf, appended to the directory;
+         * the room in the index is checked, and the new blocks allocated, before
+         * any block is written, so running out of either leaves the directory as it was
+         */
+        SOInode *ip = soITGetInodePointer(pih);
+        uint32_t nfbn = ip->size / BlockSize;
+        uint32_t needed = soDirIndexNodesNeeded(path);
+        if (nfbn >= soDirIndexNodeFbn(path.root.nnodes + std::max(needed, 1u) - 1))
+            throw SOException(ENOSPC, __FUNCTION__);
+
+        for (uint32_t k = 0; k < needed; k++)
+        {
+            uint32_t fbn = soDirIndexNodeFbn(path.root.nnodes + k);
+            if (soGetFileBlock(pih, fbn) == NullReference)
+                soAllocFileBlock(pih, fbn);
+        }
+        if (soGetFileBlock(pih, nfbn) == NullReference)
+            soAllocFileBlock(pih, nfbn);
+
+        soDirIndexFillLeaf(d, all + m, n - m);
+        soWriteFileBlock(pih, nfbn, d);
+        ip->size += BlockSize;
+        soITSaveInode(pih);
+        soDirIndexFillLeaf(d, all, m);
+        soWriteFileBlock(pih, lfbn, d);
+
+        soDirIndexInsert(pih, path, shash, nfbn);
+    }
+
+    /* ***************************************** */
+
+    uint32_t soDirIndexDelete(int pih, const char *name)
+    {
+        soProbe(210, "%s(%d, %s)\n", __FUNCTION__, pih, name);
+
+        soDirIndexCheckName(name, __FUNCTION__);
+
+        SODirEntry d[DirentriesPerBlock];
+        SODirIndexPath path;
+        int j = soDirIndexLookup(pih, name, path, d);
+        if (j < 0)
+            throw SOException(ENOENT, __FUNCTION__);
+
+        /* leaves are not merged when they get empty */
+        uint32_t in = d[j].in;
+        memset(d[j].name, '\0', SOFS18_MAX_NAME + 1);
+        d[j].in = NullReference;
+        soWriteFileBlock(pih, soDirIndexTable(path)->entry[soDirIndexPos(path)].fbn, d);
+        return in;
+    }
+
+    /* ***************************************** */
+
+    void soDirIndexRename(int pih, const char *name, const char *newName)
+    {
+        soProbe(211, "%s(%d, %s, %s)\n", __FUNCTION__, pih, name, newName);
+
+        soDirIndexCheckName(name, __FUNCTION__);
+        soDirIndexCheckName(newName, __FUNCTION__);
+
+        uint32_t in = soDirIndexGet(pih, name);
+        if (in == NullReference)
+            throw SOException(ENOENT, __FUNCTION__);
+        if (soDirIndexGet(pih, newName) != NullReference)
+            throw SOException(EEXIST, __FUNCTION__);
+
+        /* 
+         * the new name hashes, most probably, to another leaf, which may have to be split;
+         * it is added first, so the entry is not lost if that fails 
+         */
+        soDirIndexAdd(pih, newName, in);
+        soDirIndexDelete(pih, name);
+    }
+
+    /* ***************************************** */
+
+    /* the entries of the current leaf whose key is not below k, in hash order */
+    static void soDirIndexLeafEntries(int pih, SODirIndexPath & path, uint32_t k,
+            std::vector<SODirEntry> & ents)
+    {
+        SODirEntry d[DirentriesPerBlock];
+        soReadFileBlock(pih, soDirIndexTable(path)->entry[soDirIndexPos(path)].fbn, d);
+
+        ents.clear();
+        for (uint32_t j = 0; j < DirentriesPerBlock; j++)
+            if (d[j].name[0] != '\0' and soDirIndexKey(d[j].name) >= k)
+                ents.push_back(d[j]);
+        std::stable_sort(ents.begin(), ents.end(),
+                [](const SODirEntry & a, const SODirEntry & b)
+                { return soDirIndexHash(a.name) < soDirIndexHash(b.name); });
+    }
+
+    /* ***************************************** */
+
+    void soDirIndexReaddir(int pih, int32_t pos, SODirIndexFiller filler, void *ctx)
+    {
+        soProbe(212, "%s(%d, %d, %p, %p)\n", __FUNCTION__, pih, pos, filler, ctx);
+
+        if (pos < (int32_t)DIRINDEX_FIRST_POS)
+            throw SOException(EINVAL, __FUNCTION__);
+
+        /* past the last possible key, there is nothing left */
+        uint32_t k = pos - DIRINDEX_FIRST_POS;
+        if (k > (UINT32_MAX >> 2))
+            return;
+
+        SODirIndexPath path;
+        soDirIndexProbe(pih, k << 2, path);
+        std::vector<SODirEntry> batch;
+        std::vector<SODirEntry> next;
+        std::vector<int32_t> npos;
+        soDirIndexLeafEntries(pih, path, k, batch);
+        while (true)
+        {
+            /*
+             * the entries of a key may spread over consecutive leaves;
+             * they are given together, so that resuming from their position skips none
+             */
+            bool more = soDirIndexNextLeaf(pih, path);
+            if (more)
+            {
+                soDirIndexLeafEntries(pih, path, k, next);
+                if (not batch.empty() and not next.empty()
+                        and soDirIndexKey(next.front().name) == soDirIndexKey(batch.back().name))
+                {
+                    batch.insert(batch.end(), next.begin(), next.end());
+                    continue;
+                }
+            }
+
+            if (not batch.empty())
+            {
+                npos.resize(batch.size());
+                for (uint32_t i = 0; i < batch.size(); i++)
+                {
+                    uint32_t nk = (i + 1 < batch.size()) ? soDirIndexKey(batch[i + 1].name)
+                        : soDirIndexKey(batch[i].name) + 1;
+                    npos[i] = DIRINDEX_FIRST_POS + nk;
+                }
+                if (filler(ctx, batch.data(), npos.data(), batch.size()) != 0)
+                    return;
+            }
+
+            if (not more)
+                return;
+            batch.swap(next);
+        }
+    }
+
+    /* ***************************************** */
+};
@@ -3,6 +3,7 @@
 #include "work_direntries.h"
 
 #include "core.h"
+#include "dal.h"
 
 #include <errno.h>
 #include <string.h>
@@ -13,10 +14,21 @@ namespace sofs18
 
     uint32_t soGetDirEntry(int pih, const char *name)
     {
-        if (soBinSelected(201))
-            return bin::soGetDirEntry(pih, name);
+        /* names already looked up, found or not, are resolved in memory */
+        uint32_t pin = soITGetInodeID(pih);
+        uint32_t cin;
+        if (soDentryCacheGet(pin, name, &cin))
+            return cin;
+
+        if (soDirIndexed(pih))
+            cin = soDirIndexGet(pih, name);
+        else if (soBinSelected(201))
+            cin = bin::soGetDirEntry(pih, name);
         else
-            return work::soGetDirEntry(pih, name);
+            cin = work::soGetDirEntry(pih, name);
+
+        soDentryCachePut(pin, name, cin);
+        return cin;
     }
 
 };
@@ -3,6 +3,7 @@
 #include "work_direntries.h"
 
 #include "core.h"
+#include "dal.h"
 
 #include <string.h>
 #include <errno.h>
@@ -13,6 +14,13 @@ namespace sofs18
 
     void soRenameDirEntry(int pih, const char *name, const char *newName)
     {
+        uint32_t pin = soITGetInodeID(pih);
+        soDentryCacheInvalidate(pin, name);
+        soDentryCacheInvalidate(pin, newName);
+
+        if (soDirIndexed(pih))
+            return soDirIndexRename(pih, name, newName);
+
         if (soBinSelected(204))
             return bin::soRenameDirEntry(pih, name, newName);
         else
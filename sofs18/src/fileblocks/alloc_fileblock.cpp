@@ -1,8 +1,11 @@
 #include "fileblocks.h"
 #include "bin_fileblocks.h"
 #include "work_fileblocks.h"
+#include "ext_fileblocks.h"
 
 #include "core.h"
+#include "dal.h"
+#include "freelists.h"
 
 #include <errno.h>
 
@@ -13,10 +16,29 @@ namespace sofs18
 
     uint32_t soAllocFileBlock(int ih, uint32_t fbn)
     {
-        if (soBinSelected(302))
-            return bin::soAllocFileBlock(ih, fbn);
-        else
-            return work::soAllocFileBlock(ih, fbn);
+        /* the blocks go, in a row, from the goal on */
+        soSetAllocGoal(soGetFileBlockGoal(ih, fbn));
+
+        uint32_t bn;
+        try
+        {
+            if (ext::soUseExtents(ih))
+                bn = ext::soAllocFileBlock(ih, fbn);
+            else if (soBinSelected(302))
+                bn = bin::soAllocFileBlock(ih, fbn);
+            else
+                bn = work::soAllocFileBlock(ih, fbn);
+        }
+        catch (SOException & err)
+        {
+            soSetAllocGoal(NullReference);
+            throw;
+        }
+        soSetAllocGoal(NullReference);
+
+        /* indirect blocks may have been allocated or changed */
+        soBlockMapInvalidate(soITGetInodeID(ih));
+        return bn;
     }
 
 };
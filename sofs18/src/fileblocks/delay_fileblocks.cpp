@@ -0,0 +1,458 @@
+#include "fileblocks.h"
+
+#include "core.h"
+#include "dal.h"
+#include "freelists.h"
+
+#include <inttypes.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace sofs18
+{
+
+    /* ***************************************** */
+
+    /* delayed blocks of an inode */
+    struct SODelayedFile
+    {
+        std::map<uint32_t, std::vector<uint8_t> > blocks;  ///< contents, by file block number
+        time_t since;                                       ///< when the oldest one was delayed
+        uint32_t claim;                                     ///< data blocks claimed for them
+        int error;                                          ///< error of a failed flush, not reported yet
+    };
+
+    static uint32_t dbmax = FILEBLOCKS_DELAY_DEFAULT_MAX;       ///< maximum number of delayed blocks
+    static std::unordered_map<uint32_t, SODelayedFile> dbfiles; ///< delayed blocks, by inode number
+    static std::atomic<uint32_t> dbtotal(0);                    ///< number of delayed blocks
+
+    /*
+     * access to the delayed blocks by concurrent threads;
+     * it is held while a file is flushed, so its blocks are never seen allocated but not written
+     */
+    static std::mutex dblock;
+
+    /* ***************************************** */
+
+    /*
+     * data blocks a file with count delayed blocks may need:
+     * the blocks themselves, plus indirect blocks, or extent tree blocks,
+     * whose leaves, once split, are at least half full
+     */
+    static uint32_t soDelayNeed(uint32_t count)
+    {
+        if (count == 0)
+            return 0;
+        return count + count / (EXTENT_ENTRIES / 2) + 2;
+    }
+
+    /* ***************************************** */
+
+    /* give up what a file claims beyond the needs of its delayed blocks */
+    static void soDelayTrimClaim(SODelayedFile & f)
+    {
+        uint32_t need = soDelayNeed(f.blocks.size());
+        if (f.claim > need)
+        {
+            soUnclaimDataBlocks(f.claim - need);
+            f.claim = need;
+        }
+    }
+
+    /* ***************************************** */
+
+    /* report the error of a failed flush of a file, once */
+    static void soDelayReportError(SODelayedFile & f)
+    {
+        if (f.error != 0)
+        {
+            int en = f.error;
+            f.error = 0;
+            throw SOException(en, __FUNCTION__);
+        }
+    }
+
+    /* ***************************************** */
+
+    /*
+     * write the delayed blocks of a file, with the lock held, spending the blocks claimed for them;
+     * the entry is removed, or, on error, kept with the blocks not written yet
+     */
+    static void soFlushLocked(int ih, std::unordered_map<uint32_t, SODelayedFile>::iterator it)
+    {
+        SODelayedFile & f = it->second;
+        std::map<uint32_t, std::vector<uint8_t> > & blocks = f.blocks;
+        soSpendClaimedBlocks(f.claim);
+        try
+        {
+            while (not blocks.empty())
+            {
+                /* the next run of consecutive file blocks */
+                uint32_t ffbn = blocks.begin()->first;
+                uint32_t n = 0;
+                std::map<uint32_t, std::vector<uint8_t> >::iterator end = blocks.begin();
+                while (end != blocks.end() and end->first == ffbn + n)
+                {
+                    end++;
+                    n++;
+                }
+
+                /*
+                 * allocated as a whole;
+                 * blocks allocated by a flush that failed are not allocated again
+                 */
+                std::vector<uint32_t> bns(n);
+                soReserveFileBlocks(ih, ffbn, n);
+                for (uint32_t i = 0; i < n; i++)
+                {
+                    bns[i] = soGetFileBlock(ih, ffbn + i);
+                    if (bns[i] == NullReference)
+                        bns[i] = soAllocFileBlock(ih, ffbn + i);
+                }
+                soReleaseDataBlocks();
+
+                /* and written a run of contiguous data blocks at a time */
+                std::vector<uint8_t> buf;
+                std::map<uint32_t, std::vector<uint8_t> >::iterator b = blocks.begin();
+                uint32_t i = 0;
+                while (i < n)
+                {
+                    uint32_t j = i + 1;
+                    while (j < n and bns[j] == bns[j - 1] + 1)
+                        j++;
+                    buf.resize((j - i) * BlockSize);
+                    for (uint32_t k = 0; k < j - i; k++, b++)
+                        memcpy(&buf[k * BlockSize], b->second.data(), BlockSize);
+                    soWriteDataBlocks(bns[i], j - i, buf.data());
+                    i = j;
+                }
+
+                blocks.erase(blocks.begin(), end);
+                dbtotal -= n;
+            }
+            soITSaveInode(ih);
+        }
+        catch (SOException & err)
+        {
+            /* the blocks are kept, to be flushed again later */
+            soReleaseDataBlocks();
+            f.claim = soSpendClaimedBlocks(0);
+            f.since = time(NULL);
+            soDelayTrimClaim(f);
+            throw;
+        }
+        f.claim = soSpendClaimedBlocks(0);
+        soUnclaimDataBlocks(f.claim);
+        dbfiles.erase(it);
+    }
+
+    /* ***************************************** */
+
+    /*
+     * flush the delayed blocks of a file not open by the caller;
+     * the error, if any, is returned, and kept to be reported to the file
+     */
+    static int soFlushInode(uint32_t in, std::unordered_map<uint32_t, SODelayedFile>::iterator it)
+    {
+        try
+        {
+            int ih = soITOpenInode(in);
+            try
+            {
+                soFlushLocked(ih, it);
+            }
+            catch (SOException & err)
+            {
+                soITCloseInode(ih);
+                throw;
+            }
+            soITCloseInode(ih);
+        }
+        catch (SOException & err)
+        {
+            it = dbfiles.find(in);
+            if (it != dbfiles.end())
+                it->second.error = err.en;
+            return err.en;
+        }
+        return 0;
+    }
+
+    /* ***************************************** */
+
+    /* called by soSyncDisk; errors are left to be reported to the files */
+    static void soSyncDelayedBlocks()
+    {
+        try
+        {
+            soFlushAllDelayedBlocks();
+        }
+        catch (SOException & err)
+        {
+        }
+    }
+
+    /* ***************************************** */
+
+    bool soDelayFileBlock(int ih, uint32_t fbn, void *buf)
+    {
+        soProbe(307, "%s(%d, %u, %p)\n", __FUNCTION__, ih, fbn, buf);
+
+        if (buf == NULL)
+            throw SOException(EINVAL, __FUNCTION__);
+
+        uint32_t in = soITGetInodeID(ih);
+        std::lock_guard<std::mutex> guard(dblock);
+
+        /* from now on, a sync also writes back the delayed blocks */
+        static bool synced = false;
+        if (not synced)
+        {
+            soSetSyncHandler(soSyncDelayedBlocks);
+            synced = true;
+        }
+
+        std::unordered_map<uint32_t, SODelayedFile>::iterator it = dbfiles.find(in);
+
+        /* a block already delayed is just replaced */
+        if (it != dbfiles.end())
+        {
+            soDelayReportError(it->second);
+            std::map<uint32_t, std::vector<uint8_t> >::iterator b = it->second.blocks.find(fbn);
+            if (b != it->second.blocks.end())
+            {
+                memcpy(b->second.data(), buf, BlockSize);
+                return true;
+            }
+        }
+
+        /*
+         * the blocks the file will need are claimed, so they are there when it is flushed;
+         * when the maximum is reached, or there is no room left to claim,
+         * the blocks of this file are given their place first
+         */
+        if (dbmax == 0)
+            return false;
+        uint32_t count = (it == dbfiles.end() ? 0 : it->second.blocks.size());
+        uint32_t claim = (it == dbfiles.end() ? 0 : it->second.claim);
+        bool room = (dbtotal < dbmax and soClaimDataBlocks(soDelayNeed(count + 1) - claim));
+        if (not room and it != dbfiles.end())
+        {
+            soFlushLocked(ih, it);
+            it = dbfiles.end();
+            room = (dbtotal < dbmax and soClaimDataBlocks(soDelayNeed(1)));
+        }
+        if (not room)
+            return false;
+
+        if (it == dbfiles.end())
+        {
+            it = dbfiles.insert(std::make_pair(in, SODelayedFile())).first;
+            it->second.since = time(NULL);
+            it->second.claim = 0;
+            it->second.error = 0;
+        }
+        it->second.claim = soDelayNeed(it->second.blocks.size() + 1);
+        uint8_t *p = (uint8_t *)buf;
+        it->second.blocks[fbn].assign(p, p + BlockSize);
+        dbtotal++;
+        return true;
+    }
+
+    /* ***************************************** */
+
+    uint32_t soReadDelayedBlocks(int ih, uint32_t ffbn, uint32_t count, void *buf)
+    {
+        soProbe(308, "%s(%d, %u, %u, %p)\n", __FUNCTION__, ih, ffbn, count, buf);
+
+        if (dbtotal == 0 or count == 0)
+            return 0;
+
+        uint32_t in = soITGetInodeID(ih);
+        std::lock_guard<std::mutex> guard(dblock);
+
+        std::unordered_map<uint32_t, SODelayedFile>::iterator it = dbfiles.find(in);
+        if (it == dbfiles.end())
+            return 0;
+
+        uint32_t n = 0;
+        std::map<uint32_t, std::vector<uint8_t> > & blocks = it->second.blocks;
+        std::map<uint32_t, std::vector<uint8_t> >::iterator b = blocks.lower_bound(ffbn);
+        for (; b != blocks.end() and b->first - ffbn < count; b++, n++)
+        {
+            if (buf != NULL)
+                memcpy((uint8_t *)buf + (b->first - ffbn) * BlockSize, b->second.data(), BlockSize);
+        }
+        return n;
+    }
+
+    /* ***************************************** */
+
+    void soDropDelayedBlocks(int ih, uint32_t ffbn, uint32_t count)
+    {
+        soProbe(309, "%s(%d, %u, %u)\n", __FUNCTION__, ih, ffbn, count);
+
+        if (dbtotal == 0 or count == 0)
+            return;
+
+        uint32_t in = soITGetInodeID(ih);
+        std::lock_guard<std::mutex> guard(dblock);
+
+        std::unordered_map<uint32_t, SODelayedFile>::iterator it = dbfiles.find(in);
+        if (it == dbfiles.end())
+            return;
+
+        std::map<uint32_t, std::vector<uint8_t> > & blocks = it->second.blocks;
+        std::map<uint32_t, std::vector<uint8_t> >::iterator b = blocks.lower_bound(ffbn);
+        while (b != blocks.end() and b->first - ffbn < count)
+        {
+            b = blocks.erase(b);
+            dbtotal--;
+        }
+        soDelayTrimClaim(it->second);
+        if (blocks.empty())
+            dbfiles.erase(it);
+    }
+
+    /* ***************************************** */
+
+    void soFlushDelayedBlocks(int ih)
+    {
+        soProbe(310, "%s(%d)\n", __FUNCTION__, ih);
+
+        if (dbtotal == 0)
+            return;
+
+        uint32_t in = soITGetInodeID(ih);
+        std::lock_guard<std::mutex> guard(dblock);
+
+        /* the error of a failed flush is reported, even if this one succeeds */
+        std::unordered_map<uint32_t, SODelayedFile>::iterator it = dbfiles.find(in);
+        if (it != dbfiles.end())
+        {
+            int en = it->second.error;
+            it->second.error = 0;
+            soFlushLocked(ih, it);
+            if (en != 0)
+                throw SOException(en, __FUNCTION__);
+        }
+    }
+
+    /* ***************************************** */
+
+    void soFlushOldDelayedBlocks(int ih)
+    {
+        soProbe(310, "%s(%d)\n", __FUNCTION__, ih);
+
+        if (dbtotal == 0)
+            return;
+
+        uint32_t in = soITGetInodeID(ih);
+        std::lock_guard<std::mutex> guard(dblock);
+
+        /* an error is kept to be reported later, as the caller has already done its job */
+        std::unordered_map<uint32_t, SODelayedFile>::iterator it = dbfiles.find(in);
+        if (it != dbfiles.end() and time(NULL) - it->second.since > FILEBLOCKS_DELAY_MAX_AGE)
+        {
+            try
+            {
+                soFlushLocked(ih, it);
+            }
+            catch (SOException & err)
+            {
+                it->second.error = err.en;
+            }
+        }
+    }
+
+    /* ***************************************** */
+
+    void soFlushAllDelayedBlocks()
+    {
+        soProbe(311, "%s()\n", __FUNCTION__);
+
+        std::lock_guard<std::mutex> guard(dblock);
+
+        /* all files are tried, the first error is reported */
+        std::vector<uint32_t> ins;
+        for (std::unordered_map<uint32_t, SODelayedFile>::iterator it = dbfiles.begin();
+                it != dbfiles.end(); it++)
+            ins.push_back(it->first);
+
+        int en = 0;
+        for (uint32_t i = 0; i < ins.size(); i++)
+        {
+            int err = soFlushInode(ins[i], dbfiles.find(ins[i]));
+            if (en == 0)
+                en = err;
+        }
+        if (en != 0)
+            throw SOException(en, __FUNCTION__);
+    }
+
+    /* ***************************************** */
+
+    void soFlushAllOldDelayedBlocks()
+    {
+        soProbe(319, "%s()\n", __FUNCTION__);
+
+        if (dbtotal == 0)
+            return;
+
+        std::lock_guard<std::mutex> guard(dblock);
+
+        /* errors are left to be reported to the files */
+        time_t now = time(NULL);
+        std::vector<uint32_t> ins;
+        for (std::unordered_map<uint32_t, SODelayedFile>::iterator it = dbfiles.begin();
+                it != dbfiles.end(); it++)
+        {
+            if (now - it->second.since > FILEBLOCKS_DELAY_MAX_AGE)
+                ins.push_back(it->first);
+        }
+        for (uint32_t i = 0; i < ins.size(); i++)
+            soFlushInode(ins[i], dbfiles.find(ins[i]));
+    }
+
+    /* ***************************************** */
+
+    void soDiscardAllDelayedBlocks()
+    {
+        soProbe(320, "%s()\n", __FUNCTION__);
+
+        std::lock_guard<std::mutex> guard(dblock);
+
+        for (std::unordered_map<uint32_t, SODelayedFile>::iterator it = dbfiles.begin();
+                it != dbfiles.end(); it++)
+            soUnclaimDataBlocks(it->second.claim);
+        dbfiles.clear();
+        dbtotal = 0;
+    }
+
+    /* ***************************************** */
+
+    uint32_t soDelayedBlockCount()
+    {
+        return dbtotal;
+    }
+
+    /* ***************************************** */
+
+    void soSetDelayMax(uint32_t nblocks)
+    {
+        soProbe(312, "%s(%u)\n", __FUNCTION__, nblocks);
+
+        std::lock_guard<std::mutex> guard(dblock);
+        dbmax = nblocks;
+    }
+
+    /* ***************************************** */
+};
+
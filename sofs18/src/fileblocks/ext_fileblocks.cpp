@@ -0,0 +1,495 @@
+#include "fileblocks.h"
+#include "ext_fileblocks.h"
+
+#include "core.h"
+#include "dal.h"
+#include "freelists.h"
+
+#include <inttypes.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+
+namespace sofs18
+{
+
+    /* ***************************************** */
+
+    /* are regular files given the extent format */
+    static bool extfiles = false;
+
+    /* ***************************************** */
+
+    void soSetFileExtents(bool on)
+    {
+        soProbe(313, "%s(%d)\n", __FUNCTION__, on);
+
+        extfiles = on;
+    }
+
+    /* ***************************************** */
+
+    namespace ext
+    {
+
+        /* maximum number of blocks of a file, the same as with d, i1 and i2 */
+        static const uint32_t MaxFileBlocks = N_DIRECT + N_INDIRECT * ReferencesPerBlock
+            + N_DOUBLE_INDIRECT * ReferencesPerBlock * ReferencesPerBlock;
+
+        /* ***************************************** */
+
+        static inline SOInodeExtents *soExtents(SOInode *ip)
+        {
+            return (SOInodeExtents *)ip->d;
+        }
+
+        /* ***************************************** */
+
+        /* number of extents in use in the inode */
+        static uint32_t soInlineCount(SOInodeExtents *ie)
+        {
+            uint32_t n = 0;
+            while (n < N_INLINE_EXTENTS and ie->extent[n].count > 0)
+                n++;
+            return n;
+        }
+
+        /* ***************************************** */
+
+        /* position of the last of the n extents starting at or before fbn, or -1 if none */
+        static int soExtentSearch(SOExtent *e, uint32_t n, uint32_t fbn)
+        {
+            int lo = 0, hi = n;
+            while (lo < hi)
+            {
+                int mid = (lo + hi) / 2;
+                if (e[mid].fbn <= fbn)
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+            return lo - 1;
+        }
+
+        /* ***************************************** */
+
+        /* position of the child of an index block covering fbn (the first one, if none does) */
+        static uint32_t soIndexSearch(SOExtentBlock *eb, uint32_t fbn)
+        {
+            uint32_t lo = 1, hi = eb->count;
+            while (lo < hi)
+            {
+                uint32_t mid = (lo + hi) / 2;
+                if (eb->index[mid].fbn <= fbn)
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+            return lo - 1;
+        }
+
+        /* ***************************************** */
+
+        static void soReadExtentBlock(uint32_t bn, SOExtentBlock *eb)
+        {
+            soReadDataBlock(bn, eb);
+            if (eb->magic != EXTENT_MAGIC
+                    or eb->count > ((eb->depth == 0) ? EXTENT_ENTRIES : EXTENT_INDEXES))
+                throw SOException(EIO, __FUNCTION__);
+        }
+
+        /* ***************************************** */
+
+        /* a new block of the extent tree, kept off the run the data blocks are going to */
+        static uint32_t soAllocExtentBlock(SOInode *ip, SOExtentBlock *eb, uint32_t depth)
+        {
+            uint32_t bn = sofs18::soAllocDataBlockApart();
+            ip->blkcnt++;
+
+            memset(eb, 0, sizeof(SOExtentBlock));
+            eb->magic = EXTENT_MAGIC;
+            eb->depth = depth;
+            return bn;
+        }
+
+        /* ***************************************** */
+
+        /* the extents where fbn is, or would be, and the leaf holding them, if any */
+        static SOExtent *soFindExtents(SOInode *ip, uint32_t fbn, SOExtentBlock *eb,
+                uint32_t *bn, uint32_t *n)
+        {
+            SOInodeExtents *ie = soExtents(ip);
+            if (ie->root == NullReference)
+            {
+                *bn = NullReference;
+                *n = soInlineCount(ie);
+                return ie->extent;
+            }
+
+            *bn = ie->root;
+            soReadExtentBlock(*bn, eb);
+            while (eb->depth > 0)
+            {
+                *bn = eb->index[soIndexSearch(eb, fbn)].bn;
+                soReadExtentBlock(*bn, eb);
+            }
+            *n = eb->count;
+            return eb->extent;
+        }
+
+        /* ***************************************** */
+
+        bool soHasExtents(int ih)
+        {
+            return soITGetInodePointer(ih)->i2[N_DOUBLE_INDIRECT - 1] == INODE_EXTENTS;
+        }
+
+        /* ***************************************** */
+
+        bool soUseExtents(int ih)
+        {
+            SOInode *ip = soITGetInodePointer(ih);
+            if (ip->i2[N_DOUBLE_INDIRECT - 1] == INODE_EXTENTS)
+                return true;
+            if (not extfiles or (ip->mode & S_IFMT) != S_IFREG or ip->blkcnt != 0)
+                return false;
+
+            soProbe(314, "%s(%d)\n", __FUNCTION__, ih);
+
+            SOInodeExtents *ie = soExtents(ip);
+            for (uint32_t i = 0; i < N_INLINE_EXTENTS; i++)
+            {
+                ie->extent[i].fbn = ie->extent[i].bn = NullReference;
+                ie->extent[i].count = 0;
+            }
+            ie->root = NullReference;
+            ie->magic = INODE_EXTENTS;
+            return true;
+        }
+
+        /* ***************************************** */
+
+        uint32_t soGetFileBlock(int ih, uint32_t fbn, uint32_t *count)
+        {
+            soProbe(315, "%s(%d, %u, %p)\n", __FUNCTION__, ih, fbn, count);
+
+            if (fbn >= MaxFileBlocks)
+                throw SOException(EINVAL, __FUNCTION__);
+
+            SOExtentBlock eb;
+            uint32_t bn, n;
+            SOExtent *e = soFindExtents(soITGetInodePointer(ih), fbn, &eb, &bn, &n);
+
+            int i = soExtentSearch(e, n, fbn);
+            if (i < 0 or fbn >= e[i].fbn + e[i].count)
+            {
+                if (count != NULL)
+                    *count = 0;
+                return NullReference;
+            }
+            if (count != NULL)
+                *count = e[i].fbn + e[i].count - fbn;
+            return e[i].bn + (fbn - e[i].fbn);
+        }
+
+        /* ***************************************** */
+
+        /* extend the extent ending right before fbn, if block bn follows it */
+        static bool soExtendExtent(SOInode *ip, uint32_t fbn, uint32_t bn)
+        {
+            if (fbn == 0)
+                return false;
+
+            SOExtentBlock eb;
+            uint32_t ebn, n;
+            SOExtent *e = soFindExtents(ip, fbn, &eb, &ebn, &n);
+
+            int i = soExtentSearch(e, n, fbn);
+            if (i < 0 or e[i].fbn + e[i].count != fbn or e[i].bn + e[i].count != bn)
+                return false;
+
+            e[i].count++;
+            if (ebn != NullReference)
+                soWriteDataBlock(ebn, &eb);
+            return true;
+        }
+
+        /* ***************************************** */
+
+        /*
+         * insert extent x into the subtree rooted at block bn;
+         * if the block has to be split, the new one, holding the upper part, is given in split
+         */
+        static bool soInsertExtent(SOInode *ip, uint32_t bn, SOExtent x, SOExtentIndex *split)
+        {
+            SOExtentBlock eb;
+            soReadExtentBlock(bn, &eb);
+
+            SOExtentBlock nb;
+            if (eb.depth == 0)
+            {
+                uint32_t pos = soExtentSearch(eb.extent, eb.count, x.fbn) + 1;
+                if (eb.count < EXTENT_ENTRIES)
+                {
+                    memmove(&eb.extent[pos + 1], &eb.extent[pos], (eb.count - pos) * sizeof(SOExtent));
+                    eb.extent[pos] = x;
+                    eb.count++;
+                    soWriteDataBlock(bn, &eb);
+                    return false;
+                }
+
+                /* a full leaf is split in halves, or, if x goes last, x goes alone to the new one */
+                SOExtent all[EXTENT_ENTRIES + 1];
+                memcpy(all, eb.extent, pos * sizeof(SOExtent));
+                all[pos] = x;
+                memcpy(&all[pos + 1], &eb.extent[pos], (eb.count - pos) * sizeof(SOExtent));
+                uint32_t keep = (pos == eb.count) ? eb.count : (eb.count + 1) / 2;
+
+                split->bn = soAllocExtentBlock(ip, &nb, 0);
+                nb.count = eb.count + 1 - keep;
+                memcpy(nb.extent, &all[keep], nb.count * sizeof(SOExtent));
+                eb.count = keep;
+                memcpy(eb.extent, all, keep * sizeof(SOExtent));
+                split->fbn = nb.extent[0].fbn;
+            }
+            else
+            {
+                uint32_t pos = soIndexSearch(&eb, x.fbn);
+                SOExtentIndex child;
+                if (not soInsertExtent(ip, eb.index[pos].bn, x, &child))
+                    return false;
+
+                /* the child was split, so the new one goes right after it */
+                pos++;
+                if (eb.count < EXTENT_INDEXES)
+                {
+                    memmove(&eb.index[pos + 1], &eb.index[pos],
+                            (eb.count - pos) * sizeof(SOExtentIndex));
+                    eb.index[pos] = child;
+                    eb.count++;
+                    soWriteDataBlock(bn, &eb);
+                    return false;
+                }
+
+                SOExtentIndex all[EXTENT_INDEXES + 1];
+                memcpy(all, eb.index, pos * sizeof(SOExtentIndex));
+                all[pos] = child;
+                memcpy(&all[pos + 1], &eb.index[pos], (eb.count - pos) * sizeof(SOExtentIndex));
+                uint32_t keep = (pos == eb.count) ? eb.count : (eb.count + 1) / 2;
+
+                split->bn = soAllocExtentBlock(ip, &nb, eb.depth);
+                nb.count = eb.count + 1 - keep;
+                memcpy(nb.index, &all[keep], nb.count * sizeof(SOExtentIndex));
+                eb.count = keep;
+                memcpy(eb.index, all, keep * sizeof(SOExtentIndex));
+                split->fbn = nb.index[0].fbn;
+            }
+
+            soWriteDataBlock(bn, &eb);
+            soWriteDataBlock(split->bn, &nb);
+            return true;
+        }
+
+        /* ***************************************** */
+
+        /* add a new extent, moving the extents from the inode to a tree when they do not fit */
+        static void soAddExtent(SOInode *ip, SOExtent x)
+        {
+            SOInodeExtents *ie = soExtents(ip);
+            SOExtentBlock eb;
+
+            if (ie->root == NullReference)
+            {
+                uint32_t n = soInlineCount(ie);
+                uint32_t pos = soExtentSearch(ie->extent, n, x.fbn) + 1;
+                if (n < N_INLINE_EXTENTS)
+                {
+                    memmove(&ie->extent[pos + 1], &ie->extent[pos], (n - pos) * sizeof(SOExtent));
+                    ie->extent[pos] = x;
+                    return;
+                }
+
+                uint32_t bn = soAllocExtentBlock(ip, &eb, 0);
+                memcpy(eb.extent, ie->extent, pos * sizeof(SOExtent));
+                eb.extent[pos] = x;
+                memcpy(&eb.extent[pos + 1], &ie->extent[pos], (n - pos) * sizeof(SOExtent));
+                eb.count = n + 1;
+                soWriteDataBlock(bn, &eb);
+
+                for (uint32_t i = 0; i < N_INLINE_EXTENTS; i++)
+                {
+                    ie->extent[i].fbn = ie->extent[i].bn = NullReference;
+                    ie->extent[i].count = 0;
+                }
+                ie->root = bn;
+                return;
+            }
+
+            /* a split root gets a new one on top */
+            SOExtentIndex split;
+            if (soInsertExtent(ip, ie->root, x, &split))
+            {
+                SOExtentBlock old;
+                soReadExtentBlock(ie->root, &old);
+                uint32_t bn = soAllocExtentBlock(ip, &eb, old.depth + 1);
+                eb.count = 2;
+                eb.index[0].fbn = (old.depth == 0) ? old.extent[0].fbn : old.index[0].fbn;
+                eb.index[0].bn = ie->root;
+                eb.index[1] = split;
+                soWriteDataBlock(bn, &eb);
+                ie->root = bn;
+            }
+        }
+
+        /* ***************************************** */
+
+        uint32_t soAllocFileBlock(int ih, uint32_t fbn)
+        {
+            soProbe(316, "%s(%d, %u)\n", __FUNCTION__, ih, fbn);
+
+            if (soGetFileBlock(ih, fbn) != NullReference)
+                throw SOException(EINVAL, __FUNCTION__);
+
+            SOInode *ip = soITGetInodePointer(ih);
+            uint32_t bn = sofs18::soAllocDataBlock();
+            ip->blkcnt++;
+            try
+            {
+                if (not soExtendExtent(ip, fbn, bn))
+                {
+                    SOExtent x = { fbn, bn, 1 };
+                    soAddExtent(ip, x);
+                }
+            }
+            catch (SOException & err)
+            {
+                sofs18::soFreeDataBlock(bn);
+                ip->blkcnt--;
+                throw;
+            }
+
+            soITSaveInode(ih);
+            return bn;
+        }
+
+        /* ***************************************** */
+
+        /* free the blocks of the n extents of e from file block ffbn on */
+        static void soCutExtents(SOInode *ip, SOExtent *e, uint32_t *n, uint32_t ffbn)
+        {
+            /* the first extent with blocks to free; only that one may keep some */
+            uint32_t i = soExtentSearch(e, *n, ffbn) + 1;
+            if (i > 0 and e[i - 1].fbn + e[i - 1].count > ffbn)
+                i--;
+
+            uint32_t kept = i;
+            for (uint32_t j = i; j < *n; j++)
+            {
+                uint32_t keep = (e[j].fbn < ffbn) ? ffbn - e[j].fbn : 0;
+                for (uint32_t k = keep; k < e[j].count; k++)
+                    sofs18::soFreeDataBlock(e[j].bn + k);
+                ip->blkcnt -= e[j].count - keep;
+                e[j].count = keep;
+                if (keep > 0)
+                    kept = j + 1;
+                else
+                    e[j].fbn = e[j].bn = NullReference;
+            }
+            *n = kept;
+        }
+
+        /* ***************************************** */
+
+        /* free the blocks of the subtree rooted at block bn from file block ffbn on; true if emptied */
+        static bool soCutExtentTree(SOInode *ip, uint32_t bn, uint32_t ffbn)
+        {
+            SOExtentBlock eb;
+            soReadExtentBlock(bn, &eb);
+
+            if (eb.depth == 0)
+                soCutExtents(ip, eb.extent, &eb.count, ffbn);
+            else
+            {
+                /* the child covering ffbn keeps its blocks before it, the following ones keep none */
+                uint32_t i = soIndexSearch(&eb, ffbn);
+                bool empty = soCutExtentTree(ip, eb.index[i].bn, ffbn);
+                for (uint32_t j = i + 1; j < eb.count; j++)
+                    soCutExtentTree(ip, eb.index[j].bn, 0);
+                eb.count = empty ? i : i + 1;
+            }
+
+            if (eb.count == 0)
+            {
+                sofs18::soFreeDataBlock(bn);
+                ip->blkcnt--;
+                return true;
+            }
+            soWriteDataBlock(bn, &eb);
+            return false;
+        }
+
+        /* ***************************************** */
+
+        void soFreeFileBlocks(int ih, uint32_t ffbn)
+        {
+            soProbe(317, "%s(%d, %u)\n", __FUNCTION__, ih, ffbn);
+
+            SOInode *ip = soITGetInodePointer(ih);
+            SOInodeExtents *ie = soExtents(ip);
+            if (ie->root != NullReference)
+            {
+                if (soCutExtentTree(ip, ie->root, ffbn))
+                    ie->root = NullReference;
+            }
+            else
+            {
+                uint32_t n = soInlineCount(ie);
+                soCutExtents(ip, ie->extent, &n, ffbn);
+            }
+
+            /* a file left with no blocks gets the usual format back */
+            if (ie->root == NullReference and soInlineCount(ie) == 0)
+            {
+                for (uint32_t i = 0; i < N_DIRECT; i++)
+                    ip->d[i] = NullReference;
+                for (uint32_t i = 0; i < N_INDIRECT; i++)
+                    ip->i1[i] = NullReference;
+                for (uint32_t i = 0; i < N_DOUBLE_INDIRECT; i++)
+                    ip->i2[i] = NullReference;
+            }
+            soITSaveInode(ih);
+        }
+
+        /* ***************************************** */
+
+        void soReadFileBlocks(int ih, uint32_t ffbn, uint32_t count, void *buf)
+        {
+            soProbe(318, "%s(%d, %u, %u, %p)\n", __FUNCTION__, ih, ffbn, count, buf);
+
+            /* a lookup per extent */
+            uint8_t *p = (uint8_t *)buf;
+            uint32_t i = 0;
+            while (i < count)
+            {
+                uint32_t n;
+                uint32_t bn = soGetFileBlock(ih, ffbn + i, &n);
+                if (bn == NullReference)
+                {
+                    memset(p + (size_t)i * BlockSize, '\0', BlockSize);
+                    i++;
+                    continue;
+                }
+                n = std::min(n, count - i);
+                soReadDataBlocks(bn, n, p + (size_t)i * BlockSize);
+                i += n;
+            }
+        }
+
+        /* ***************************************** */
+
+    };
+
+};
+
@@ -0,0 +1,43 @@
+/**
+ *  \file
+ *  \brief Extent version of the functions to manage file blocks
+ *
+ *  \remarks Refer to the main \c fileblocks header file for documentation;
+ *      these are used, instead of the bin and work ones, for inodes mapped by extents
+ *      (see \c SOInodeExtents)
+ */
+
+#ifndef __SOFS18_FILEBLOCKS_EXT__
+#define __SOFS18_FILEBLOCKS_EXT__
+
+#include <inttypes.h>
+#include <stddef.h>
+
+namespace sofs18
+{
+    namespace ext
+    {
+
+        /* is the inode mapped by extents */
+        bool soHasExtents(int ih);
+
+        /*
+         * is the inode to be mapped by extents: it is, or it is a regular file with no blocks
+         * and new files are to be mapped by extents, in which case it is given the format
+         */
+        bool soUseExtents(int ih);
+
+        /* if count is not NULL, the number of blocks contiguous from fbn on is stored there */
+        uint32_t soGetFileBlock(int ih, uint32_t fbn, uint32_t *count = NULL);
+
+        uint32_t soAllocFileBlock(int ih, uint32_t fbn);
+
+        void soFreeFileBlocks(int ih, uint32_t ffbn);
+
+        void soReadFileBlocks(int ih, uint32_t ffbn, uint32_t count, void *buf);
+
+    };
+
+};
+
+#endif             /* __SOFS18_FILEBLOCKS_EXT__ */
@@ -54,6 +54,10 @@ namespace sofs18
      *  \li Assume \c ih is a valid handler of an inode in use
      *  \li Error \c EINVAL must be thrown if \c fbn is not valid
      *  \li when calling a function of any layer, use the main version (sofs18::«func»(...)).
+     *  \li the data block, and any indirect block needed, are allocated from the goal
+     *      given by soGetFileBlockGoal onwards (see soSetAllocGoal).
+     *  \li a regular file with no blocks is first given the extent format,
+     *      if chosen with soSetFileExtents.
      *
      *  \return the number of the allocated block
      */
@@ -98,6 +102,70 @@ namespace sofs18
 
     /* *************************************************** */
 
+    /**
+     *  \brief Read a run of consecutive file blocks.
+     *
+     *  Same as calling soReadFileBlock for file blocks \c ffbn to \c ffbn+count-1,
+     *  but file blocks mapped onto contiguous data blocks are transferred
+     *  together, in a single disk operation.
+     *  It is the file level of the multi-block transfers of soReadDataBlocks;
+     *  soReadHandle reads its runs of whole blocks through it.
+     *
+     *  \param ih inode handler
+     *  \param ffbn first file block number
+     *  \param count number of file blocks to read
+     *  \param buf pointer to the buffer where data must be read into;
+     *      it must have room for \c count blocks
+     *
+     *  \remarks
+     *
+     *  \li Unallocated file blocks are returned filled with the character null.
+     *  \li when calling a function of any layer, use the main version (sofs18::«func»(...)).
+     */
+    void soReadFileBlocks(int ih, uint32_t ffbn, uint32_t count, void *buf);
+
+    /* *************************************************** */
+
+    /**
+     *  \brief default maximum size of the readahead window, in blocks
+     */
+#define READAHEAD_DEFAULT_MAX 256
+
+    /**
+     *  \brief Detect sequential reading of a file and load the blocks that follow.
+     *
+     *  Called after file blocks \c ffbn to \c ffbn+count-1 are read.
+     *  For every inode, the position of the last read and a readahead window are kept.
+     *  A read following the previous one, or starting at the beginning of the file,
+     *  opens a window a few times larger than the read;
+     *  when reading reaches the last part of the window, the next window is loaded,
+     *  twice or four times as large, up to the maximum size.
+     *  Any other read closes the window.
+     *  The data blocks of a window are brought into the raw block cache
+     *  with soPrefetchDataBlocks, one call per run of contiguous data blocks.
+     *
+     *  \param ih inode handler
+     *  \param ffbn first file block number read
+     *  \param count number of file blocks read
+     *
+     *  \remarks
+     *
+     *  \li Assume \c ih is a valid handler of an inode in use
+     *  \li Nothing is loaded past the end of the file, nor for unallocated file blocks.
+     */
+    void soReadAhead(int ih, uint32_t ffbn, uint32_t count);
+
+    /* *************************************************** */
+
+    /**
+     *  \brief Set the maximum size of the readahead window.
+     *
+     *  \param nblocks maximum number of file blocks loaded ahead (0 disables readahead)
+     */
+    void soSetReadAheadMax(uint32_t nblocks);
+
+    /* *************************************************** */
+
     /**
      *  \brief Write a file block.
      *
@@ -119,6 +187,219 @@ namespace sofs18
      */
     void soWriteFileBlock(int ih, uint32_t fbn, void *buf);
 
+    /* *************************************************** */
+
+    /**
+     *  \brief minimum number of file blocks to allocate for a reservation to be made
+     */
+#define FILEBLOCKS_RESERVE_MIN 2
+
+    /**
+     *  \brief Reserve data blocks for the file blocks of a range not allocated yet.
+     *
+     *  The data blocks are reserved for the calling thread (see soReserveDataBlocks),
+     *  preferably forming a run that starts right after the data block of the file block
+     *  preceding the first one missing, so the file is laid out sequentially on disk.
+     *  Nothing is done if fewer than \c FILEBLOCKS_RESERVE_MIN file blocks are missing.
+     *  The caller must call soReleaseDataBlocks once the range is written.
+     *
+     *  \param ih inode handler
+     *  \param ffbn first file block number of the range
+     *  \param count number of file blocks of the range
+     */
+    void soReserveFileBlocks(int ih, uint32_t ffbn, uint32_t count);
+
+    /* *************************************************** */
+
+    /**
+     *  \brief maximum number of files whose placement goal is kept
+     */
+#define FILEBLOCKS_GOAL_MAX_FILES 4096
+
+    /**
+     *  \brief Get the data block a file block should preferably be placed at.
+     *
+     *  It is the block right after the data block of the preceding file block, if allocated,
+     *  so the file is laid out sequentially on disk;
+     *  otherwise, the goal set for the file with soSetFileGoal, if any.
+     *
+     *  \param ih inode handler
+     *  \param fbn file block number
+     *  \return the goal, or \c NullReference if there is none
+     */
+    uint32_t soGetFileBlockGoal(int ih, uint32_t fbn);
+
+    /* *************************************************** */
+
+    /**
+     *  \brief Set where the blocks of a file with no preceding blocks should preferably go.
+     *
+     *  Goals are kept in memory only, for up to \c FILEBLOCKS_GOAL_MAX_FILES files.
+     *
+     *  \param in inode number
+     *  \param bn the preferred data block
+     */
+    void soSetFileGoal(uint32_t in, uint32_t bn);
+
+    /* *************************************************** */
+
+    /**
+     *  \brief Choose whether the blocks of regular files are to be mapped by extents.
+     *
+     *  A regular file is given the extent format (see \c SOInodeExtents)
+     *  when its first block is allocated, and goes back to the usual one
+     *  when it is left with no blocks; the format of other files is not changed.
+     *  soGetFileBlock, soAllocFileBlock, soFreeFileBlocks and the functions based on them
+     *  work on both formats; with extents, a single lookup maps a whole run of
+     *  contiguous blocks, so soReadFileBlocks reads each run with one lookup.
+     *
+     *  \param on true, if new files are to be mapped by extents (default: false)
+     */
+    void soSetFileExtents(bool on);
+
+    /* *************************************************** */
+
+    /**
+     *  \brief default maximum number of file blocks kept delayed, for all files
+     */
+#define FILEBLOCKS_DELAY_DEFAULT_MAX 4096
+
+    /**
+     *  \brief time, in seconds, after which the delayed blocks of a file are due to be flushed
+     */
+#define FILEBLOCKS_DELAY_MAX_AGE 5
+
+    /**
+     *  \brief Keep the contents of a file block not allocated yet in memory, with no data block.
+     *
+     *  The block is given a data block later, by soFlushDelayedBlocks,
+     *  together with the other delayed blocks of the file,
+     *  so runs of consecutive file blocks are allocated as a whole (see soReserveFileBlocks).
+     *  A file block already delayed is replaced.
+     *  The data blocks the delayed blocks of the file may need, including indirect
+     *  or extent tree blocks, are claimed (see soClaimDataBlocks), so no other allocation
+     *  takes them before the file is flushed.
+     *  When the maximum number of delayed blocks is reached, or the blocks can not be claimed,
+     *  the delayed blocks of the file are flushed first.
+     *  A new block is not delayed if delaying is disabled, or if there are still
+     *  no blocks to claim.
+     *  The error of a failed flush of the file not reported yet is thrown.
+     *
+     *  \param ih inode handler
+     *  \param fbn file block number, supposed not to be allocated
+     *  \param buf pointer to the buffer containing the block contents
+     *  \return true if the block was delayed, false if it must be written as usual
+     */
+    bool soDelayFileBlock(int ih, uint32_t fbn, void *buf);
+
+    /* *************************************************** */
+
+    /**
+     *  \brief Copy the delayed blocks of a range of file blocks into a buffer.
+     *
+     *  Blocks of the range that are not delayed are left untouched in the buffer.
+     *
+     *  \param ih inode handler
+     *  \param ffbn first file block number of the range
+     *  \param count number of file blocks of the range
+     *  \param buf pointer to the buffer, with room for \c count blocks;
+     *      if \c NULL, the delayed blocks are only counted
+     *  \return the number of delayed blocks in the range
+     */
+    uint32_t soReadDelayedBlocks(int ih, uint32_t ffbn, uint32_t count, void *buf);
+
+    /* *************************************************** */
+
+    /**
+     *  \brief Discard the delayed blocks of a range of file blocks.
+     *
+     *  \param ih inode handler
+     *  \param ffbn first file block number of the range
+     *  \param count number of file blocks of the range
+     */
+    void soDropDelayedBlocks(int ih, uint32_t ffbn, uint32_t count);
+
+    /* *************************************************** */
+
+    /**
+     *  \brief Allocate and write the delayed blocks of a file.
+     *
+     *  For each run of consecutive delayed blocks, data blocks are reserved and allocated
+     *  with soAllocFileBlock, and then written, in a single disk operation per run
+     *  of contiguous data blocks. The inode is saved afterwards.
+     *  On error, the delayed blocks not written yet are kept, to be flushed again later,
+     *  as their contents were already accepted.
+     *  The error of a previous failed flush of the file not reported yet is thrown,
+     *  even if this one succeeds.
+     *
+     *  \param ih inode handler
+     */
+    void soFlushDelayedBlocks(int ih);
+
+    /* *************************************************** */
+
+    /**
+     *  \brief Flush the delayed blocks of a file, if the oldest of them was delayed
+     *  more than \c FILEBLOCKS_DELAY_MAX_AGE seconds ago.
+     *
+     *  An error is not thrown, but kept to be reported by the next soDelayFileBlock
+     *  or soFlushDelayedBlocks of the file.
+     *
+     *  \param ih inode handler
+     */
+    void soFlushOldDelayedBlocks(int ih);
+
+    /* *************************************************** */
+
+    /**
+     *  \brief Flush the delayed blocks of all files whose oldest one was delayed
+     *  more than \c FILEBLOCKS_DELAY_MAX_AGE seconds ago.
+     *
+     *  It is meant to be called periodically, so the blocks of files no longer written
+     *  are not kept indefinitely.
+     *  The inodes are opened as needed, so no other thread may be using them.
+     *  Errors are not thrown, but kept to be reported to each file, as by soFlushOldDelayedBlocks.
+     */
+    void soFlushAllOldDelayedBlocks();
+
+    /* *************************************************** */
+
+    /**
+     *  \brief Flush the delayed blocks of all files.
+     *
+     *  All files are tried, and the first error is thrown; each error is also kept
+     *  to be reported to its file.
+     *  The inodes are opened as needed, so no other thread may be using them.
+     *  Once called with delayed blocks, soSyncDisk calls it too,
+     *  leaving the errors to be reported to the files.
+     */
+    void soFlushAllDelayedBlocks();
+
+    /* *************************************************** */
+
+    /**
+     *  \brief Discard the delayed blocks of all files, giving up the blocks claimed for them.
+     *
+     *  It is meant for when the disk is closed and the blocks could not be flushed.
+     */
+    void soDiscardAllDelayedBlocks();
+
+    /* *************************************************** */
+
+    /**
+     *  \brief Get the number of file blocks kept delayed, for all files.
+     */
+    uint32_t soDelayedBlockCount();
+
+    /* *************************************************** */
+
+    /**
+     *  \brief Set the maximum number of file blocks kept delayed.
+     *
+     *  \param nblocks maximum number of delayed blocks, for all files (0 disables delaying)
+     */
+    void soSetDelayMax(uint32_t nblocks);
+
     /* *************************************************** */
     /** @} close group fileblocks */
     /* *************************************************** */
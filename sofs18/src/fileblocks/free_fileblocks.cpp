@@ -1,8 +1,10 @@
 #include "fileblocks.h"
 #include "bin_fileblocks.h"
 #include "work_fileblocks.h"
+#include "ext_fileblocks.h"
 
 #include "core.h"
+#include "dal.h"
 
 #include <inttypes.h>
 #include <errno.h>
@@ -13,10 +15,19 @@ namespace sofs18
 
     void soFreeFileBlocks(int ih, uint32_t ffbn)
     {
-        if (soBinSelected(303))
+        /* delayed blocks to be freed are dropped, the others are given their place first */
+        soDropDelayedBlocks(ih, ffbn, NullReference - ffbn);
+        soFlushDelayedBlocks(ih);
+
+        if (ext::soHasExtents(ih))
+            ext::soFreeFileBlocks(ih, ffbn);
+        else if (soBinSelected(303))
             bin::soFreeFileBlocks(ih, ffbn);
         else
             work::soFreeFileBlocks(ih, ffbn);
+
+        /* indirect blocks may have been freed or changed */
+        soBlockMapInvalidate(soITGetInodeID(ih));
     }
 
 };
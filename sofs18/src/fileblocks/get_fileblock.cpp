@@ -1,6 +1,7 @@
 #include "fileblocks.h"
 #include "bin_fileblocks.h"
 #include "work_fileblocks.h"
+#include "ext_fileblocks.h"
 
 #include "core.h"
 
@@ -11,7 +12,9 @@ namespace sofs18
 
     uint32_t soGetFileBlock(int ih, uint32_t fbn)
     {
-        if (soBinSelected(301))
+        if (ext::soHasExtents(ih))
+            return ext::soGetFileBlock(ih, fbn);
+        else if (soBinSelected(301))
             return bin::soGetFileBlock(ih, fbn);
         else
             return work::soGetFileBlock(ih, fbn);
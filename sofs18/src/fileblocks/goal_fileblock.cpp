@@ -0,0 +1,55 @@
+#include "fileblocks.h"
+
+#include "core.h"
+#include "dal.h"
+
+#include <inttypes.h>
+
+#include <mutex>
+#include <unordered_map>
+
+namespace sofs18
+{
+
+    /* ***************************************** */
+
+    /* where the blocks of each file should go when no block precedes them, by inode number */
+    static std::unordered_map<uint32_t, uint32_t> fbgoals;
+
+    /* access to the goals by concurrent threads */
+    static std::mutex fbglock;
+
+    /* ***************************************** */
+
+    uint32_t soGetFileBlockGoal(int ih, uint32_t fbn)
+    {
+        soProbe(305, "%s(%d, %u)\n", __FUNCTION__, ih, fbn);
+
+        if (fbn > 0)
+        {
+            uint32_t prev = soGetFileBlock(ih, fbn - 1);
+            if (prev != NullReference)
+                return prev + 1;
+        }
+
+        std::lock_guard<std::mutex> guard(fbglock);
+        std::unordered_map<uint32_t, uint32_t>::iterator it = fbgoals.find(soITGetInodeID(ih));
+        return (it != fbgoals.end()) ? it->second : NullReference;
+    }
+
+    /* ***************************************** */
+
+    void soSetFileGoal(uint32_t in, uint32_t bn)
+    {
+        soProbe(306, "%s(%u, %u)\n", __FUNCTION__, in, bn);
+
+        std::lock_guard<std::mutex> guard(fbglock);
+
+        /* make room, the simple way */
+        if (fbgoals.size() >= FILEBLOCKS_GOAL_MAX_FILES)
+            fbgoals.clear();
+        fbgoals[in] = bn;
+    }
+
+};
+
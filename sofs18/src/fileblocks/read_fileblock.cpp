@@ -1,6 +1,7 @@
 #include "fileblocks.h"
 #include "bin_fileblocks.h"
 #include "work_fileblocks.h"
+#include "ext_fileblocks.h"
 
 #include "core.h"
 
@@ -12,10 +13,28 @@ namespace sofs18
 
     void soReadFileBlock(int ih, uint32_t fbn, void *buf)
     {
-        if (soBinSelected(331))
-            bin::soReadFileBlock(ih, fbn, buf);
+        /* a delayed block has no data block yet */
+        if (soReadDelayedBlocks(ih, fbn, 1, buf) == 0)
+        {
+            if (soBinSelected(331))
+                bin::soReadFileBlock(ih, fbn, buf);
+            else
+                work::soReadFileBlock(ih, fbn, buf);
+        }
+
+        /* load the blocks that follow, if the file is being read sequentially */
+        soReadAhead(ih, fbn, 1);
+    }
+
+    void soReadFileBlocks(int ih, uint32_t ffbn, uint32_t count, void *buf)
+    {
+        /* there is no bin version of this function */
+        if (ext::soHasExtents(ih))
+            ext::soReadFileBlocks(ih, ffbn, count, buf);
         else
-            work::soReadFileBlock(ih, fbn, buf);
+            work::soReadFileBlocks(ih, ffbn, count, buf);
+        soReadDelayedBlocks(ih, ffbn, count, buf);
+        soReadAhead(ih, ffbn, count);
     }
 
 };
@@ -0,0 +1,194 @@
+#include "fileblocks.h"
+
+#include "core.h"
+#include "dal.h"
+
+#include <inttypes.h>
+#include <errno.h>
+#include <string.h>
+
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+
+namespace sofs18
+{
+
+    /* ***************************************** */
+
+    /* readahead state of an inode */
+    struct SOReadAheadState
+    {
+        uint32_t start;     ///< first file block of the current window
+        uint32_t size;      ///< number of file blocks of the current window (0 if none)
+        uint32_t async;     ///< number of file blocks at the end of the window that trigger the next one
+        uint32_t prev;      ///< last file block read
+    };
+
+    /* maximum number of inodes with readahead state */
+#define READAHEAD_MAX_INODES 1024
+
+    static uint32_t ramax = READAHEAD_DEFAULT_MAX;      ///< maximum window size
+    static std::unordered_map<uint32_t, SOReadAheadState> rastate;   ///< state per inode number
+    static std::mutex ralock;                           ///< access to the state by concurrent threads
+
+    /* ***************************************** */
+
+    /* size of the first window, for a read of count blocks */
+    static uint32_t soReadAheadInitSize(uint32_t count)
+    {
+        uint32_t size = 1;
+        while (size < count)
+            size <<= 1;
+
+        if (size <= ramax / 32)
+            size *= 4;
+        else if (size <= ramax / 4)
+            size *= 2;
+        else
+            size = ramax;
+        return std::min(size, ramax);
+    }
+
+    /* ***************************************** */
+
+    /* size of the window following one of cur blocks */
+    static uint32_t soReadAheadNextSize(uint32_t cur)
+    {
+        uint32_t size = (cur < ramax / 16) ? 4 * cur : 2 * cur;
+        return std::min(size, ramax);
+    }
+
+    /* ***************************************** */
+
+    /* load file blocks first to last-1, coalescing runs of contiguous data blocks */
+    static void soReadAheadLoadRuns(int ih, uint32_t first, uint32_t last)
+    {
+        /* nothing past the end of the file */
+        SOInode *ip = soITGetInodePointer(ih);
+        uint32_t nfb = (ip->size + BlockSize - 1) / BlockSize;
+        last = std::min(last, nfb);
+
+        uint32_t run = NullReference;
+        uint32_t len = 0;
+        for (uint32_t fbn = first; fbn < last; fbn++)
+        {
+            uint32_t bn = soGetFileBlock(ih, fbn);
+            if (bn != NullReference and len > 0 and bn == run + len)
+            {
+                len++;
+                continue;
+            }
+            if (len > 0)
+                soPrefetchDataBlocks(run, len);
+            run = bn;
+            len = (bn == NullReference) ? 0 : 1;
+        }
+        if (len > 0)
+            soPrefetchDataBlocks(run, len);
+    }
+
+    /* ***************************************** */
+
+    /* 
+     * load file blocks first to last-1, coalescing runs of contiguous data blocks;
+     * readahead is only a hint, so failures are not reported 
+     */
+    static void soReadAheadLoad(int ih, uint32_t first, uint32_t last)
+    {
+        try
+        {
+            soReadAheadLoadRuns(ih, first, last);
+        }
+        catch (SOException & err)
+        {
+            soProbe(334, "%s: readahead of %u..%u failed (%s)\n", __FUNCTION__,
+                    first, last, strerror(err.en));
+        }
+    }
+
+    /* ***************************************** */
+
+    void soReadAhead(int ih, uint32_t ffbn, uint32_t count)
+    {
+        soProbe(334, "%s(%d, %u, %u)\n", __FUNCTION__, ih, ffbn, count);
+
+        if (ramax == 0 or count == 0)
+            return;
+
+        uint32_t in = soITGetInodeID(ih);
+
+        /* blocks to load, decided with the state locked but loaded without it */
+        uint32_t first = 0, end = 0;
+        {
+            std::lock_guard<std::mutex> guard(ralock);
+
+            std::unordered_map<uint32_t, SOReadAheadState>::iterator it = rastate.find(in);
+            if (it == rastate.end())
+            {
+                /* make room, the simple way */
+                if (rastate.size() >= READAHEAD_MAX_INODES)
+                    rastate.clear();
+                SOReadAheadState init = { 0, 0, 0, NullReference };
+                it = rastate.insert(std::make_pair(in, init)).first;
+            }
+            SOReadAheadState & ra = it->second;
+
+            uint32_t last = ffbn + count - 1;
+            uint32_t wend = ra.start + ra.size;
+            uint32_t marker = wend - ra.async;
+
+            /* reading reached the trigger area: load the next window */
+            if (ra.size > 0 and marker >= ffbn and marker <= last)
+            {
+                ra.start = wend;
+                ra.size = soReadAheadNextSize(ra.size);
+                ra.async = ra.size;
+                first = ra.start;
+                end = ra.start + ra.size;
+            }
+
+            /* 
+             * still inside the current window, or going on into it from the
+             * previous one: it is already loaded 
+             */
+            else if (ra.size > 0 and (ffbn >= ra.start or ffbn == ra.prev + 1) and last < wend)
+            {
+            }
+
+            /* sequential read: open a new window, starting at this read */
+            else if (ffbn == 0 or ffbn == ra.prev + 1)
+            {
+                ra.start = ffbn;
+                ra.size = std::max(soReadAheadInitSize(count), count);
+                ra.async = ra.size - count;
+                first = last + 1;
+                end = ra.start + ra.size;
+            }
+
+            /* random read: close the window */
+            else
+            {
+                ra.size = ra.async = 0;
+            }
+
+            ra.prev = last;
+        }
+
+        if (first < end)
+            soReadAheadLoad(ih, first, end);
+    }
+
+    /* ***************************************** */
+
+    void soSetReadAheadMax(uint32_t nblocks)
+    {
+        soProbe(335, "%s(%u)\n", __FUNCTION__, nblocks);
+
+        std::lock_guard<std::mutex> guard(ralock);
+        ramax = nblocks;
+        rastate.clear();
+    }
+
+    /* ***************************************** */
+};
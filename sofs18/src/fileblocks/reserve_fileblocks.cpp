@@ -0,0 +1,36 @@
+#include "fileblocks.h"
+
+#include "core.h"
+#include "dal.h"
+#include "freelists.h"
+
+#include <inttypes.h>
+
+namespace sofs18
+{
+
+    void soReserveFileBlocks(int ih, uint32_t ffbn, uint32_t count)
+    {
+        soProbe(304, "%s(%d, %u, %u)\n", __FUNCTION__, ih, ffbn, count);
+
+        /* the file blocks not allocated yet are counted, and the first of them located */
+        uint32_t missing = 0;
+        uint32_t first = 0;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            if (soGetFileBlock(ih, ffbn + i) == NullReference)
+            {
+                if (missing == 0)
+                    first = ffbn + i;
+                missing++;
+            }
+        }
+        if (missing < FILEBLOCKS_RESERVE_MIN)
+            return;
+
+        /* indirect blocks needed on the way take the blocks that follow the reserved ones */
+        soReserveDataBlocks(missing, soGetFileBlockGoal(ih, first));
+    }
+
+};
+
@@ -16,6 +16,9 @@ namespace sofs18
             bin::soWriteFileBlock(ih, fbn, buf);
         else
             work::soWriteFileBlock(ih, fbn, buf);
+
+        /* a delayed copy of the block would hide what was just written */
+        soDropDelayedBlocks(ih, fbn, 1);
     }
 
 };
@@ -7,17 +7,388 @@
 #include "work_freelists.h"
 
 #include "core.h"
+#include "dal.h"
+
+#include <errno.h>
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <vector>
 
 namespace sofs18
 {
 
-    uint32_t soAllocDataBlock()
+    /* blocks reserved by each thread, not yet handed out */
+    static thread_local std::deque<uint32_t> reserved;
+
+    /* has the thread a reservation, and which block should its next allocation get */
+    static thread_local bool reserving = false;
+    static thread_local uint32_t reservegoal = NullReference;
+
+    /* block the next allocation of each thread should aim for, if any */
+    static thread_local uint32_t allocgoal = NullReference;
+
+    /* blocks claimed, and how many of them each thread may still take */
+    static std::atomic<uint32_t> claimed(0);
+    static thread_local uint32_t spendable = 0;
+
+    static bool soMoveToHead(SOSuperBlock *sb, uint32_t bn, uint32_t window);
+
+    /* ***************************************** */
+
+    /* take the block at the head of the free list */
+    static uint32_t soTakeDataBlock()
     {
+        /* with a bitmap, it is the one that best fills a hole */
+        if (soFBMActive())
+        {
+            uint32_t bn;
+            soFBMAllocRun(1, NullReference, &bn);
+            return bn;
+        }
+
         if (soBinSelected(441))
             return bin::soAllocDataBlock();
         else
             return work::soAllocDataBlock();
     }
 
+    /* ***************************************** */
+
+    /*
+     * take the goal block, or, if there is a bitmap, the first block of a free extent
+     * close after it, long enough for the blocks that follow to be contiguous;
+     * without a bitmap, the goal is only looked for where it is found at once,
+     * the allocation group of the thread and the caches of the free list
+     */
+    static bool soTakeGoalBlock(uint32_t goal, uint32_t *bn)
+    {
+        if (soGroupTakeDataBlock(goal))
+        {
+            *bn = goal;
+            return true;
+        }
+
+        std::lock_guard<std::recursive_mutex> guard(soSBLock());
+
+        SOSuperBlock *sb = soSBGetPointer();
+        if (sb->dz_free == 0 or goal >= sb->dz_total)
+            return false;
+
+        if (soFBMActive())
+        {
+            uint32_t first = soFBMFindExtent(goal, ALLOC_GOAL_MIN_EXTENT);
+            if (first == NullReference)
+                return false;
+            soFBMAllocRun(1, first, bn);
+            return true;
+        }
+
+        if (sb->brcache.idx == BLOCK_REFERENCE_CACHE_SIZE)
+            soReplenishBRCache();
+        if (not soMoveToHead(sb, goal, 0))
+            return false;
+        *bn = soTakeDataBlock();
+        soSBSave();
+        return true;
+    }
+
+    /* ***************************************** */
+
+    /* free blocks the calling thread may take, those claimed excluded */
+    static uint32_t soUnclaimedBlocks()
+    {
+        std::lock_guard<std::recursive_mutex> guard(soSBLock());
+
+        uint32_t left = soSBGetPointer()->dz_free + soGroupCachedBlocks() + reserved.size();
+        return left > claimed ? left - claimed : 0;
+    }
+
+    /* ***************************************** */
+
+    /* allocate a block, claimed or not, apart from the reservation and the goal, if asked */
+    static uint32_t soPickDataBlock(bool apart)
+    {
+        uint32_t bn;
+        if (not apart and reserving and not reserved.empty())
+        {
+            bn = reserved.front();
+            reserved.pop_front();
+            reservegoal = bn + 1;
+            return bn;
+        }
+
+        /* once the reserved blocks are exhausted, the run is carried on, if possible */
+        if (not apart and reserving)
+        {
+            std::lock_guard<std::recursive_mutex> guard(soSBLock());
+            if (soSBGetPointer()->dz_free > 0)
+            {
+                soAllocDataBlocks(1, reservegoal, &bn);
+                reservegoal = bn + 1;
+                return bn;
+            }
+        }
+
+        /* a goal set by the caller comes next */
+        if (not apart and allocgoal != NullReference and soTakeGoalBlock(allocgoal, &bn))
+        {
+            allocgoal = bn + 1;
+            return bn;
+        }
+
+        /* otherwise, the allocation group of the thread provides it */
+        if (soGroupAllocDataBlock(&bn))
+            return bn;
+
+        std::lock_guard<std::recursive_mutex> guard(soSBLock());
+        return soTakeDataBlock();
+    }
+
+    /* ***************************************** */
+
+    /* allocate a block, taking it out of the claimed ones if the thread is spending claims */
+    static uint32_t soAllocBlock(bool apart)
+    {
+        /* blocks claimed are kept for the threads spending claims */
+        if (spendable == 0 and claimed != 0 and soUnclaimedBlocks() == 0)
+            throw SOException(ENOSPC, __FUNCTION__);
+
+        uint32_t bn = soPickDataBlock(apart);
+        if (spendable > 0)
+        {
+            spendable--;
+            claimed--;
+        }
+        return bn;
+    }
+
+    /* ***************************************** */
+
+    uint32_t soAllocDataBlock()
+    {
+        return soAllocBlock(false);
+    }
+
+    /* ***************************************** */
+
+    uint32_t soAllocDataBlockApart()
+    {
+        soProbe(458, "%s()\n", __FUNCTION__);
+
+        return soAllocBlock(true);
+    }
+
+    /* ***************************************** */
+
+    /*
+     * swap the free block bn with the head of the free list, which is the first reference
+     * of the retrieval cache, so it is the one taken next;
+     * besides the caches, only the first window references of the FBLT are searched;
+     * return false if bn is not found there
+     */
+    static bool soMoveToHead(SOSuperBlock *sb, uint32_t bn, uint32_t window)
+    {
+        uint32_t *head = &sb->brcache.ref[sb->brcache.idx];
+
+        for (uint32_t i = sb->brcache.idx; i < BLOCK_REFERENCE_CACHE_SIZE; i++)
+        {
+            if (sb->brcache.ref[i] == bn)
+            {
+                std::swap(sb->brcache.ref[i], *head);
+                return true;
+            }
+        }
+
+        for (uint32_t i = 0; i < sb->bicache.idx; i++)
+        {
+            if (sb->bicache.ref[i] == bn)
+            {
+                std::swap(sb->bicache.ref[i], *head);
+                return true;
+            }
+        }
+
+        /* the other free blocks are in the FBLT, from its head on */
+        uint32_t total = sb->fblt_size * ReferencesPerBlock;
+        uint32_t n = std::min(sb->dz_free - (BLOCK_REFERENCE_CACHE_SIZE - sb->brcache.idx)
+                - sb->bicache.idx, std::min(total, window));
+        uint32_t k = sb->fblt_head;
+        while (n > 0)
+        {
+            uint32_t blk = k / ReferencesPerBlock;
+            uint32_t *refs = soFBLTOpenBlock(blk);
+            for (uint32_t i = k % ReferencesPerBlock; i < ReferencesPerBlock and n > 0; i++, n--)
+            {
+                if (refs[i] == bn)
+                {
+                    std::swap(refs[i], *head);
+                    soFBLTSaveBlock();
+                    soFBLTCloseBlock();
+                    return true;
+                }
+            }
+            soFBLTCloseBlock();
+            k = (blk + 1) % sb->fblt_size * ReferencesPerBlock;
+        }
+        return false;
+    }
+
+    /* ***************************************** */
+
+    uint32_t soAllocDataBlocks(uint32_t count, uint32_t hint, uint32_t *bns)
+    {
+        soProbe(445, "%s(%u, %u, %p)\n", __FUNCTION__, count, hint, bns);
+
+        std::lock_guard<std::recursive_mutex> guard(soSBLock());
+
+        if (count == 0 or bns == NULL)
+            throw SOException(EINVAL, __FUNCTION__);
+
+        /* a bitmap finds a whole run at once */
+        if (soFBMActive())
+        {
+            uint32_t first;
+            uint32_t n = soFBMAllocRun(count, hint, &first);
+            for (uint32_t i = 0; i < n; i++)
+                bns[i] = first + i;
+            return n;
+        }
+
+        SOSuperBlock *sb = soSBGetPointer();
+        uint32_t n = 0;
+        uint32_t next = hint;
+        while (n < count and sb->dz_free > 0)
+        {
+            if (sb->brcache.idx == BLOCK_REFERENCE_CACHE_SIZE)
+                soReplenishBRCache();
+
+            /* the run ends at the first block not free */
+            bool found = (next < sb->dz_total and soMoveToHead(sb, next, ALLOC_RUN_WINDOW));
+            if (not found and n > 0)
+                break;
+
+            bns[n] = soTakeDataBlock();
+            next = bns[n] + 1;
+            n++;
+        }
+
+        if (n == 0)
+            throw SOException(ENOSPC, __FUNCTION__);
+
+        soSBSave();
+        return n;
+    }
+
+    /* ***************************************** */
+
+    void soReserveDataBlocks(uint32_t count, uint32_t hint)
+    {
+        soProbe(446, "%s(%u, %u)\n", __FUNCTION__, count, hint);
+
+        /* the reservation belongs to the thread, so only the free list needs locking */
+        soReleaseDataBlocks();
+
+        /* blocks claimed by others are left alone */
+        if (spendable == 0 and claimed != 0)
+            count = std::min(count, soUnclaimedBlocks());
+        if (count == 0)
+            return;
+
+        std::vector<uint32_t> bns(count);
+        uint32_t done = 0;
+        try
+        {
+            while (done < count)
+            {
+                done += soAllocDataBlocks(count - done, hint, &bns[done]);
+                hint = bns[done - 1] + 1;
+            }
+        }
+        catch (SOException & err)
+        {
+            /* a partial reservation is still useful, but other errors are passed on */
+            if (err.en != ENOSPC)
+            {
+                for (uint32_t i = 0; i < done; i++)
+                    soFreeDataBlock(bns[i]);
+                throw;
+            }
+        }
+
+        reserved.assign(bns.begin(), bns.begin() + done);
+        reserving = true;
+        reservegoal = hint;
+    }
+
+    /* ***************************************** */
+
+    void soSetAllocGoal(uint32_t goal)
+    {
+        soProbe(453, "%s(%u)\n", __FUNCTION__, goal);
+
+        allocgoal = goal;
+    }
+
+    /* ***************************************** */
+
+    void soReleaseDataBlocks()
+    {
+        soProbe(447, "%s()\n", __FUNCTION__);
+
+        reserving = false;
+        while (not reserved.empty())
+        {
+            uint32_t bn = reserved.front();
+            reserved.pop_front();
+            soFreeDataBlock(bn);
+        }
+    }
+
+    /* ***************************************** */
+
+    bool soClaimDataBlocks(uint32_t count)
+    {
+        soProbe(455, "%s(%u)\n", __FUNCTION__, count);
+
+        std::lock_guard<std::recursive_mutex> guard(soSBLock());
+
+        uint32_t left = soSBGetPointer()->dz_free + soGroupCachedBlocks();
+        if (left < claimed or left - claimed < count)
+            return false;
+        claimed += count;
+        return true;
+    }
+
+    /* ***************************************** */
+
+    void soUnclaimDataBlocks(uint32_t count)
+    {
+        soProbe(456, "%s(%u)\n", __FUNCTION__, count);
+
+        if (count > claimed)
+            throw SOException(EINVAL, __FUNCTION__);
+        claimed -= count;
+    }
+
+    /* ***************************************** */
+
+    uint32_t soSpendClaimedBlocks(uint32_t count)
+    {
+        soProbe(457, "%s(%u)\n", __FUNCTION__, count);
+
+        uint32_t left = spendable;
+        spendable = count;
+        return left;
+    }
+
+    /* ***************************************** */
+
+    uint32_t soClaimedBlockCount()
+    {
+        return claimed;
+    }
+
 };
 
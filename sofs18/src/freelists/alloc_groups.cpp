@@ -0,0 +1,266 @@
+#include "freelists.h"
+
+#include "core.h"
+#include "dal.h"
+
+#include <errno.h>
+#include <pthread.h>
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace sofs18
+{
+
+    /* ***************************************** */
+
+    /* an allocation group */
+    struct SOAllocGroup
+    {
+        std::mutex lock;                ///< access to the group by concurrent threads
+        std::deque<uint32_t> cache;     ///< free blocks taken out of the free list
+        uint32_t next;                  ///< block where the next refill should start
+    };
+
+    static uint32_t agcache = ALLOC_GROUP_DEFAULT_CACHE;    ///< number of blocks got per refill
+    static std::deque<SOAllocGroup> groups;                  ///< the groups, built on first use
+    static uint32_t ngroups = 0;                             ///< number of groups (0 if not built)
+    static std::atomic<uint32_t> agcached(0);                ///< number of blocks in the caches
+
+    /*
+     * the groups are used with this lock held shared,
+     * and built, dropped or resized with it held exclusive
+     */
+    static pthread_rwlock_t aglock = PTHREAD_RWLOCK_INITIALIZER;
+
+    /* group of each thread, given out in turn */
+    static std::atomic<uint32_t> agturn(0);
+    static thread_local uint32_t agthread = NullReference;
+
+    /* ***************************************** */
+
+    /*
+     * lock the groups shared, building them if not done yet;
+     * return false, with the lock not held, if they are disabled
+     */
+    static bool soGroupsEnter()
+    {
+        pthread_rwlock_rdlock(&aglock);
+        while (ngroups == 0)
+        {
+            pthread_rwlock_unlock(&aglock);
+            pthread_rwlock_wrlock(&aglock);
+            if (agcache == 0)
+            {
+                pthread_rwlock_unlock(&aglock);
+                return false;
+            }
+            if (ngroups == 0)
+            {
+                uint32_t total = soSBGetPointer()->dz_total;
+                uint32_t n = (total + ALLOC_GROUP_BLOCKS - 1) / ALLOC_GROUP_BLOCKS;
+                for (uint32_t i = 0; i < n; i++)
+                {
+                    groups.emplace_back();
+                    groups.back().next = i * ALLOC_GROUP_BLOCKS;
+                }
+                ngroups = n;
+            }
+            pthread_rwlock_unlock(&aglock);
+            pthread_rwlock_rdlock(&aglock);
+        }
+        return true;
+    }
+
+    /* ***************************************** */
+
+    /* the group of the calling thread, with the groups locked */
+    static uint32_t soGroupOfThread()
+    {
+        if (agthread == NullReference)
+            agthread = agturn++;
+        return agthread % ngroups;
+    }
+
+    /* ***************************************** */
+
+    /* take the first block of the cache of a group, with its lock held */
+    static uint32_t soGroupPop(SOAllocGroup & g)
+    {
+        uint32_t bn = g.cache.front();
+        g.cache.pop_front();
+        agcached--;
+        return bn;
+    }
+
+    /* ***************************************** */
+
+    /* fill the cache of a group, with a run of blocks starting where the last one ended */
+    static void soGroupRefill(SOAllocGroup & g)
+    {
+        std::lock_guard<std::recursive_mutex> guard(soSBLock());
+
+        if (soSBGetPointer()->dz_free == 0)
+            return;
+
+        std::vector<uint32_t> bns(agcache);
+        uint32_t n = soAllocDataBlocks(agcache, g.next, bns.data());
+        if (n == 0)
+            return;
+        g.cache.insert(g.cache.end(), bns.begin(), bns.begin() + n);
+        agcached += n;
+        g.next = bns[n - 1] + 1;
+    }
+
+    /* ***************************************** */
+
+    bool soGroupAllocDataBlock(uint32_t *bn)
+    {
+        soProbe(448, "%s(%p)\n", __FUNCTION__, bn);
+
+        if (not soGroupsEnter())
+            return false;
+
+        uint32_t n = ngroups;
+        uint32_t mine = soGroupOfThread();
+        try
+        {
+            SOAllocGroup & g = groups[mine];
+            std::lock_guard<std::mutex> guard(g.lock);
+            if (g.cache.empty())
+                soGroupRefill(g);
+            if (not g.cache.empty())
+            {
+                *bn = soGroupPop(g);
+                pthread_rwlock_unlock(&aglock);
+                return true;
+            }
+        }
+        catch (SOException & err)
+        {
+            pthread_rwlock_unlock(&aglock);
+            throw;
+        }
+
+        /* the free list is exhausted, but other groups may still have blocks */
+        for (uint32_t i = 1; i < n; i++)
+        {
+            SOAllocGroup & g = groups[(mine + i) % n];
+            std::lock_guard<std::mutex> guard(g.lock);
+            if (not g.cache.empty())
+            {
+                *bn = soGroupPop(g);
+                pthread_rwlock_unlock(&aglock);
+                return true;
+            }
+        }
+        pthread_rwlock_unlock(&aglock);
+        throw SOException(ENOSPC, __FUNCTION__);
+    }
+
+    /* ***************************************** */
+
+    bool soGroupTakeDataBlock(uint32_t bn)
+    {
+        soProbe(454, "%s(%u)\n", __FUNCTION__, bn);
+
+        /* the groups are not built here, as the block could not be in them */
+        pthread_rwlock_rdlock(&aglock);
+        if (ngroups == 0)
+        {
+            pthread_rwlock_unlock(&aglock);
+            return false;
+        }
+
+        bool found = false;
+        {
+            SOAllocGroup & g = groups[soGroupOfThread()];
+            std::lock_guard<std::mutex> guard(g.lock);
+            std::deque<uint32_t>::iterator it = std::find(g.cache.begin(), g.cache.end(), bn);
+            if (it != g.cache.end())
+            {
+                g.cache.erase(it);
+                agcached--;
+                found = true;
+            }
+        }
+        pthread_rwlock_unlock(&aglock);
+        return found;
+    }
+
+    /* ***************************************** */
+
+    bool soGroupFreeDataBlock(uint32_t bn)
+    {
+        soProbe(449, "%s(%u)\n", __FUNCTION__, bn);
+
+        /* a bitmap keeps its extents whole, so goals and runs can use them */
+        if (soFBMActive())
+            return false;
+
+        pthread_rwlock_rdlock(&aglock);
+        bool kept = false;
+        if (bn / ALLOC_GROUP_BLOCKS < ngroups)
+        {
+            SOAllocGroup & g = groups[bn / ALLOC_GROUP_BLOCKS];
+            std::lock_guard<std::mutex> guard(g.lock);
+
+            /* it is handed out first, as it may still be in the block cache */
+            if (g.cache.size() < 2 * agcache)
+            {
+                g.cache.push_front(bn);
+                agcached++;
+                kept = true;
+            }
+        }
+        pthread_rwlock_unlock(&aglock);
+        return kept;
+    }
+
+    /* ***************************************** */
+
+    void soReturnGroupBlocks()
+    {
+        soProbe(450, "%s()\n", __FUNCTION__);
+
+        /* with the lock held exclusive, no thread is using the groups */
+        std::vector<uint32_t> bns;
+        pthread_rwlock_wrlock(&aglock);
+        for (uint32_t i = 0; i < ngroups; i++)
+            bns.insert(bns.end(), groups[i].cache.begin(), groups[i].cache.end());
+        agcached -= bns.size();
+        ngroups = 0;
+        groups.clear();
+        pthread_rwlock_unlock(&aglock);
+
+        /* with no groups, they go back to the free list */
+        for (uint32_t i = 0; i < bns.size(); i++)
+            soFreeDataBlock(bns[i]);
+    }
+
+    /* ***************************************** */
+
+    uint32_t soGroupCachedBlocks()
+    {
+        soProbe(451, "%s()\n", __FUNCTION__);
+
+        /* it is kept apart, so it can be got with any other lock held */
+        return agcached;
+    }
+
+    /* ***************************************** */
+
+    void soSetAllocGroupCache(uint32_t nblocks)
+    {
+        soProbe(452, "%s(%u)\n", __FUNCTION__, nblocks);
+
+        pthread_rwlock_wrlock(&aglock);
+        agcache = nblocks;
+        pthread_rwlock_unlock(&aglock);
+    }
+
+};
+
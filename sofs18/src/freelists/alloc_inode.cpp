@@ -7,12 +7,15 @@
 #include "work_freelists.h"
 
 #include "core.h"
+#include "dal.h"
 
 namespace sofs18
 {
 
     uint32_t soAllocInode(uint32_t type)
     {
+        std::lock_guard<std::recursive_mutex> guard(soSBLock());
+
         if (soBinSelected(401))
             return bin::soAllocInode(type);
         else
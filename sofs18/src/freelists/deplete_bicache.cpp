@@ -7,12 +7,19 @@
 #include "work_freelists.h"
 
 #include "core.h"
+#include "dal.h"
 
 namespace sofs18
 {
 
     void soDepleteBICache(void)
     {
+        std::lock_guard<std::recursive_mutex> guard(soSBLock());
+
+        /* with a bitmap, the caches are not used */
+        if (soFBMActive())
+            return;
+
         if (soBinSelected(444))
             bin::soDepleteBICache();
         else
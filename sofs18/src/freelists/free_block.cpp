@@ -7,13 +7,22 @@
 #include "work_freelists.h"
 
 #include "core.h"
+#include "dal.h"
 
 namespace sofs18
 {
 
     void soFreeDataBlock(uint32_t bn)
     {
-        if (soBinSelected(442))
+        /* the block is kept by its allocation group, if there is room */
+        if (soGroupFreeDataBlock(bn))
+            return;
+
+        std::lock_guard<std::recursive_mutex> guard(soSBLock());
+
+        if (soFBMActive())
+            soFBMFree(bn);
+        else if (soBinSelected(442))
             bin::soFreeDataBlock(bn);
         else
             work::soFreeDataBlock(bn);
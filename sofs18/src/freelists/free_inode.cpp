@@ -7,16 +7,23 @@
 #include "work_freelists.h"
 
 #include "core.h"
+#include "dal.h"
 
 namespace sofs18
 {
 
     void soFreeInode(uint32_t in)
     {
+        std::lock_guard<std::recursive_mutex> guard(soSBLock());
+
         if (soBinSelected(402))
             bin::soFreeInode(in);
         else
             work::soFreeInode(in);
+
+        /* the inode number may be reused by a different file */
+        soBlockMapInvalidate(in);
+        soDentryCacheInvalidateDir(in);
     }
 
 };
@@ -103,6 +103,241 @@ namespace sofs18
 
     /* *************************************************** */
 
+    /**
+     *  \brief number of references of the FBLT, from its head on, searched for the next block of a run
+     */
+#define ALLOC_RUN_WINDOW ReferencesPerBlock
+
+    /**
+     *  \brief Allocate a run of physically contiguous free data blocks.
+     *
+     *  \details
+     *  The run starts at \c hint, if it is free; otherwise, at the block soAllocDataBlock
+     *  would return. It is extended with the blocks that follow, while they are free.
+     *  Blocks are taken out of the free list by swapping them with its head,
+     *  as the order of the free list is irrelevant; a block is only looked for in the caches
+     *  and in the first \c ALLOC_RUN_WINDOW references of the FBLT, so a run may end
+     *  before a block that is free, but further down the free list.
+     *  If the disk keeps its free blocks in a bitmap, the run is got with soFBMAllocRun,
+     *  which, if \c hint is not free, looks for a free extent of \c count blocks.
+     *
+     *  \param [in] count maximum number of blocks to allocate
+     *  \param [in] hint preferred first block of the run (\c NullReference for none)
+     *  \param [out] bns array where the numbers of the \c n allocated blocks are stored;
+     *      it must have room for \c count references
+     *
+     *  \remarks
+     *
+     *  \li if there are no free data blocks, error \c ENOSPC must be thrown.
+     *
+     *  \return the number \c n of blocks allocated, between 1 and \c count
+     */
+    uint32_t soAllocDataBlocks(uint32_t count, uint32_t hint, uint32_t *bns);
+
+    /* *************************************************** */
+
+    /**
+     *  \brief Reserve data blocks for the next allocations of the calling thread.
+     *
+     *  \details
+     *  Up to \c count blocks are allocated with soAllocDataBlocks, in runs as long as possible,
+     *  the first starting at \c hint and each following one right after the previous.
+     *  Until soReleaseDataBlocks is called, soAllocDataBlock, when called by the same thread,
+     *  hands them out, in the order they were allocated; once they are exhausted,
+     *  it goes on with the block following the last one handed out, if it is free.
+     *  Any previous reservation of the thread is released first.
+     *
+     *  \param [in] count number of blocks to reserve
+     *  \param [in] hint preferred first block (\c NullReference for none)
+     */
+    void soReserveDataBlocks(uint32_t count, uint32_t hint);
+
+    /* *************************************************** */
+
+    /**
+     *  \brief Free the data blocks reserved by the calling thread and not yet handed out.
+     */
+    void soReleaseDataBlocks();
+
+    /* *************************************************** */
+
+    /**
+     *  \brief Claim free data blocks, to be allocated later.
+     *
+     *  \details
+     *  Claimed blocks stay free, but soAllocDataBlock only hands them out to a thread
+     *  spending claims (see soSpendClaimedBlocks); to any other thread, the blocks
+     *  left are those free, in the allocation groups or in its own reservation,
+     *  less the ones claimed, and soReserveDataBlocks reserves no more than those.
+     *  Nothing is claimed if there are not \c count blocks left.
+     *
+     *  \param [in] count number of blocks to claim
+     *  \return true if the blocks were claimed
+     */
+    bool soClaimDataBlocks(uint32_t count);
+
+    /* *************************************************** */
+
+    /**
+     *  \brief Give up claimed data blocks, so anyone can allocate them.
+     *
+     *  \param [in] count number of blocks, no more than those claimed
+     */
+    void soUnclaimDataBlocks(uint32_t count);
+
+    /* *************************************************** */
+
+    /**
+     *  \brief Let the next allocations of the calling thread take claimed data blocks.
+     *
+     *  \details
+     *  Each block soAllocDataBlock hands out to the thread, while some of the \c count
+     *  are left, is taken out of the claimed ones; the thread stops spending claims when
+     *  soSpendClaimedBlocks is called again.
+     *
+     *  \param [in] count number of claimed blocks the thread may take (0 to stop)
+     *  \return the number of blocks the thread could still take from the previous call,
+     *      which remain claimed
+     */
+    uint32_t soSpendClaimedBlocks(uint32_t count);
+
+    /* *************************************************** */
+
+    /**
+     *  \brief Get the number of data blocks claimed.
+     */
+    uint32_t soClaimedBlockCount();
+
+    /* *************************************************** */
+
+    /**
+     *  \brief minimum number of blocks of a free extent a goal moves to, if not free itself
+     */
+#define ALLOC_GOAL_MIN_EXTENT 8
+
+    /**
+     *  \brief Set the data block the next allocations of the calling thread should aim for.
+     *
+     *  \details
+     *  While a goal is set, and the thread has no reservation (see soReserveDataBlocks),
+     *  soAllocDataBlock tries to hand out the goal block, or, if the free blocks are kept
+     *  in a bitmap, the first block of a free extent of \c ALLOC_GOAL_MIN_EXTENT blocks
+     *  close after it (see soFBMFindExtent); without a bitmap, the goal is only taken
+     *  if it is in the allocation group of the thread or in the caches of the free list,
+     *  as looking for it in the FBLT is too costly; on success, the goal moves on to
+     *  the block that follows, so blocks allocated in a row are contiguous.
+     *  Otherwise, allocation proceeds as if no goal was set.
+     *
+     *  \param [in] goal the preferred block (\c NullReference clears the goal)
+     */
+    void soSetAllocGoal(uint32_t goal);
+
+    /* *************************************************** */
+
+    /**
+     *  \brief Allocate a data block apart from the run the calling thread is allocating.
+     *
+     *  \details
+     *  The block is allocated as soAllocDataBlock does, claims included, except that
+     *  neither the reservation of the thread (see soReserveDataBlocks) nor its goal
+     *  (see soSetAllocGoal) are used or moved on; it suits blocks of metadata,
+     *  which would otherwise split the run of data blocks they are allocated amid.
+     *
+     *  \return the number (reference) of the data block allocated
+     */
+    uint32_t soAllocDataBlockApart();
+
+    /* *************************************************** */
+
+    /**
+     *  \brief number of data blocks of each allocation group
+     */
+#define ALLOC_GROUP_BLOCKS 2048
+
+    /**
+     *  \brief default number of free blocks an allocation group takes from the free list at a time
+     */
+#define ALLOC_GROUP_DEFAULT_CACHE 32
+
+    /**
+     *  \brief Allocate a data block from the allocation group of the calling thread.
+     *
+     *  \details
+     *  The data zone is split into allocation groups of \c ALLOC_GROUP_BLOCKS blocks,
+     *  each with its own lock and cache of free blocks, and threads are given groups in turn,
+     *  so concurrent threads allocate without contention.
+     *  When the cache of a group is empty, it is refilled with a run of blocks
+     *  (see soAllocDataBlocks) that starts where the previous one ended, so the blocks
+     *  a thread allocates stay close together.
+     *  Blocks in the caches are out of the free list, though not in use.
+     *  The groups are built on first use, from the superblock of the open disk.
+     *
+     *  \param [out] bn pointer to where the number of the allocated block is to be stored
+     *
+     *  \remarks
+     *
+     *  \li if there are no free data blocks, error \c ENOSPC must be thrown.
+     *
+     *  \return false if allocation groups are disabled (see soSetAllocGroupCache)
+     */
+    bool soGroupAllocDataBlock(uint32_t *bn);
+
+    /* *************************************************** */
+
+    /**
+     *  \brief Take a given block out of the cache of the allocation group of the calling thread.
+     *
+     *  \param [in] bn number of the block
+     *  \return false if the groups are not built or the block is not in the cache
+     */
+    bool soGroupTakeDataBlock(uint32_t bn);
+
+    /* *************************************************** */
+
+    /**
+     *  \brief Put a freed data block into the cache of its allocation group.
+     *
+     *  \param [in] bn number of the block
+     *  \return false if the groups are not built, the cache of the group is full,
+     *      or the free blocks are kept in a bitmap, in which case the block must go
+     *      to the free list
+     */
+    bool soGroupFreeDataBlock(uint32_t bn);
+
+    /* *************************************************** */
+
+    /**
+     *  \brief Give the blocks cached by the allocation groups back to the free list.
+     *
+     *  \details
+     *  The groups are dropped, to be built again on next use;
+     *  threads allocating or freeing blocks meanwhile wait for it to finish.
+     *  It must be called before the disk is closed.
+     *  Blocks cached when the system stops without calling it are lost
+     *  until the file system is checked.
+     */
+    void soReturnGroupBlocks();
+
+    /* *************************************************** */
+
+    /**
+     *  \brief Get the number of free blocks cached by the allocation groups.
+     */
+    uint32_t soGroupCachedBlocks();
+
+    /* *************************************************** */
+
+    /**
+     *  \brief Set the number of free blocks an allocation group takes from the free list at a time.
+     *
+     *  The new size only takes effect the next time the groups are built.
+     *
+     *  \param [in] nblocks refill size (0 disables the allocation groups)
+     */
+    void soSetAllocGroupCache(uint32_t nblocks);
+
+    /* *************************************************** */
+
     /**
      * \brief Replenish the inode retrieval cache
      * \details References to free inode should be transferred from the free inode list table
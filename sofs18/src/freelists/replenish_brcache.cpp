@@ -7,12 +7,19 @@
 #include "work_freelists.h"
 
 #include "core.h"
+#include "dal.h"
 
 namespace sofs18
 {
 
     void soReplenishBRCache(void)
     {
+        std::lock_guard<std::recursive_mutex> guard(soSBLock());
+
+        /* with a bitmap, the caches are not used */
+        if (soFBMActive())
+            return;
+
         if (soBinSelected(443))
             bin::soReplenishBRCache();
         else
@@ -7,12 +7,15 @@
 #include "work_freelists.h"
 
 #include "core.h"
+#include "dal.h"
 
 namespace sofs18
 {
 
     void soReplenishIRCache(void)
     {
+        std::lock_guard<std::recursive_mutex> guard(soSBLock());
+
         if (soBinSelected(403))
             bin::soReplenishIRCache();
         else
@@ -99,6 +99,18 @@ namespace sofs18
     uint32_t fillInFreeBlockListTable(uint32_t first_block, uint32_t btotal, uint32_t rdsize);
     
 
+    /**
+     * \brief Replace the free block list table by a free block bitmap
+     * \details The free data blocks, those in the superblock caches and those in the table,
+     *      from its head on, are marked in a bitmap written over the table area
+     *      (see \c FREE_BLOCK_BITMAP), and the caches are emptied.
+     *      Nothing is done if the disk already has a bitmap.
+     *      Error \c EBUSY is thrown if the disk was not properly unmounted,
+     *      and \c EINVAL if the free list is inconsistent.
+     */
+    void convertToFreeBlockBitmap();
+
+
     /** 
      * \brief Fill in the root directory
      * \details The root directory occupies one or two contiguous blocks,
@@ -0,0 +1,72 @@
+/*
+ *  \authur Artur Pereira - 2009-2018
+ */
+
+#include "mksofs.h"
+
+#include "rawdisk.h"
+#include "core.h"
+
+#include <inttypes.h>
+#include <errno.h>
+
+#include <vector>
+
+namespace sofs18
+{
+
+    /* mark a block as free in the bitmap, which it must not be yet */
+    static void markFree(std::vector<uint8_t> & map, uint32_t dz_total, uint32_t bn)
+    {
+        if (bn >= dz_total or ((map[bn / 8] >> (bn % 8)) & 1))
+            throw SOException(EINVAL, "convertToFreeBlockBitmap");
+        map[bn / 8] |= (uint8_t)(1 << (bn % 8));
+    }
+
+    /* ***************************************** */
+
+    /* see mksofs.h for a description */
+    void convertToFreeBlockBitmap()
+    {
+        soProbe(608, "%s()\n", __FUNCTION__);
+
+        SOSuperBlock sb;
+        soReadRawBlock(0, &sb);
+        if (sb.fblt_head == FREE_BLOCK_BITMAP)
+            return;
+        if (sb.mntstat != 1)
+            throw SOException(EBUSY, __FUNCTION__);
+
+        /* the bitmap takes the whole table area, the part not needed being zeroed */
+        std::vector<uint8_t> map(sb.fblt_size * BlockSize, 0);
+
+        /* free blocks are those in the caches and those in the table, from its head on */
+        for (uint32_t i = sb.brcache.idx; i < BLOCK_REFERENCE_CACHE_SIZE; i++)
+            markFree(map, sb.dz_total, sb.brcache.ref[i]);
+        for (uint32_t i = 0; i < sb.bicache.idx; i++)
+            markFree(map, sb.dz_total, sb.bicache.ref[i]);
+
+        uint32_t count = BLOCK_REFERENCE_CACHE_SIZE - sb.brcache.idx + sb.bicache.idx;
+        if (count > sb.dz_free)
+            throw SOException(EINVAL, __FUNCTION__);
+        uint32_t total = sb.fblt_size * ReferencesPerBlock;
+        std::vector<uint32_t> fblt(total);
+        soReadRawBlocks(sb.fblt_start, sb.fblt_size, fblt.data());
+        for (uint32_t i = 0, n = sb.dz_free - count; i < n; i++)
+            markFree(map, sb.dz_total, fblt[(sb.fblt_head + i) % total]);
+
+        soWriteRawBlocks(sb.fblt_start, sb.fblt_size, map.data());
+
+        sb.fblt_head = sb.fblt_tail = FREE_BLOCK_BITMAP;
+        for (uint32_t i = 0; i < BLOCK_REFERENCE_CACHE_SIZE; i++)
+        {
+            sb.brcache.ref[i] = NullReference;
+            sb.bicache.ref[i] = NullReference;
+        }
+        sb.brcache.idx = BLOCK_REFERENCE_CACHE_SIZE;
+        sb.bicache.idx = 0;
+        soWriteRawBlock(0, &sb);
+    }
+
+};
+
@@ -15,6 +15,7 @@
 #include <getopt.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 
 /* print help message */
 static void printUsage(char *cmd_name)
@@ -24,6 +25,9 @@ static void printUsage(char *cmd_name)
            "  -n name     --- set volume name (default: \"sofs18_disk\")\n"
            "  -i num      --- set number of inodes (default: N/8, where N = number of blocks)\n"
            "  -z          --- set zero mode (default: false)\n"
+           "  -B          --- keep free blocks in a bitmap, instead of a list (default: false)\n"
+           "  -C          --- do not format, but convert the free block list of the\n"
+           "                  existing file system to a bitmap\n"
            "  -q          --- set quiet mode (default: false)\n"
            "  -d          --- set debug mode (default: false)\n"
            "  -b          --- set bin configuration to 600-699\n"
@@ -63,11 +67,13 @@ int main(int argc, char *argv[])
     bool quiet = false;        /* quiet mode */
     bool debug = false;        /* debug mode */
     bool zero = false;        /* zero mode */
+    bool bitmap = false;      /* free block bitmap mode */
+    bool convert = false;     /* conversion mode */
 
     /* process command line options */
 
     int opt;
-    while ((opt = getopt(argc, argv, "n:i:qzdbwa:r:h")) != -1)
+    while ((opt = getopt(argc, argv, "n:i:qzBCdbwa:r:h")) != -1)
     {
         switch (opt)
         {
@@ -103,6 +109,16 @@ int main(int argc, char *argv[])
                 zero = true;    
                 break;
             }
+            case 'B':    /* free block bitmap mode */
+            {
+                bitmap = true;
+                break;
+            }
+            case 'C':    /* conversion mode */
+            {
+                convert = true;
+                break;
+            }
             case 'b':   /* set binary mode: all functios binary */
             {
                 soBinSetIDs(600, 799);;
@@ -175,10 +191,25 @@ int main(int argc, char *argv[])
 
     try
     {
-        /* open the storage device */
+        /* open the storage device, keeping several transfers in flight if possible */
         uint32_t ntotal;
+        soSetRawDiskMode(RAWDISK_URING);
         soOpenRawDisk(devname, &ntotal);
 
+        /* convert the free block list of an existing file system, if required */
+        if (convert)
+        {
+            if (!quiet) infoMsg("Converting the free block list of %s to a bitmap.\n", argv[optind]);
+            SOSuperBlock sb;
+            soReadRawBlock(0, &sb);
+            if (sb.magic != MAGIC_NUMBER or sb.version != VERSION_NUMBER)
+                throw SOException(EINVAL, "mksofs");
+            convertToFreeBlockBitmap();
+            soCloseRawDisk();
+            if (!quiet) infoMsg("The free block list was successfully converted.\n");
+            return EXIT_SUCCESS;
+        }
+
         if (!quiet) 
             infoMsg("Installing a SOFS18 file system in %s.\n", argv[optind]);
 
@@ -217,6 +248,13 @@ int main(int argc, char *argv[])
             resetBlocks(n, ntotal - n);
         }
 
+        /* replace the free block list table by a bitmap, if required */
+        if (bitmap)
+        {
+            if (!quiet) infoMsg("  Converting the free block list table to a bitmap... \n");
+            convertToFreeBlockBitmap();
+        }
+
         /* set magic number and save superblock */
         if (!quiet) infoMsg("  Setting magic number... \n");
         SOSuperBlock sb;
@@ -5,6 +5,7 @@
  */
 
 #include "rawdisk.h"
+#include "rawdisk_backend.h"
 
 #include "core.h"
 
@@ -12,10 +13,15 @@
 #include <unistd.h>
 #include <inttypes.h>
 #include <stdio.h>
+#include <string.h>
 #include <errno.h>
 #include <fcntl.h>
 
 #include <iostream>
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 
 namespace sofs18
 {
@@ -25,12 +31,306 @@ namespace sofs18
     static int fd = -1;     ///< File descriptor of the Linux file that simulates the disk
     static uint32_t ntotal; ///< Total number of blocks of the storage device
 
+    static uint32_t dmode = RAWDISK_FILE;           ///< configured access mode
+    static const SORawBackend *dev = NULL;          ///< backend of the open device
+
+    /* a read submitted but not yet completed */
+    struct SORawPendingRead
+    {
+        uint32_t first;
+        uint32_t count;
+        uint8_t *buf;
+    };
+    static std::vector<SORawPendingRead> pending;   ///< reads waiting for soWaitRawBlocks
+
+    /* ***************************************** */
+
+    /* a slot of the raw block cache */
+    struct SORawCacheSlot
+    {
+        uint32_t n;         ///< number of the cached block (NullReference if slot is free)
+        bool dirty;         ///< true if slot contents differ from the device
+        bool ref;           ///< CLOCK reference bit
+        bool loading;       ///< true if a prefetch into the slot may still be in flight
+        int lerr;           ///< outcome of the prefetch into the slot, once completed
+        int werr;           ///< outcome of the write back of the slot, once completed
+        uint8_t data[BlockSize];    ///< block contents
+    };
+
+    static uint32_t cconf = RAWCACHE_DEFAULT_SIZE;  ///< configured number of slots
+    static uint32_t csize = 0;                      ///< number of slots of the open cache
+    static SORawCacheSlot *cache = NULL;            ///< the cache slots
+    static uint32_t chand = 0;                      ///< CLOCK hand
+    static std::unordered_map<uint32_t, uint32_t> cmap;  ///< block number to slot index
+    static SORawCacheStats cstats;                  ///< cache statistics
+    static uint32_t cloading = 0;                   ///< number of slots being prefetched into
+
+    /* 
+     * access to the device, the cache and the pending reads by concurrent threads;
+     * recursive, as some operations are built on others 
+     */
+    static std::recursive_mutex rawlock;
+
+    /* ********************************************* */
+
+    /* 
+     * wait for the prefetches in flight to complete;
+     * the slots of those that failed are released, and so are all loading slots
+     * if waiting itself fails, in which case the error is thrown 
+     */
+    static void soCacheSettle()
+    {
+        if (cloading == 0)
+            return;
+
+        int en = 0;
+        try
+        {
+            if (dev->wait != NULL)
+                dev->wait(false);
+        }
+        catch (SOException & err)
+        {
+            en = err.en;
+        }
+
+        for (uint32_t i = 0; i < csize and cloading > 0; i++)
+        {
+            if (not cache[i].loading)
+                continue;
+            cache[i].loading = false;
+            cloading--;
+            if (en != 0 or cache[i].lerr != 0)
+            {
+                cmap.erase(cache[i].n);
+                cache[i].n = NullReference;
+            }
+        }
+
+        if (en != 0)
+            throw SOException(en, __FUNCTION__);
+    }
+
+    /* ********************************************* */
+
+    /* return the slot holding block n, or NULL if not cached */
+    static SORawCacheSlot *soCacheLookup(uint32_t n)
+    {
+        std::unordered_map<uint32_t, uint32_t>::iterator it = cmap.find(n);
+        if (it == cmap.end())
+            return NULL;
+        SORawCacheSlot *slot = &cache[it->second];
+        if (slot->loading)
+        {
+            /* the prefetch may have failed, releasing the slot */
+            soCacheSettle();
+            if (slot->n != n)
+                return NULL;
+        }
+        slot->ref = true;
+        return slot;
+    }
+
+    /* ********************************************* */
+
+    /* get a slot for block n, evicting (and writing back) another block if necessary */
+    static SORawCacheSlot *soCacheGrab(uint32_t n)
+    {
+        /* run the CLOCK hand until a non referenced slot is found */
+        while (cache[chand].n != NullReference and cache[chand].ref)
+        {
+            cache[chand].ref = false;
+            chand = (chand + 1) % csize;
+        }
+        SORawCacheSlot *slot = &cache[chand];
+        uint32_t idx = chand;
+        chand = (chand + 1) % csize;
+
+        /* the slot may be the target of a prefetch still in flight */
+        if (slot->loading)
+            soCacheSettle();
+
+        /* evict current block */
+        if (slot->n != NullReference)
+        {
+            if (slot->dirty)
+            {
+                dev->write(slot->n, 1, slot->data);
+                cstats.writebacks++;
+            }
+            cmap.erase(slot->n);
+        }
+
+        /* bind slot to the new block */
+        slot->n = n;
+        slot->dirty = false;
+        slot->ref = true;
+        cmap[n] = idx;
+        return slot;
+    }
+
+    /* ********************************************* */
+
+    /* write back all dirty slots, in ascending order of block number */
+    static void soCacheFlush()
+    {
+        std::vector<uint32_t> dirty;
+        for (uint32_t i = 0; i < csize; i++)
+            if (cache[i].n != NullReference and cache[i].dirty)
+                dirty.push_back(i);
+        std::sort(dirty.begin(), dirty.end(),
+                [](uint32_t a, uint32_t b) { return cache[a].n < cache[b].n; });
+
+        /*
+         * if possible, keep all write backs in flight at once;
+         * a slot is only taken as clean once its write back is known to have made it,
+         * so the others are written again by the next flush, or when evicted
+         */
+        if (dev->submit != NULL)
+        {
+            int en = 0;
+            try
+            {
+                for (uint32_t i : dirty)
+                {
+                    cache[i].werr = 0;
+                    dev->submit(true, cache[i].n, 1, cache[i].data, &cache[i].werr);
+                }
+                dev->wait(false);
+            }
+            catch (SOException & err)
+            {
+                en = err.en;
+            }
+
+            for (uint32_t i : dirty)
+            {
+                if (en == 0 and cache[i].werr == 0)
+                {
+                    cache[i].dirty = false;
+                    cstats.writebacks++;
+                }
+                else if (en == 0)
+                    en = cache[i].werr;
+            }
+            if (en != 0)
+                throw SOException(en, __FUNCTION__);
+            return;
+        }
+
+        /* otherwise, write runs of consecutive blocks with a single transfer */
+        std::vector<void *> bufs;
+        for (uint32_t k = 0; k < dirty.size(); )
+        {
+            uint32_t first = cache[dirty[k]].n;
+            bufs.clear();
+            do
+            {
+                bufs.push_back(cache[dirty[k]].data);
+                k++;
+            } while (k < dirty.size() and cache[dirty[k]].n == first + bufs.size());
+
+            dev->writev(first, bufs.size(), bufs.data());
+            for (uint32_t j = k - bufs.size(); j < k; j++)
+                cache[dirty[j]].dirty = false;
+            cstats.writebacks += bufs.size();
+        }
+    }
+
+    /* ********************************************* */
+
+    /* 
+     * check if all blocks of a run are cached;
+     * cached blocks are accounted as hits, the others as misses 
+     */
+    static bool soCacheCovers(uint32_t first, uint32_t count)
+    {
+        /* failed prefetches must not count as cached */
+        if (cloading > 0)
+            soCacheSettle();
+
+        uint32_t cached = 0;
+        for (uint32_t i = 0; i < count; i++)
+            if (cmap.find(first + i) != cmap.end())
+                cached++;
+        cstats.hits += cached;
+        cstats.misses += count - cached;
+        return cached == count;
+    }
+
+    /* ********************************************* */
+
+    /* copy the cached version of block n, if any, into buf */
+    static void soCacheOverlay(uint32_t n, void *buf)
+    {
+        SORawCacheSlot *slot = soCacheLookup(n);
+        if (slot != NULL)
+            memcpy(buf, slot->data, BlockSize);
+    }
+
+    /* ********************************************* */
+
+    /* refresh the cached version of block n, if any, after it was written to the device */
+    static void soCacheRefresh(uint32_t n, const void *buf)
+    {
+        std::unordered_map<uint32_t, uint32_t>::iterator it = cmap.find(n);
+        if (it == cmap.end())
+            return;
+        if (cache[it->second].loading)
+        {
+            /* the prefetch may have failed, releasing the slot */
+            soCacheSettle();
+            if ((it = cmap.find(n)) == cmap.end())
+                return;
+        }
+        memcpy(cache[it->second].data, buf, BlockSize);
+        cache[it->second].dirty = false;
+    }
+
+    /* ********************************************* */
+
+    /* check arguments common to multi-block operations */
+    static void soCheckRun(uint32_t first, uint32_t count, void *buf, const char *fname)
+    {
+        if (buf == NULL)
+            throw SOException(EINVAL, fname);
+
+        if ((uint64_t)first + count > ntotal)
+            throw SOException(EINVAL, fname);
+
+        if (fd == -1)
+            throw SOException(EBADF, fname);
+    }
+
+    /* ********************************************* */
+
+    void soSetRawCacheSize(uint32_t nblocks)
+    {
+        soProbe(SOPROBE_GREEN, 795, "%s(%" PRIu32 ")\n", __FUNCTION__, nblocks);
+
+        cconf = nblocks;
+    }
+
+    /* ********************************************* */
+
+    void soSetRawDiskMode(uint32_t mode)
+    {
+        soProbe(SOPROBE_GREEN, 757, "%s(%" PRIu32 ")\n", __FUNCTION__, mode);
+
+        if (mode > RAWDISK_RAM)
+            throw SOException(EINVAL, __FUNCTION__);
+
+        dmode = mode;
+    }
+
     /* ********************************************* */
 
     void soOpenRawDisk(const char *devname, uint32_t * np)
     {
         soProbe(SOPROBE_GREEN, 791, "%s(\"%s\", %p)\n", __FUNCTION__, devname, np);
 
+        std::lock_guard<std::recursive_mutex> guard(rawlock);
+
         /* check devname */
         if (devname == NULL)
             throw SOException(EINVAL, __FUNCTION__);
@@ -53,6 +353,70 @@ namespace sofs18
         /* get number of blocks of the device */
         ntotal = st.st_size / BlockSize;
 
+        /* attach the backend of the configured access mode */
+        switch (dmode)
+        {
+            case RAWDISK_MMAP:
+                dev = &soRawMmapBackend;
+                break;
+            case RAWDISK_URING:
+                dev = &soRawUringBackend;
+                break;
+            case RAWDISK_DIRECT:
+                dev = &soRawDirectBackend;
+                break;
+            case RAWDISK_RAM:
+                dev = &soRawRamBackend;
+                break;
+            default:
+                dev = &soRawFileBackend;
+        }
+        try
+        {
+            try
+            {
+                dev->open(devname, fd, ntotal);
+            }
+            catch (SOException & err)
+            {
+                /* 
+                 * io_uring or O_DIRECT may not be available (EINVAL, on some
+                 * file systems); fall back to plain read/write transfers 
+                 */
+                if (dev != &soRawUringBackend and dev != &soRawDirectBackend)
+                    throw;
+                soProbe(SOPROBE_GREEN, 791, "%s: access mode %" PRIu32 " not available (%s), using read/write\n",
+                        __FUNCTION__, dmode, strerror(err.en));
+                dev = &soRawFileBackend;
+                dev->open(devname, fd, ntotal);
+            }
+        }
+        catch (SOException & err)
+        {
+            close(fd);
+            fd = -1;
+            ntotal = 0;
+            dev = NULL;
+            throw;
+        }
+
+        /* set up the block cache, if it is of any use to the backend */
+        csize = dev->cached ? std::min(cconf, ntotal) : 0;
+        if (csize > 0)
+        {
+            cache = new SORawCacheSlot[csize];
+            for (uint32_t i = 0; i < csize; i++)
+            {
+                cache[i].n = NullReference;
+                cache[i].dirty = cache[i].ref = cache[i].loading = false;
+                cache[i].lerr = cache[i].werr = 0;
+            }
+            cmap.reserve(csize);
+        }
+        chand = 0;
+        cloading = 0;
+        memset(&cstats, 0, sizeof(cstats));
+
         /* return number of blocks, if requested */
         if (np != NULL)
             *np = ntotal;
@@ -64,10 +428,137 @@ namespace sofs18
     {
         soProbe(SOPROBE_GREEN, 792, "%s()\n", __FUNCTION__);
 
-        /* close the device */
+        std::lock_guard<std::recursive_mutex> guard(rawlock);
+
+        /* write back and release the block cache */
+        if (csize > 0)
+        {
+            try
+            {
+                soCacheSettle();
+            }
+            catch (SOException & err)
+            {
+                /* failed prefetches are of no consequence here */
+            }
+            soCacheFlush();
+            soProbe(SOPROBE_GREEN, 797, "%s: cache hits = %" PRIu64 ", misses = %" PRIu64
+                    ", writes = %" PRIu64 ", writebacks = %" PRIu64 ", prefetches = %" PRIu64 "\n",
+                    __FUNCTION__, cstats.hits, cstats.misses, cstats.writes, cstats.writebacks,
+                    cstats.prefetches);
+            delete [] cache;
+            cache = NULL;
+            cmap.clear();
+            csize = 0;
+            cloading = 0;
+        }
+
+        /* close the device, completing any submitted transfer */
+        pending.clear();
+        dev->close();
         close(fd);
         ntotal = 0;
         fd = -1;
+        dev = NULL;
+    }
+
+    /* ********************************************* */
+
+    void soSyncRawDisk(void)
+    {
+        soProbe(SOPROBE_GREEN, 796, "%s()\n", __FUNCTION__);
+
+        std::lock_guard<std::recursive_mutex> guard(rawlock);
+
+        if (fd == -1)
+            throw SOException(EBADF, __FUNCTION__);
+
+        if (csize > 0)
+        {
+            soCacheSettle();
+            soCacheFlush();
+        }
+
+        dev->sync();
+    }
+
+    /* ********************************************* */
+
+    void *soRawBlockPointer(uint32_t n)
+    {
+        soProbe(SOPROBE_GREEN, 758, "%s(%" PRIu32 ")\n", __FUNCTION__, n);
+
+        std::lock_guard<std::recursive_mutex> guard(rawlock);
+
+        if (fd == -1)
+            throw SOException(EBADF, __FUNCTION__);
+
+        if (n >= ntotal)
+            throw SOException(EINVAL, __FUNCTION__);
+
+        return (dev->pointer != NULL) ? dev->pointer(n) : NULL;
+    }
+
+    /* ********************************************* */
+
+    int soRawBlocksFd(uint32_t first, uint32_t count, bool write, off_t *pos)
+    {
+        soProbe(SOPROBE_GREEN, 765, "%s(%" PRIu32 ", %" PRIu32 ", %d, %p)\n", __FUNCTION__,
+                first, count, write, pos);
+
+        std::lock_guard<std::recursive_mutex> guard(rawlock);
+
+        if (fd == -1)
+            throw SOException(EBADF, __FUNCTION__);
+
+        if (pos == NULL or count == 0 or (uint64_t)first + count > ntotal)
+            throw SOException(EINVAL, __FUNCTION__);
+
+        if (not dev->shared)
+            return -1;
+
+        /* transfers in flight may concern the run */
+        if (dev->submit != NULL)
+            soWaitRawBlocks();
+        soCacheSettle();
+
+        /* the Linux file gets the cached versions, which are then dropped, if it is to be written */
+        for (uint32_t n = first; csize > 0 and n < first + count; n++)
+        {
+            std::unordered_map<uint32_t, uint32_t>::iterator it = cmap.find(n);
+            if (it == cmap.end())
+                continue;
+            SORawCacheSlot *slot = &cache[it->second];
+            if (slot->dirty)
+            {
+                dev->write(n, 1, slot->data);
+                slot->dirty = false;
+                cstats.writebacks++;
+            }
+            if (write)
+            {
+                cmap.erase(it);
+                slot->n = NullReference;
+                slot->ref = false;
+            }
+        }
+
+        *pos = (off_t)first * BlockSize;
+        return fd;
+    }
+
+    /* ********************************************* */
+
+    void soGetRawCacheStats(SORawCacheStats * st)
+    {
+        soProbe(SOPROBE_GREEN, 798, "%s(%p)\n", __FUNCTION__, st);
+
+        std::lock_guard<std::recursive_mutex> guard(rawlock);
+
+        if (st == NULL)
+            throw SOException(EINVAL, __FUNCTION__);
+
+        *st = cstats;
     }
 
     /* ********************************************* */
@@ -76,6 +567,8 @@ namespace sofs18
     {
         soProbe(SOPROBE_GREEN, 751, "%s(%" PRIu32 ", %p)\n", __FUNCTION__, n, buf);
 
+        std::lock_guard<std::recursive_mutex> guard(rawlock);
+
         /* checking arguments */
         if (buf == NULL)
             throw SOException(EINVAL, __FUNCTION__);
@@ -86,12 +579,38 @@ namespace sofs18
         if (fd == -1)
             throw SOException(EBADF, __FUNCTION__);
 
-        /* transfer block data */
-        if (lseek(fd, BlockSize * n, SEEK_SET) == -1)
-            throw SOException(errno, __FUNCTION__);
-
-        if (read(fd, buf, BlockSize) != BlockSize)
-            throw SOException(EIO, __FUNCTION__);
+        /* no cache: transfer block data */
+        if (csize == 0)
+        {
+            dev->read(n, 1, buf);
+            return;
+        }
+
+        /* cache hit */
+        SORawCacheSlot *slot = soCacheLookup(n);
+        if (slot != NULL)
+        {
+            cstats.hits++;
+        }
+
+        /* cache miss: load block into the cache */
+        else
+        {
+            cstats.misses++;
+            slot = soCacheGrab(n);
+            try
+            {
+                dev->read(n, 1, slot->data);
+            }
+            catch (SOException & err)
+            {
+                cmap.erase(n);
+                slot->n = NullReference;
+                throw;
+            }
+        }
+
+        memcpy(buf, slot->data, BlockSize);
     }
 
     /* ********************************************* */
@@ -100,6 +619,8 @@ namespace sofs18
     {
         soProbe(SOPROBE_GREEN, 752, "%s(%" PRIu32 ", %p)\n", __FUNCTION__, n, buf);
 
+        std::lock_guard<std::recursive_mutex> guard(rawlock);
+
         /* checking arguments */
         if (buf == NULL)
             throw SOException(EINVAL, __FUNCTION__);
@@ -110,14 +631,261 @@ namespace sofs18
         if (fd == -1)
             throw SOException(EBADF, __FUNCTION__);
 
-        /* transfer block data */
-        if (lseek(fd, BlockSize * n, SEEK_SET) == -1)
-            throw SOException(errno, __FUNCTION__);
-        if (write(fd, buf, BlockSize) != BlockSize)
-            throw SOException(EIO, __FUNCTION__);
+        /* no cache: transfer block data */
+        if (csize == 0)
+        {
+            dev->write(n, 1, buf);
+            return;
+        }
+
+        /* keep block dirty in the cache */
+        SORawCacheSlot *slot = soCacheLookup(n);
+        if (slot == NULL)
+            slot = soCacheGrab(n);
+        memcpy(slot->data, buf, BlockSize);
+        slot->dirty = true;
+        cstats.writes++;
+    }
+
+    /* ********************************************* */
+
+    void soReadRawBlocks(uint32_t first, uint32_t count, void *buf)
+    {
+        soProbe(SOPROBE_GREEN, 753, "%s(%" PRIu32 ", %" PRIu32 ", %p)\n", __FUNCTION__, first, count, buf);
+
+        std::lock_guard<std::recursive_mutex> guard(rawlock);
+
+        /* checking arguments */
+        soCheckRun(first, count, buf, __FUNCTION__);
+
+        /* 
+         * read the run from the device unless it is fully cached,
+         * then overlay the cached blocks, as they may be more recent 
+         */
+        uint8_t *p = (uint8_t *)buf;
+        if (csize == 0 or not soCacheCovers(first, count))
+            dev->read(first, count, buf);
+        for (uint32_t i = 0; csize > 0 and i < count; i++)
+            soCacheOverlay(first + i, p + (size_t)i * BlockSize);
+    }
+
+    /* ********************************************* */
+
+    void soWriteRawBlocks(uint32_t first, uint32_t count, void *buf)
+    {
+        soProbe(SOPROBE_GREEN, 754, "%s(%" PRIu32 ", %" PRIu32 ", %p)\n", __FUNCTION__, first, count, buf);
+
+        std::lock_guard<std::recursive_mutex> guard(rawlock);
+
+        /* checking arguments */
+        soCheckRun(first, count, buf, __FUNCTION__);
+
+        /* write the run through to the device and refresh cached copies */
+        dev->write(first, count, buf);
+        uint8_t *p = (uint8_t *)buf;
+        for (uint32_t i = 0; csize > 0 and i < count; i++)
+            soCacheRefresh(first + i, p + (size_t)i * BlockSize);
+    }
+
+    /* ********************************************* */
+
+    void soReadRawBlocksv(uint32_t first, uint32_t count, void *bufs[])
+    {
+        soProbe(SOPROBE_GREEN, 755, "%s(%" PRIu32 ", %" PRIu32 ", %p)\n", __FUNCTION__, first, count, bufs);
+
+        std::lock_guard<std::recursive_mutex> guard(rawlock);
+
+        /* checking arguments */
+        soCheckRun(first, count, bufs, __FUNCTION__);
+        for (uint32_t i = 0; i < count; i++)
+            if (bufs[i] == NULL)
+                throw SOException(EINVAL, __FUNCTION__);
+
+        /* same as soReadRawBlocks */
+        if (csize == 0 or not soCacheCovers(first, count))
+            dev->readv(first, count, bufs);
+        for (uint32_t i = 0; csize > 0 and i < count; i++)
+            soCacheOverlay(first + i, bufs[i]);
+    }
+
+    /* ********************************************* */
+
+    void soWriteRawBlocksv(uint32_t first, uint32_t count, void *bufs[])
+    {
+        soProbe(SOPROBE_GREEN, 756, "%s(%" PRIu32 ", %" PRIu32 ", %p)\n", __FUNCTION__, first, count, bufs);
+
+        std::lock_guard<std::recursive_mutex> guard(rawlock);
+
+        /* checking arguments */
+        soCheckRun(first, count, bufs, __FUNCTION__);
+        for (uint32_t i = 0; i < count; i++)
+            if (bufs[i] == NULL)
+                throw SOException(EINVAL, __FUNCTION__);
+
+        /* same as soWriteRawBlocks */
+        dev->writev(first, count, bufs);
+        for (uint32_t i = 0; csize > 0 and i < count; i++)
+            soCacheRefresh(first + i, bufs[i]);
+    }
+
+    /* ********************************************* */
+
+    void soPrefetchRawBlocks(uint32_t first, uint32_t count)
+    {
+        soProbe(SOPROBE_GREEN, 764, "%s(%" PRIu32 ", %" PRIu32 ")\n", __FUNCTION__, first, count);
+
+        std::lock_guard<std::recursive_mutex> guard(rawlock);
+
+        if (fd == -1)
+            throw SOException(EBADF, __FUNCTION__);
+
+        /* nothing to load into */
+        if (csize == 0 or first >= ntotal)
+            return;
+
+        /* never take more than half the cache, nor go past the end of the device */
+        count = std::min(count, std::max(csize / 2, 1u));
+        count = std::min(count, ntotal - first);
+
+        /* load each run of blocks not yet cached */
+        std::vector<void *> bufs;
+        uint32_t i = 0;
+        while (i < count)
+        {
+            if (cmap.find(first + i) != cmap.end())
+            {
+                i++;
+                continue;
+            }
+
+            /* bind the run to cache slots */
+            uint32_t start = first + i;
+            bufs.clear();
+            for (; i < count and cmap.find(first + i) == cmap.end(); i++)
+            {
+                SORawCacheSlot *slot = soCacheGrab(first + i);
+                slot->ref = false;
+                bufs.push_back(slot->data);
+            }
+
+            /* asynchronous backends leave the slots loading */
+            if (dev->submit != NULL)
+            {
+                for (uint32_t k = 0; k < bufs.size(); k++)
+                {
+                    SORawCacheSlot *slot = &cache[cmap[start + k]];
+                    slot->lerr = 0;
+                    dev->submit(false, start + k, 1, slot->data, &slot->lerr);
+                    slot->loading = true;
+                    cloading++;
+                }
+            }
+            else
+            {
+                try
+                {
+                    dev->readv(start, bufs.size(), bufs.data());
+                }
+                catch (SOException & err)
+                {
+                    for (uint32_t k = 0; k < bufs.size(); k++)
+                    {
+                        cache[cmap[start + k]].n = NullReference;
+                        cmap.erase(start + k);
+                    }
+                    throw;
+                }
+            }
+            cstats.prefetches += bufs.size();
+        }
+    }
+
+    /* ********************************************* */
+
+    void soSubmitReadRawBlocks(uint32_t first, uint32_t count, void *buf)
+    {
+        soProbe(SOPROBE_GREEN, 759, "%s(%" PRIu32 ", %" PRIu32 ", %p)\n", __FUNCTION__, first, count, buf);
+
+        std::lock_guard<std::recursive_mutex> guard(rawlock);
+
+        /* checking arguments */
+        soCheckRun(first, count, buf, __FUNCTION__);
+
+        /* synchronous backends complete right away */
+        if (dev->submit == NULL)
+        {
+            soReadRawBlocks(first, count, buf);
+            return;
+        }
+
+        /* and so do fully cached runs */
+        uint8_t *p = (uint8_t *)buf;
+        if (csize > 0 and soCacheCovers(first, count))
+        {
+            for (uint32_t i = 0; i < count; i++)
+                soCacheOverlay(first + i, p + (size_t)i * BlockSize);
+            return;
+        }
+
+        /* cached blocks are overlaid when the read completes */
+        dev->submit(false, first, count, buf, NULL);
+        SORawPendingRead pr = { first, count, p };
+        pending.push_back(pr);
+    }
+
+    /* ********************************************* */
+
+    void soSubmitWriteRawBlocks(uint32_t first, uint32_t count, void *buf)
+    {
+        soProbe(SOPROBE_GREEN, 760, "%s(%" PRIu32 ", %" PRIu32 ", %p)\n", __FUNCTION__, first, count, buf);
+
+        std::lock_guard<std::recursive_mutex> guard(rawlock);
+
+        /* checking arguments */
+        soCheckRun(first, count, buf, __FUNCTION__);
+
+        /* synchronous backends complete right away */
+        if (dev->submit == NULL)
+        {
+            soWriteRawBlocks(first, count, buf);
+            return;
+        }
+
+        /* refresh cached copies now, as the data is on its way to the device */
+        dev->submit(true, first, count, buf, NULL);
+        uint8_t *p = (uint8_t *)buf;
+        for (uint32_t i = 0; csize > 0 and i < count; i++)
+            soCacheRefresh(first + i, p + (size_t)i * BlockSize);
+    }
+
+    /* ********************************************* */
+
+    void soWaitRawBlocks(void)
+    {
+        soProbe(SOPROBE_GREEN, 761, "%s()\n", __FUNCTION__);
+
+        std::lock_guard<std::recursive_mutex> guard(rawlock);
+
+        if (fd == -1)
+            throw SOException(EBADF, __FUNCTION__);
+
+        if (dev->wait == NULL)
+            return;
+
+        /* 
+         * wait for all transfers, and then overlay the cached blocks
+         * over the completed reads, as they may be more recent 
+         */
+        std::vector<SORawPendingRead> done;
+        done.swap(pending);
+        if (cloading > 0)
+            soCacheSettle();
+        dev->wait(true);
+        for (uint32_t k = 0; csize > 0 and k < done.size(); k++)
+            for (uint32_t i = 0; i < done[k].count; i++)
+                soCacheOverlay(done[k].first + i, done[k].buf + (size_t)i * BlockSize);
     }
 
 };
 
 /* ********************************************* */
-
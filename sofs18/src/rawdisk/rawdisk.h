@@ -14,6 +14,7 @@
 
 #include <inttypes.h>
 #include <stdlib.h>
+#include <sys/types.h>
 
 namespace sofs18
 {
@@ -70,6 +71,279 @@ namespace sofs18
      */
     void soWriteRawBlock(uint32_t n, void *buf);
 
+    /* ***************************************** */
+
+    /**
+     *  \brief Read a contiguous run of blocks from the storage device.
+     *
+     *  The run is transferred with as few system calls as possible,
+     *  instead of one per block.
+     *
+     *  \param [in] first physical number of the first block to be read from
+     *  \param [in] count number of blocks to be read
+     *  \param [out] buf pointer to the buffer where the data must be read into;
+     *      it must have room for \c count blocks
+     */
+    void soReadRawBlocks(uint32_t first, uint32_t count, void *buf);
+
+    /* ***************************************** */
+
+    /**
+     *  \brief Write a contiguous run of blocks into the storage device.
+     *
+     *  The run is transferred with as few system calls as possible,
+     *  instead of one per block.
+     *
+     *  \param [in] first physical number of the first block to be written into
+     *  \param [in] count number of blocks to be written
+     *  \param [in] buf pointer to the buffer containing the \c count blocks to be written from
+     */
+    void soWriteRawBlocks(uint32_t first, uint32_t count, void *buf);
+
+    /* ***************************************** */
+
+    /**
+     *  \brief Read a contiguous run of blocks from the storage device, scattering it.
+     *
+     *  Block \c first+i is read into \c bufs[i].
+     *
+     *  \param [in] first physical number of the first block to be read from
+     *  \param [in] count number of blocks to be read
+     *  \param [in] bufs array of \c count pointers to the buffers where the data must be read into
+     */
+    void soReadRawBlocksv(uint32_t first, uint32_t count, void *bufs[]);
+
+    /* ***************************************** */
+
+    /**
+     *  \brief Write a contiguous run of blocks into the storage device, gathering it.
+     *
+     *  Block \c first+i is written from \c bufs[i].
+     *
+     *  \param [in] first physical number of the first block to be written into
+     *  \param [in] count number of blocks to be written
+     *  \param [in] bufs array of \c count pointers to the buffers containing the data to be written from
+     */
+    void soWriteRawBlocksv(uint32_t first, uint32_t count, void *bufs[]);
+
+    /* ***************************************** */
+
+    /**
+     *  \brief Access modes of the storage device
+     */
+#define RAWDISK_FILE 0      ///< blocks are transferred with read/write system calls
+#define RAWDISK_MMAP 1      ///< the whole device is memory mapped
+#define RAWDISK_URING 2     ///< blocks are transferred asynchronously, through io_uring
+#define RAWDISK_DIRECT 3    ///< blocks are transferred with O_DIRECT, bypassing the page cache
+#define RAWDISK_RAM 4       ///< the whole device is kept in memory
+
+    /* ***************************************** */
+
+    /**
+     *  \brief Set the access mode of the storage device.
+     *
+     *  In \c RAWDISK_MMAP mode the whole Linux file is mapped into memory,
+     *  block transfers become memory copies and the raw block cache is not used.
+     *  In \c RAWDISK_URING mode transfers are queued in an io_uring and several
+     *  can be in flight at once (see soSubmitReadRawBlocks);
+     *  In \c RAWDISK_DIRECT mode the Linux file is open with O_DIRECT, so blocks
+     *  are only cached by the raw block cache; transfers are aligned to the
+     *  logical block size of the underlying device.
+     *  If io_uring or O_DIRECT is not available, \c RAWDISK_FILE is silently used instead.
+     *  In \c RAWDISK_RAM mode the whole device is kept in memory
+     *  (see soSetRawRamFlags) and the raw block cache is not used.
+     *  The new mode only takes effect on the next call to soOpenRawDisk.
+     *
+     *  \param [in] mode \c RAWDISK_FILE (default), \c RAWDISK_MMAP, \c RAWDISK_URING,
+     *      \c RAWDISK_DIRECT or \c RAWDISK_RAM
+     */
+    void soSetRawDiskMode(uint32_t mode);
+
+    /* ***************************************** */
+
+    /**
+     *  \brief Flags of the \c RAWDISK_RAM mode
+     */
+#define RAWRAM_LOAD 1       ///< fill the device from the Linux file at open
+#define RAWRAM_PERSIST 2    ///< write changed blocks back to the Linux file at sync and at close
+
+    /**
+     *  \brief Set the flags of the \c RAWDISK_RAM mode.
+     *
+     *  Without \c RAWRAM_LOAD the device starts zero filled;
+     *  without \c RAWRAM_PERSIST all changes are lost when it is closed.
+     *  The new flags only take effect on the next call to soOpenRawDisk.
+     *
+     *  \param [in] flags bitwise OR of \c RAWRAM_LOAD and \c RAWRAM_PERSIST (default: both)
+     */
+    void soSetRawRamFlags(uint32_t flags);
+
+    /* ***************************************** */
+
+    /**
+     *  \brief default maximum number of transfers in flight in \c RAWDISK_URING mode
+     */
+#define RAWQUEUE_DEFAULT_DEPTH 64
+
+    /**
+     *  \brief Set the maximum number of transfers in flight in \c RAWDISK_URING mode.
+     *
+     *  The new depth only takes effect on the next call to soOpenRawDisk.
+     *
+     *  \param [in] depth queue depth, between 1 and 4096
+     */
+    void soSetRawQueueDepth(uint32_t depth);
+
+    /* ***************************************** */
+
+    /**
+     *  \brief Get the address of a block in memory.
+     *
+     *  Only possible if the storage device was open in \c RAWDISK_MMAP or \c RAWDISK_RAM mode.
+     *  Data written through the returned pointer is part of the device and is made
+     *  durable by soSyncRawDisk or soCloseRawDisk; in \c RAWDISK_RAM mode, only if
+     *  \c RAWRAM_PERSIST is set (see soSetRawRamFlags).
+     *  The pointer is valid until the storage device is closed.
+     *
+     *  \param [in] n physical number of the block
+     *  \return pointer to the block, or NULL if the access mode does not allow it
+     */
+    void *soRawBlockPointer(uint32_t n);
+
+    /* ***************************************** */
+
+    /**
+     *  \brief Get the Linux file descriptor through which a run of blocks can be transferred.
+     *
+     *  It allows data to be moved between the Linux file and other descriptors
+     *  (e.g. by splice), without going through memory.
+     *  Transfers in flight are completed, and dirty cached copies of the run are written back,
+     *  so the Linux file holds the current contents of the run;
+     *  if the run is to be written through the descriptor, its cached copies are also dropped.
+     *  Only possible if the access mode keeps the data in the Linux file, which is not the case of
+     *  \c RAWDISK_DIRECT and \c RAWDISK_RAM.
+     *  The caller must prevent other accesses to the run while using the descriptor.
+     *
+     *  \param [in] first physical number of the first block of the run
+     *  \param [in] count number of blocks of the run
+     *  \param [in] write true, if the run is to be written through the descriptor
+     *  \param [out] pos pointer to the location where the byte position of the run
+     *      in the Linux file is to be stored
+     *  \return the descriptor, or -1 if the access mode does not allow it
+     */
+    int soRawBlocksFd(uint32_t first, uint32_t count, bool write, off_t *pos);
+
+    /* ***************************************** */
+
+    /**
+     *  \brief default number of blocks kept in the raw block cache
+     */
+#define RAWCACHE_DEFAULT_SIZE 1024
+
+    /**
+     *  \brief Statistics of the raw block cache
+     */
+    struct SORawCacheStats
+    {
+        uint64_t hits;          ///< number of block reads served by the cache
+        uint64_t misses;        ///< number of block reads that went to the device
+        uint64_t writes;        ///< number of block writes absorbed by the cache
+        uint64_t writebacks;    ///< number of dirty blocks written back to the device
+        uint64_t prefetches;    ///< number of blocks loaded ahead of use by soPrefetchRawBlocks
+    };
+
+    /* ***************************************** */
+
+    /**
+     *  \brief Set the size of the raw block cache.
+     *
+     *  The raw block cache sits under soReadRawBlock and soWriteRawBlock.
+     *  Written blocks are kept dirty in the cache and are only transferred to
+     *  the storage device when evicted, when soSyncRawDisk is called or when
+     *  the storage device is closed.
+     *  The new size only takes effect on the next call to soOpenRawDisk.
+     *
+     *  \param [in] nblocks number of blocks the cache can hold (0 disables the cache)
+     */
+    void soSetRawCacheSize(uint32_t nblocks);
+
+    /* ***************************************** */
+
+    /**
+     *  \brief Write back all dirty blocks of the raw block cache.
+     *
+     *  Dirty blocks are written in ascending order of block number and then
+     *  the storage device is synchronized with the underlying Linux file.
+     */
+    void soSyncRawDisk(void);
+
+    /* ***************************************** */
+
+    /**
+     *  \brief Get the statistics of the raw block cache.
+     *
+     *  Counters are reset every time the storage device is open.
+     *
+     *  \param [out] st pointer to the location where the statistics are to be stored
+     */
+    void soGetRawCacheStats(SORawCacheStats * st);
+
+    /* ***************************************** */
+
+    /**
+     *  \brief Load a contiguous run of blocks into the raw block cache, ahead of use.
+     *
+     *  Blocks of the run not yet cached are read into the cache, so later reads
+     *  of them are hits. In \c RAWDISK_URING mode the reads are only submitted,
+     *  and a later access to one of the blocks waits for them to complete;
+     *  otherwise they are transferred right away, in a single operation.
+     *  This is only a hint: nothing is done if the raw block cache is not in use,
+     *  and the run is clipped to half the cache, so it can not evict itself.
+     *
+     *  \param [in] first physical number of the first block to be loaded
+     *  \param [in] count number of blocks to be loaded
+     */
+    void soPrefetchRawBlocks(uint32_t first, uint32_t count);
+
+    /* ***************************************** */
+
+    /**
+     *  \brief Submit the read of a contiguous run of blocks, without waiting for it.
+     *
+     *  The transfer is only guaranteed to be complete after soWaitRawBlocks is called.
+     *  Until then, \c buf must not be accessed, nor the blocks written.
+     *  If the access mode is not \c RAWDISK_URING, the transfer is done right away.
+     *
+     *  \param [in] first physical number of the first block to be read from
+     *  \param [in] count number of blocks to be read
+     *  \param [out] buf pointer to the buffer where the data must be read into
+     */
+    void soSubmitReadRawBlocks(uint32_t first, uint32_t count, void *buf);
+
+    /* ***************************************** */
+
+    /**
+     *  \brief Submit the write of a contiguous run of blocks, without waiting for it.
+     *
+     *  The transfer is only guaranteed to be complete after soWaitRawBlocks is called.
+     *  Until then, \c buf must not be modified, nor the blocks accessed.
+     *  If the access mode is not \c RAWDISK_URING, the transfer is done right away.
+     *
+     *  \param [in] first physical number of the first block to be written into
+     *  \param [in] count number of blocks to be written
+     *  \param [in] buf pointer to the buffer containing the data to be written from
+     */
+    void soSubmitWriteRawBlocks(uint32_t first, uint32_t count, void *buf);
+
+    /* ***************************************** */
+
+    /**
+     *  \brief Wait for all submitted transfers to complete.
+     *
+     *  If any of them failed, the error of the first failure is thrown.
+     */
+    void soWaitRawBlocks(void);
+
 /* ***************************************** */
 
 /** @} closing group rawdisk */
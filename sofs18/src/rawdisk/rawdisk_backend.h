@@ -0,0 +1,87 @@
+/*
+ *  \brief Private interface between the rawdisk module and its device backends
+ *
+ *  A backend performs the actual transfers between memory and the Linux file
+ *  that simulates the storage device.
+ *  The raw block cache, argument checking and probing are done by rawdisk.cpp,
+ *  so backends can assume valid arguments and an open device.
+ *
+ *  \remarks In case an error occurs, every function throws an SOException
+ */
+
+#ifndef __SOFS18_RAWDISK_BACKEND__
+#define __SOFS18_RAWDISK_BACKEND__
+
+#include <inttypes.h>
+
+namespace sofs18
+{
+
+    /* ***************************************** */
+
+    /* operations of a device backend */
+    struct SORawBackend
+    {
+        /* attach to the Linux file devname, already open as fd, with ntotal blocks */
+        void (*open)(const char *devname, int fd, uint32_t ntotal);
+
+        /* detach from the Linux file, making all written data durable */
+        void (*close)(void);
+
+        /* make all written data durable */
+        void (*sync)(void);
+
+        /* transfer a contiguous run of blocks from/to a contiguous buffer */
+        void (*read)(uint32_t first, uint32_t count, void *buf);
+        void (*write)(uint32_t first, uint32_t count, const void *buf);
+
+        /* transfer a contiguous run of blocks from/to an array of block buffers */
+        void (*readv)(uint32_t first, uint32_t count, void *bufs[]);
+        void (*writev)(uint32_t first, uint32_t count, void *bufs[]);
+
+        /* address of block n in memory, or NULL if not supported */
+        void *(*pointer)(uint32_t n);
+
+        /* true if the raw block cache should be put on top of this backend */
+        bool cached;
+
+        /* 
+         * queue a transfer of a contiguous run of blocks, without waiting for it;
+         * if res is not NULL, its outcome (0 or an errno) is stored there when it completes,
+         * otherwise it is reported by wait;
+         * NULL if the backend only does synchronous transfers 
+         */
+        void (*submit)(bool write, uint32_t first, uint32_t count, void *buf, int *res);
+
+        /* 
+         * wait for all queued transfers to complete and, if report is true, throw the
+         * first error of those submitted without res since the last report 
+         */
+        void (*wait)(bool report);
+
+        /* true if the data transferred is kept in the Linux file, so fd can also be used for it */
+        bool shared;
+    };
+
+    /* ***************************************** */
+
+    /* backend based on positional read/write system calls */
+    extern const SORawBackend soRawFileBackend;
+
+    /* backend based on a shared memory mapping of the whole file */
+    extern const SORawBackend soRawMmapBackend;
+
+    /* backend based on io_uring, with asynchronous batched transfers */
+    extern const SORawBackend soRawUringBackend;
+
+    /* backend based on direct I/O, bypassing the page cache */
+    extern const SORawBackend soRawDirectBackend;
+
+    /* backend keeping the whole device in memory */
+    extern const SORawBackend soRawRamBackend;
+
+    /* ***************************************** */
+
+};
+
+#endif /* __SOFS18_RAWDISK_BACKEND__ */
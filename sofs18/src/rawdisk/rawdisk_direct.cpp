@@ -0,0 +1,276 @@
+/*
+ *  \brief rawdisk backend based on direct I/O
+ *
+ *  The support file is opened with O_DIRECT, so blocks are not kept a second
+ *  time in the page cache, under the raw block cache.
+ *  Direct transfers must be aligned to the logical block size of the
+ *  underlying device, which may be larger than BlockSize. Transfers are
+ *  grown to aligned units, using buffers of an aligned pool, and partially
+ *  written units are read first (read-modify-write).
+ *  The tail of the file beyond the last whole unit is accessed through the
+ *  page cache, as direct writes there would grow the file.
+ */
+
+#include "rawdisk_backend.h"
+
+#include "core.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace sofs18
+{
+
+    /* ***************************************** */
+
+    static int fd = -1;         ///< File descriptor of the Linux file, through the page cache
+    static int dfd = -1;        ///< File descriptor of the Linux file, with O_DIRECT
+    static size_t align = 0;    ///< alignment of direct transfers, in bytes
+    static uint64_t dsize = 0;  ///< number of bytes, from the start, accessed with direct I/O
+
+    /* size of the buffers of the pool */
+#define RAWDIRECT_BUFSIZE (128 * 1024)
+
+    static std::vector<void *> pool;    ///< free aligned buffers
+
+    /* ********************************************* */
+
+    /* get a buffer from the pool, allocating a new one if none is free */
+    static uint8_t *soPoolGet(void)
+    {
+        if (not pool.empty())
+        {
+            void *p = pool.back();
+            pool.pop_back();
+            return (uint8_t *)p;
+        }
+
+        void *p;
+        int en = posix_memalign(&p, align, RAWDIRECT_BUFSIZE);
+        if (en != 0)
+            throw SOException(en, __FUNCTION__);
+        return (uint8_t *)p;
+    }
+
+    /* ********************************************* */
+
+    /* give a buffer back to the pool */
+    static void soPoolPut(uint8_t *p)
+    {
+        pool.push_back(p);
+    }
+
+    /* ********************************************* */
+
+    /* read/write len bytes at offset off, with no partial transfer */
+    static void soDirectIO(bool write, int xfd, uint64_t off, size_t len, void *buf)
+    {
+        ssize_t ret = write ? pwrite(xfd, buf, len, off) : pread(xfd, buf, len, off);
+        if (ret == -1)
+            throw SOException(errno, __FUNCTION__);
+        if ((size_t)ret != len)
+            throw SOException(EIO, __FUNCTION__);
+    }
+
+    /* ********************************************* */
+
+    /* transfer len bytes at offset off, between the device and buf */
+    static void soDirectXfer(bool write, uint64_t off, size_t len, uint8_t *buf)
+    {
+        /* the part beyond the last whole unit goes through the page cache */
+        uint64_t end = off + len;
+        if (end > dsize)
+        {
+            uint64_t toff = std::max(off, dsize);
+            soDirectIO(write, fd, toff, end - toff, buf + (toff - off));
+            if (off >= dsize)
+                return;
+            end = dsize;
+        }
+
+        while (off < end)
+        {
+            /* window of whole units, at most the size of a pool buffer */
+            uint64_t lo = off / align * align;
+            uint64_t hi = std::min((end + align - 1) / align * align, lo + RAWDIRECT_BUFSIZE);
+            size_t n = std::min(end, hi) - off;
+
+            /* aligned transfer into/from an aligned buffer needs no bounce */
+            if (off == lo and n == hi - lo and (uintptr_t)buf % align == 0)
+            {
+                soDirectIO(write, dfd, lo, n, buf);
+            }
+            else
+            {
+                uint8_t *bb = soPoolGet();
+                try
+                {
+                    if (not write)
+                    {
+                        soDirectIO(false, dfd, lo, hi - lo, bb);
+                        memcpy(buf, bb + (off - lo), n);
+                    }
+                    else
+                    {
+                        /* read partially written units at the window edges */
+                        bool head = off > lo;
+                        bool tail = off + n < hi;
+                        if (head)
+                            soDirectIO(false, dfd, lo, align, bb);
+                        if (tail and not (head and hi - lo == align))
+                            soDirectIO(false, dfd, hi - align, align, bb + (hi - align - lo));
+                        memcpy(bb + (off - lo), buf, n);
+                        soDirectIO(true, dfd, lo, hi - lo, bb);
+                    }
+                }
+                catch (SOException & err)
+                {
+                    soPoolPut(bb);
+                    throw;
+                }
+                soPoolPut(bb);
+            }
+
+            off += n;
+            buf += n;
+        }
+    }
+
+    /* ********************************************* */
+
+    static void soDirectOpen(const char *devname, int pfd, uint32_t ntotal)
+    {
+        if ((dfd = open(devname, O_RDWR | O_DIRECT)) == -1)
+            throw SOException(errno, __FUNCTION__);
+        fd = pfd;
+
+        /* the alignment is the transfer size preferred by the file system */
+        struct stat st;
+        if (fstat(dfd, &st) == -1)
+        {
+            int en = errno;
+            close(dfd);
+            dfd = -1;
+            throw SOException(en, __FUNCTION__);
+        }
+        align = std::max((size_t)st.st_blksize, (size_t)BlockSize);
+        if (align > RAWDIRECT_BUFSIZE or RAWDIRECT_BUFSIZE % align != 0)
+        {
+            close(dfd);
+            dfd = -1;
+            throw SOException(EINVAL, __FUNCTION__);
+        }
+        dsize = (uint64_t)ntotal * BlockSize / align * align;
+    }
+
+    /* ********************************************* */
+
+    static void soDirectClose(void)
+    {
+        int en = 0;
+        if (fsync(dfd) == -1)
+            en = errno;
+        close(dfd);
+        dfd = fd = -1;
+
+        for (void *p : pool)
+            free(p);
+        pool.clear();
+
+        if (en != 0)
+            throw SOException(en, __FUNCTION__);
+    }
+
+    /* ********************************************* */
+
+    static void soDirectSync(void)
+    {
+        /* direct transfers may still be in the device cache */
+        if (fsync(dfd) == -1)
+            throw SOException(errno, __FUNCTION__);
+    }
+
+    /* ********************************************* */
+
+    static void soDirectRead(uint32_t first, uint32_t count, void *buf)
+    {
+        soDirectXfer(false, (uint64_t)first * BlockSize, (size_t)count * BlockSize, (uint8_t *)buf);
+    }
+
+    /* ********************************************* */
+
+    static void soDirectWrite(uint32_t first, uint32_t count, const void *buf)
+    {
+        soDirectXfer(true, (uint64_t)first * BlockSize, (size_t)count * BlockSize, (uint8_t *)buf);
+    }
+
+    /* ********************************************* */
+
+    /* scattered runs are gathered into pool buffers, so units are written once */
+    static void soDirectReadv(uint32_t first, uint32_t count, void *bufs[])
+    {
+        const uint32_t chunk = RAWDIRECT_BUFSIZE / BlockSize;
+        uint8_t *tmp = soPoolGet();
+        try
+        {
+            for (uint32_t i = 0; i < count; i += chunk)
+            {
+                uint32_t k = std::min(count - i, chunk);
+                soDirectRead(first + i, k, tmp);
+                for (uint32_t j = 0; j < k; j++)
+                    memcpy(bufs[i + j], tmp + (size_t)j * BlockSize, BlockSize);
+            }
+        }
+        catch (SOException & err)
+        {
+            soPoolPut(tmp);
+            throw;
+        }
+        soPoolPut(tmp);
+    }
+
+    /* ********************************************* */
+
+    static void soDirectWritev(uint32_t first, uint32_t count, void *bufs[])
+    {
+        const uint32_t chunk = RAWDIRECT_BUFSIZE / BlockSize;
+        uint8_t *tmp = soPoolGet();
+        try
+        {
+            for (uint32_t i = 0; i < count; i += chunk)
+            {
+                uint32_t k = std::min(count - i, chunk);
+                for (uint32_t j = 0; j < k; j++)
+                    memcpy(tmp + (size_t)j * BlockSize, bufs[i + j], BlockSize);
+                soDirectWrite(first + i, k, tmp);
+            }
+        }
+        catch (SOException & err)
+        {
+            soPoolPut(tmp);
+            throw;
+        }
+        soPoolPut(tmp);
+    }
+
+    /* ********************************************* */
+
+    const SORawBackend soRawDirectBackend = {
+        soDirectOpen, soDirectClose, soDirectSync,
+        soDirectRead, soDirectWrite, soDirectReadv, soDirectWritev,
+        NULL, true,
+        NULL, NULL,
+        false
+    };
+
+};
+
+/* ********************************************* */
@@ -0,0 +1,147 @@
+/*
+ *  \brief rawdisk backend based on positional read/write system calls
+ *
+ *  \author Artur Pereira - 2007-2009, 2016-2018
+ *  \author Miguel Oliveira e Silva - 2009, 2017
+ *  \author António Rui Borges - 2010-2015
+ */
+
+#include "rawdisk_backend.h"
+
+#include "core.h"
+
+#include <unistd.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/uio.h>
+
+#include <algorithm>
+
+namespace sofs18
+{
+
+    /* ***************************************** */
+
+    static int fd = -1;     ///< File descriptor of the Linux file that simulates the disk
+
+    /* maximum number of blocks transferred by a single system call */
+#define RAWRUN_MAX (IOV_MAX < 1024 ? IOV_MAX : 1024)
+
+    /* ********************************************* */
+
+    static void soFileOpen(const char *devname, int dfd, uint32_t ntotal)
+    {
+        fd = dfd;
+    }
+
+    /* ********************************************* */
+
+    static void soFileClose(void)
+    {
+        fd = -1;
+    }
+
+    /* ********************************************* */
+
+    static void soFileSync(void)
+    {
+        if (fsync(fd) == -1)
+            throw SOException(errno, __FUNCTION__);
+    }
+
+    /* ********************************************* */
+
+    /* transfer a contiguous run of blocks from the device */
+    static void soFileRead(uint32_t first, uint32_t count, void *buf)
+    {
+        uint8_t *p = (uint8_t *)buf;
+        while (count > 0)
+        {
+            uint32_t k = std::min(count, (uint32_t)RAWRUN_MAX);
+            ssize_t len = (ssize_t)k * BlockSize;
+            if (pread(fd, p, len, (off_t)BlockSize * first) != len)
+                throw SOException(EIO, __FUNCTION__);
+            first += k;
+            count -= k;
+            p += len;
+        }
+    }
+
+    /* ********************************************* */
+
+    /* transfer a contiguous run of blocks to the device */
+    static void soFileWrite(uint32_t first, uint32_t count, const void *buf)
+    {
+        const uint8_t *p = (const uint8_t *)buf;
+        while (count > 0)
+        {
+            uint32_t k = std::min(count, (uint32_t)RAWRUN_MAX);
+            ssize_t len = (ssize_t)k * BlockSize;
+            if (pwrite(fd, p, len, (off_t)BlockSize * first) != len)
+                throw SOException(EIO, __FUNCTION__);
+            first += k;
+            count -= k;
+            p += len;
+        }
+    }
+
+    /* ********************************************* */
+
+    /* transfer a contiguous run of blocks from the device, scattering it over bufs */
+    static void soFileReadv(uint32_t first, uint32_t count, void *bufs[])
+    {
+        struct iovec iov[RAWRUN_MAX];
+        while (count > 0)
+        {
+            uint32_t k = std::min(count, (uint32_t)RAWRUN_MAX);
+            for (uint32_t i = 0; i < k; i++)
+            {
+                iov[i].iov_base = bufs[i];
+                iov[i].iov_len = BlockSize;
+            }
+            ssize_t len = (ssize_t)k * BlockSize;
+            if (preadv(fd, iov, k, (off_t)BlockSize * first) != len)
+                throw SOException(EIO, __FUNCTION__);
+            first += k;
+            count -= k;
+            bufs += k;
+        }
+    }
+
+    /* ********************************************* */
+
+    /* transfer a contiguous run of blocks to the device, gathering it from bufs */
+    static void soFileWritev(uint32_t first, uint32_t count, void *bufs[])
+    {
+        struct iovec iov[RAWRUN_MAX];
+        while (count > 0)
+        {
+            uint32_t k = std::min(count, (uint32_t)RAWRUN_MAX);
+            for (uint32_t i = 0; i < k; i++)
+            {
+                iov[i].iov_base = bufs[i];
+                iov[i].iov_len = BlockSize;
+            }
+            ssize_t len = (ssize_t)k * BlockSize;
+            if (pwritev(fd, iov, k, (off_t)BlockSize * first) != len)
+                throw SOException(EIO, __FUNCTION__);
+            first += k;
+            count -= k;
+            bufs += k;
+        }
+    }
+
+    /* ********************************************* */
+
+    const SORawBackend soRawFileBackend = {
+        soFileOpen, soFileClose, soFileSync,
+        soFileRead, soFileWrite, soFileReadv, soFileWritev,
+        NULL, true,
+        NULL, NULL,
+        true
+    };
+
+};
+
+/* ********************************************* */
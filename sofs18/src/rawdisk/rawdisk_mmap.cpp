@@ -0,0 +1,109 @@
+/*
+ *  \brief rawdisk backend based on a shared memory mapping of the whole file
+ *
+ *  Block transfers become memory copies and blocks can be accessed in place.
+ *  Written data reaches the Linux file through the page cache and is made
+ *  durable with msync.
+ */
+
+#include "rawdisk_backend.h"
+
+#include "core.h"
+
+#include <sys/mman.h>
+#include <inttypes.h>
+#include <string.h>
+#include <errno.h>
+
+namespace sofs18
+{
+
+    /* ***************************************** */
+
+    static uint8_t *base = NULL;    ///< start of the mapping
+    static size_t len = 0;          ///< length of the mapping
+
+    /* ********************************************* */
+
+    static void soMmapOpen(const char *devname, int fd, uint32_t ntotal)
+    {
+        len = (size_t)ntotal * BlockSize;
+        void *p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED)
+            throw SOException(errno, __FUNCTION__);
+        base = (uint8_t *)p;
+    }
+
+    /* ********************************************* */
+
+    static void soMmapClose(void)
+    {
+        int en = 0;
+        if (msync(base, len, MS_SYNC) == -1)
+            en = errno;
+        munmap(base, len);
+        base = NULL;
+        len = 0;
+        if (en != 0)
+            throw SOException(en, __FUNCTION__);
+    }
+
+    /* ********************************************* */
+
+    static void soMmapSync(void)
+    {
+        if (msync(base, len, MS_SYNC) == -1)
+            throw SOException(errno, __FUNCTION__);
+    }
+
+    /* ********************************************* */
+
+    static void soMmapRead(uint32_t first, uint32_t count, void *buf)
+    {
+        memcpy(buf, base + (size_t)first * BlockSize, (size_t)count * BlockSize);
+    }
+
+    /* ********************************************* */
+
+    static void soMmapWrite(uint32_t first, uint32_t count, const void *buf)
+    {
+        memcpy(base + (size_t)first * BlockSize, buf, (size_t)count * BlockSize);
+    }
+
+    /* ********************************************* */
+
+    static void soMmapReadv(uint32_t first, uint32_t count, void *bufs[])
+    {
+        for (uint32_t i = 0; i < count; i++)
+            memcpy(bufs[i], base + (size_t)(first + i) * BlockSize, BlockSize);
+    }
+
+    /* ********************************************* */
+
+    static void soMmapWritev(uint32_t first, uint32_t count, void *bufs[])
+    {
+        for (uint32_t i = 0; i < count; i++)
+            memcpy(base + (size_t)(first + i) * BlockSize, bufs[i], BlockSize);
+    }
+
+    /* ********************************************* */
+
+    static void *soMmapPointer(uint32_t n)
+    {
+        return base + (size_t)n * BlockSize;
+    }
+
+    /* ********************************************* */
+
+    /* the mapping already is a cache, so the raw block cache is not used */
+    const SORawBackend soRawMmapBackend = {
+        soMmapOpen, soMmapClose, soMmapSync,
+        soMmapRead, soMmapWrite, soMmapReadv, soMmapWritev,
+        soMmapPointer, false,
+        NULL, NULL,
+        true
+    };
+
+};
+
+/* ********************************************* */
@@ -0,0 +1,219 @@
+/*
+ *  \brief rawdisk backend keeping the whole device in memory
+ *
+ *  The device lives in an anonymous mapping, backed by huge pages if the
+ *  system has them reserved (or, failing that, eligible for transparent huge pages).
+ *  Depending on the configured flags, it is filled from the Linux file at open
+ *  and blocks written since are written back to it at sync and at close.
+ */
+
+#include "rawdisk.h"
+#include "rawdisk_backend.h"
+
+#include "core.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <string.h>
+#include <errno.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace sofs18
+{
+
+    /* ***************************************** */
+
+    static uint32_t rconf = RAWRAM_LOAD | RAWRAM_PERSIST;  ///< configured flags
+
+    static int fd = -1;             ///< File descriptor of the Linux file that simulates the disk
+    static uint32_t flags = 0;      ///< flags of the open device
+    static uint32_t nblocks = 0;    ///< number of blocks of the device
+    static uint8_t *base = NULL;    ///< start of the memory area
+    static size_t len = 0;          ///< length of the memory area
+    static std::vector<bool> dirty; ///< blocks written since last written back
+
+    /* size of huge pages, to which the area length is rounded */
+#define RAWRAM_HUGEPAGE (2 * 1024 * 1024)
+
+    /* number of blocks transferred at once while loading and writing back */
+#define RAWRAM_CHUNK 2048
+
+    /* ********************************************* */
+
+    void soSetRawRamFlags(uint32_t f)
+    {
+        soProbe(SOPROBE_GREEN, 763, "%s(%" PRIu32 ")\n", __FUNCTION__, f);
+
+        if ((f & ~(RAWRAM_LOAD | RAWRAM_PERSIST)) != 0)
+            throw SOException(EINVAL, __FUNCTION__);
+
+        rconf = f;
+    }
+
+    /* ********************************************* */
+
+    /* write back runs of dirty blocks */
+    static void soRamPersist(void)
+    {
+        uint32_t i = 0;
+        while (i < nblocks)
+        {
+            if (not dirty[i])
+            {
+                i++;
+                continue;
+            }
+            uint32_t k = 1;
+            while (i + k < nblocks and k < RAWRAM_CHUNK and dirty[i + k])
+                k++;
+
+            ssize_t n = (ssize_t)k * BlockSize;
+            if (pwrite(fd, base + (size_t)i * BlockSize, n, (off_t)i * BlockSize) != n)
+                throw SOException(EIO, __FUNCTION__);
+            for (uint32_t j = i; j < i + k; j++)
+                dirty[j] = false;
+            i += k;
+        }
+    }
+
+    /* ********************************************* */
+
+    static void soRamOpen(const char *devname, int dfd, uint32_t ntotal)
+    {
+        fd = dfd;
+        flags = rconf;
+        nblocks = ntotal;
+
+        /* try huge pages first */
+        len = ((size_t)ntotal * BlockSize + RAWRAM_HUGEPAGE - 1) / RAWRAM_HUGEPAGE * RAWRAM_HUGEPAGE;
+        void *p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p == MAP_FAILED)
+        {
+            p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p == MAP_FAILED)
+                throw SOException(errno, __FUNCTION__);
+            madvise(p, len, MADV_HUGEPAGE);
+        }
+        base = (uint8_t *)p;
+        dirty.assign(ntotal, false);
+
+        /* fill it from the Linux file */
+        if (flags & RAWRAM_LOAD)
+        {
+            for (uint32_t i = 0; i < ntotal; i += RAWRAM_CHUNK)
+            {
+                ssize_t n = (ssize_t)std::min(ntotal - i, (uint32_t)RAWRAM_CHUNK) * BlockSize;
+                if (pread(fd, base + (size_t)i * BlockSize, n, (off_t)i * BlockSize) != n)
+                {
+                    munmap(base, len);
+                    base = NULL;
+                    throw SOException(EIO, __FUNCTION__);
+                }
+            }
+        }
+    }
+
+    /* ********************************************* */
+
+    static void soRamClose(void)
+    {
+        /* write back, but release the memory even if it fails */
+        int en = 0;
+        try
+        {
+            if (flags & RAWRAM_PERSIST)
+            {
+                soRamPersist();
+                if (fsync(fd) == -1)
+                    en = errno;
+            }
+        }
+        catch (SOException & err)
+        {
+            en = err.en;
+        }
+
+        munmap(base, len);
+        base = NULL;
+        len = 0;
+        dirty.clear();
+        fd = -1;
+
+        if (en != 0)
+            throw SOException(en, __FUNCTION__);
+    }
+
+    /* ********************************************* */
+
+    static void soRamSync(void)
+    {
+        if (flags & RAWRAM_PERSIST)
+        {
+            soRamPersist();
+            if (fsync(fd) == -1)
+                throw SOException(errno, __FUNCTION__);
+        }
+    }
+
+    /* ********************************************* */
+
+    static void soRamRead(uint32_t first, uint32_t count, void *buf)
+    {
+        memcpy(buf, base + (size_t)first * BlockSize, (size_t)count * BlockSize);
+    }
+
+    /* ********************************************* */
+
+    static void soRamWrite(uint32_t first, uint32_t count, const void *buf)
+    {
+        memcpy(base + (size_t)first * BlockSize, buf, (size_t)count * BlockSize);
+        for (uint32_t i = first; i < first + count; i++)
+            dirty[i] = true;
+    }
+
+    /* ********************************************* */
+
+    static void soRamReadv(uint32_t first, uint32_t count, void *bufs[])
+    {
+        for (uint32_t i = 0; i < count; i++)
+            memcpy(bufs[i], base + (size_t)(first + i) * BlockSize, BlockSize);
+    }
+
+    /* ********************************************* */
+
+    static void soRamWritev(uint32_t first, uint32_t count, void *bufs[])
+    {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            memcpy(base + (size_t)(first + i) * BlockSize, bufs[i], BlockSize);
+            dirty[first + i] = true;
+        }
+    }
+
+    /* ********************************************* */
+
+    /* the block may be written through the pointer, so it is taken as dirty */
+    static void *soRamPointer(uint32_t n)
+    {
+        dirty[n] = true;
+        return base + (size_t)n * BlockSize;
+    }
+
+    /* ********************************************* */
+
+    /* memory already is as fast as the raw block cache, so it is not used */
+    const SORawBackend soRawRamBackend = {
+        soRamOpen, soRamClose, soRamSync,
+        soRamRead, soRamWrite, soRamReadv, soRamWritev,
+        soRamPointer, false,
+        NULL, NULL,
+        false
+    };
+
+};
+
+/* ********************************************* */
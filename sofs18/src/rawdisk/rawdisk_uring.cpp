@@ -0,0 +1,394 @@
+/*
+ *  \brief rawdisk backend based on io_uring
+ *
+ *  Transfers are queued in the submission ring and only handed to the kernel,
+ *  with a single io_uring_enter call, when the ring is full or when completion
+ *  is awaited, so a batch of requests is kept in flight at once.
+ *  The ring is driven with the raw system calls, so no extra library is needed.
+ */
+
+#include "rawdisk.h"
+#include "rawdisk_backend.h"
+
+#include "core.h"
+
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <string.h>
+#include <errno.h>
+
+#include <algorithm>
+
+namespace sofs18
+{
+
+    /* ***************************************** */
+
+    static uint32_t qconf = RAWQUEUE_DEFAULT_DEPTH;  ///< configured queue depth
+
+    static int fd = -1;         ///< File descriptor of the Linux file that simulates the disk
+    static int rfd = -1;        ///< File descriptor of the ring
+
+    /* submission ring */
+    static void *sqmap = NULL;
+    static size_t sqmaplen = 0;
+    static unsigned *sqhead, *sqtail, *sqmask, *sqarray;
+    static uint32_t sqentries;
+    static struct io_uring_sqe *sqes = NULL;
+    static size_t sqeslen = 0;
+
+    /* completion ring */
+    static void *cqmap = NULL;
+    static size_t cqmaplen = 0;
+    static unsigned *cqhead, *cqtail, *cqmask;
+    static struct io_uring_cqe *cqes;
+
+    static struct iovec *iovs = NULL;   ///< one iovec per submission slot
+    static uint32_t queued = 0;         ///< requests in the ring, not yet handed to the kernel
+    static uint32_t inflight = 0;       ///< requests handed to the kernel, not yet completed
+    static int qerror = 0;              ///< first error of the requests queued without a result
+
+    /* a request not yet completed, identified by the user_data of its entries */
+    struct SOUringRequest
+    {
+        size_t len;     ///< number of bytes to transfer
+        int *res;       ///< where to store the outcome, or NULL to report it in soUringWait
+    };
+    static SOUringRequest *reqs = NULL; ///< one record per request that may be outstanding
+    static uint32_t *rfree = NULL;      ///< indices of the free records
+    static uint32_t nfree = 0;          ///< number of free records
+
+    /* maximum number of blocks of a single request */
+#define RAWREQ_MAX 1024
+
+    /* ********************************************* */
+
+    void soSetRawQueueDepth(uint32_t depth)
+    {
+        soProbe(SOPROBE_GREEN, 762, "%s(%" PRIu32 ")\n", __FUNCTION__, depth);
+
+        if (depth == 0 or depth > 4096)
+            throw SOException(EINVAL, __FUNCTION__);
+
+        qconf = depth;
+    }
+
+    /* ********************************************* */
+
+    /* hand queued requests to the kernel, waiting for at least mincomplete completions */
+    static void soUringEnter(uint32_t mincomplete)
+    {
+        while (true)
+        {
+            int ret = syscall(__NR_io_uring_enter, rfd, queued, mincomplete,
+                    mincomplete > 0 ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+            if (ret >= 0)
+            {
+                queued -= ret;
+                inflight += ret;
+                return;
+            }
+            if (errno != EINTR)
+                throw SOException(errno, __FUNCTION__);
+        }
+    }
+
+    /* ********************************************* */
+
+    /* consume available completions */
+    static void soUringReap(void)
+    {
+        unsigned head = *cqhead;
+        while (head != __atomic_load_n(cqtail, __ATOMIC_ACQUIRE))
+        {
+            struct io_uring_cqe *cqe = &cqes[head & *cqmask];
+            SOUringRequest *rq = &reqs[cqe->user_data];
+            int en = 0;
+            if (cqe->res < 0)
+                en = -cqe->res;
+            else if ((uint64_t)cqe->res != rq->len)
+                en = EIO;
+
+            /* the outcome goes to the request owner, so it never reaches unrelated callers */
+            int *res = (rq->res != NULL) ? rq->res : &qerror;
+            if (en != 0 and *res == 0)
+                *res = en;
+            rfree[nfree++] = cqe->user_data;
+            head++;
+            inflight--;
+        }
+        __atomic_store_n(cqhead, head, __ATOMIC_RELEASE);
+    }
+
+    /* ********************************************* */
+
+    /* wait until all queued and in flight requests complete */
+    static void soUringDrain(void)
+    {
+        while (queued > 0 or inflight > 0)
+        {
+            soUringEnter(queued + inflight);
+            soUringReap();
+        }
+    }
+
+    /* ********************************************* */
+
+    /* 
+     * wait until all requests complete and, if report is true, throw the first
+     * error of those queued without a result since the last report 
+     */
+    static void soUringWait(bool report)
+    {
+        soUringDrain();
+
+        if (report and qerror != 0)
+        {
+            int en = qerror;
+            qerror = 0;
+            throw SOException(en, __FUNCTION__);
+        }
+    }
+
+    /* ********************************************* */
+
+    /* queue a single request, making room in the ring if necessary */
+    static void soUringQueue(int op, uint32_t first, void *buf, size_t len, int *res)
+    {
+        /* the slot, and its iovec, can only be reused after its previous request completes */
+        if (queued + inflight == sqentries)
+        {
+            soUringEnter(1);
+            soUringReap();
+        }
+
+        unsigned tail = *sqtail;
+        unsigned idx = tail & *sqmask;
+        iovs[idx].iov_base = buf;
+        iovs[idx].iov_len = len;
+
+        struct io_uring_sqe *sqe = &sqes[idx];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = op;
+        sqe->fd = fd;
+        sqe->off = (uint64_t)BlockSize * first;
+        sqe->addr = (uint64_t)(uintptr_t)&iovs[idx];
+        sqe->len = 1;
+
+        uint32_t r = rfree[--nfree];
+        reqs[r].len = len;
+        reqs[r].res = res;
+        sqe->user_data = r;
+
+        sqarray[idx] = idx;
+        __atomic_store_n(sqtail, tail + 1, __ATOMIC_RELEASE);
+        queued++;
+    }
+
+    /* ********************************************* */
+
+    static void soUringSubmit(bool write, uint32_t first, uint32_t count, void *buf, int *res)
+    {
+        uint8_t *p = (uint8_t *)buf;
+        while (count > 0)
+        {
+            uint32_t k = std::min(count, (uint32_t)RAWREQ_MAX);
+            soUringQueue(write ? IORING_OP_WRITEV : IORING_OP_READV, first, p, (size_t)k * BlockSize, res);
+            first += k;
+            count -= k;
+            p += (size_t)k * BlockSize;
+        }
+    }
+
+    /* ********************************************* */
+
+    static void soUringClose(void)
+    {
+        /* drain the ring, but release resources even if it fails */
+        int en = 0;
+        try
+        {
+            soUringWait(true);
+            if (fsync(fd) == -1)
+                en = errno;
+        }
+        catch (SOException & err)
+        {
+            en = err.en;
+        }
+
+        if (sqes != NULL)
+            munmap(sqes, sqeslen);
+        if (cqmap != NULL and cqmap != sqmap)
+            munmap(cqmap, cqmaplen);
+        if (sqmap != NULL)
+            munmap(sqmap, sqmaplen);
+        if (rfd != -1)
+            close(rfd);
+        delete [] iovs;
+        delete [] reqs;
+        delete [] rfree;
+        sqes = NULL;
+        sqmap = cqmap = NULL;
+        iovs = NULL;
+        reqs = NULL;
+        rfree = NULL;
+        nfree = 0;
+        rfd = fd = -1;
+        queued = inflight = 0;
+        qerror = 0;
+
+        if (en != 0)
+            throw SOException(en, __FUNCTION__);
+    }
+
+    /* ********************************************* */
+
+    static void soUringOpen(const char *devname, int dfd, uint32_t ntotal)
+    {
+        struct io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        if ((rfd = syscall(__NR_io_uring_setup, qconf, &params)) == -1)
+            throw SOException(errno, __FUNCTION__);
+        fd = dfd;
+
+        try
+        {
+            /* map the rings, which may share a single mapping */
+            sqmaplen = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            cqmaplen = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+            if (params.features & IORING_FEAT_SINGLE_MMAP)
+                sqmaplen = cqmaplen = std::max(sqmaplen, cqmaplen);
+
+            sqmap = mmap(NULL, sqmaplen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    rfd, IORING_OFF_SQ_RING);
+            if (sqmap == MAP_FAILED)
+            {
+                sqmap = NULL;
+                throw SOException(errno, __FUNCTION__);
+            }
+
+            if (params.features & IORING_FEAT_SINGLE_MMAP)
+                cqmap = sqmap;
+            else
+            {
+                cqmap = mmap(NULL, cqmaplen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        rfd, IORING_OFF_CQ_RING);
+                if (cqmap == MAP_FAILED)
+                {
+                    cqmap = NULL;
+                    throw SOException(errno, __FUNCTION__);
+                }
+            }
+
+            sqeslen = params.sq_entries * sizeof(struct io_uring_sqe);
+            void *p = mmap(NULL, sqeslen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    rfd, IORING_OFF_SQES);
+            if (p == MAP_FAILED)
+                throw SOException(errno, __FUNCTION__);
+            sqes = (struct io_uring_sqe *)p;
+        }
+        catch (SOException & err)
+        {
+            soUringClose();
+            throw;
+        }
+
+        uint8_t *sq = (uint8_t *)sqmap;
+        sqhead = (unsigned *)(sq + params.sq_off.head);
+        sqtail = (unsigned *)(sq + params.sq_off.tail);
+        sqmask = (unsigned *)(sq + params.sq_off.ring_mask);
+        sqarray = (unsigned *)(sq + params.sq_off.array);
+        sqentries = params.sq_entries;
+
+        uint8_t *cq = (uint8_t *)cqmap;
+        cqhead = (unsigned *)(cq + params.cq_off.head);
+        cqtail = (unsigned *)(cq + params.cq_off.tail);
+        cqmask = (unsigned *)(cq + params.cq_off.ring_mask);
+        cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+        iovs = new struct iovec[sqentries];
+        reqs = new SOUringRequest[sqentries];
+        rfree = new uint32_t[sqentries];
+        for (nfree = 0; nfree < sqentries; nfree++)
+            rfree[nfree] = sqentries - 1 - nfree;
+        queued = inflight = 0;
+        qerror = 0;
+    }
+
+    /* ********************************************* */
+
+    static void soUringSync(void)
+    {
+        soUringWait(true);
+        if (fsync(fd) == -1)
+            throw SOException(errno, __FUNCTION__);
+    }
+
+    /* ********************************************* */
+
+    /* 
+     * synchronous transfers only report their own errors,
+     * leaving those of the other requests to their owners 
+     */
+    static void soUringRead(uint32_t first, uint32_t count, void *buf)
+    {
+        int en = 0;
+        soUringSubmit(false, first, count, buf, &en);
+        soUringDrain();
+        if (en != 0)
+            throw SOException(en, __FUNCTION__);
+    }
+
+    /* ********************************************* */
+
+    static void soUringWrite(uint32_t first, uint32_t count, const void *buf)
+    {
+        int en = 0;
+        soUringSubmit(true, first, count, (void *)buf, &en);
+        soUringDrain();
+        if (en != 0)
+            throw SOException(en, __FUNCTION__);
+    }
+
+    /* ********************************************* */
+
+    static void soUringReadv(uint32_t first, uint32_t count, void *bufs[])
+    {
+        int en = 0;
+        for (uint32_t i = 0; i < count; i++)
+            soUringQueue(IORING_OP_READV, first + i, bufs[i], BlockSize, &en);
+        soUringDrain();
+        if (en != 0)
+            throw SOException(en, __FUNCTION__);
+    }
+
+    /* ********************************************* */
+
+    static void soUringWritev(uint32_t first, uint32_t count, void *bufs[])
+    {
+        int en = 0;
+        for (uint32_t i = 0; i < count; i++)
+            soUringQueue(IORING_OP_WRITEV, first + i, bufs[i], BlockSize, &en);
+        soUringDrain();
+        if (en != 0)
+            throw SOException(en, __FUNCTION__);
+    }
+
+    /* ********************************************* */
+
+    const SORawBackend soRawUringBackend = {
+        soUringOpen, soUringClose, soUringSync,
+        soUringRead, soUringWrite, soUringReadv, soUringWritev,
+        NULL, true,
+        soUringSubmit, soUringWait,
+        true
+    };
+
+};
+
+/* ********************************************* */
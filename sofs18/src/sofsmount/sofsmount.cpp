@@ -27,26 +27,51 @@
 #include <pthread.h>
 #include <errno.h>
 #include <string.h>
-#include <fuse.h>
-#include <fuse/fuse.h>
+#include <time.h>
+#include <fuse3/fuse.h>
 
 #include "core.h"
+#include "rawdisk.h"
+#include "dal.h"
+#include "freelists.h"
+#include "fileblocks.h"
+#include "direntries.h"
 #include "syscalls.h"
 
+#include "sofsmount.h"
+
 using namespace sofs18;
 
 /* ***************************************************** */
 
-/*
- *  Access with mutual exclusion to some of the operations
- */
-static pthread_mutex_t accessCR = PTHREAD_MUTEX_INITIALIZER;    /* locking flag */
+/* SOFS18 support filename (should be the absolute path) */
+char *sofs_supp_file = NULL;
 
-/* ***************************************************** */
+/* tuning of the FUSE connection */
+SOMountOptions sofs_opts = { false, false, 0, 1.0, 1.0 };
 
-/* SOFS18 support filename (should be the absolute path) */
-static char *sofs_supp_file = NULL;
+/* ***************************************************** */
 
+void sofs_conn_setup(struct fuse_conn_info *conn)
+{
+    /* the kernel keeps, and merges, written pages, sending them later in large writes */
+    if (sofs_opts.writeback and (conn->capable & FUSE_CAP_WRITEBACK_CACHE))
+        conn->want |= FUSE_CAP_WRITEBACK_CACHE;
+
+    const unsigned splice = FUSE_CAP_SPLICE_READ | FUSE_CAP_SPLICE_WRITE | FUSE_CAP_SPLICE_MOVE;
+    if (sofs_opts.splice)
+        conn->want |= conn->capable & splice;
+    else
+        conn->want &= ~splice;
+
+    /* max_read must also be given as a mount option, which is done by main */
+    if (sofs_opts.maxio != 0)
+    {
+        conn->max_write = sofs_opts.maxio;
+        conn->max_read = sofs_opts.maxio;
+        conn->max_readahead = sofs_opts.maxio;
+    }
+}
 
 /* ***************************************************** */
 
@@ -56,18 +81,24 @@ static char *sofs_supp_file = NULL;
  *  The return value will be passed in the private_data field of fuse_context to all 
  *  file operations and as a parameter to the destroy () method.
  *
- *  \remarks Introduced in version 2.3 and changed in version 2.6.
+ *  \remarks Introduced in version 2.3 and changed in version 3.0.
  *  \param fci pointer to fuse connection information
+ *  \param cfg pointer to the configuration of the high-level interface
  *  \return pointer to the path of the support file
  */
-static void *sofs_mount(struct fuse_conn_info *fci)
+static void *sofs_mount(struct fuse_conn_info *fci, struct fuse_config *cfg)
 {
 fprintf(stderr, "=============================================\n");
     soProbe(SOPROBE_GREEN, 11, "%s()\n", __FUNCTION__);
 
+    sofs_conn_setup(fci);
+    cfg->entry_timeout = cfg->negative_timeout = sofs_opts.entryTimeout;
+    cfg->attr_timeout = sofs_opts.attrTimeout;
+
     int stat;
     if ((stat = soOpenFileSystem(sofs_supp_file)) != 0)
         return NULL;
+    sofs_start_flusher();
     return sofs_supp_file;
 }
 
@@ -87,9 +118,10 @@ static void sofs_unmount(void *path)
 fprintf(stderr, "=============================================\n");
     soProbe(SOPROBE_GREEN, 11, "%s(\"%s\")\n", __FUNCTION__, (char *)path);
 
-    pthread_mutex_lock(&accessCR);
+    sofs_stop_flusher();
+    SOInodeLock *il = sofs_enter(NULL, SOFS_LOCK_NAMESPACE);
     soCloseFileSystem();
-    pthread_mutex_unlock(&accessCR);
+    sofs_leave(il);
 }
 
 /* ***************************************************** */
@@ -105,17 +137,19 @@ fprintf(stderr, "=============================================\n");
  *
  *  \param path pointer to path
  *  \param st pointer to stat structure
+ *  \param fi pointer to fuse file information, if the file is open
  *
  *  \return 0, on success, and a negative value, on error
  */
-static int sofs_getattr(const char *path, struct stat *st)
+static int sofs_getattr(const char *path, struct stat *st, struct fuse_file_info *fi)
 {
 fprintf(stderr, "=============================================\n");
     soProbe(SOPROBE_GREEN, 11, "%s(\"%s\", %p)\n", __FUNCTION__, path, st);
 
-    pthread_mutex_lock(&accessCR);
-    int ret = soStat(path, st);
-    pthread_mutex_unlock(&accessCR);
+    /* the inode resolved by sofs_enter is used; the path is left to report errors */
+    SOInodeLock *il = sofs_enter(path, SOFS_LOCK_READ);
+    int ret = (il != NULL) ? soStatInode(sofs_locked_inode(il), st) : soStat(path, st);
+    sofs_leave(il);
     return ret;
 }
 
@@ -138,9 +172,10 @@ static int sofs_access(const char *path, int opRequested)
 fprintf(stderr, "=============================================\n");
     soProbe(SOPROBE_GREEN, 11, "%s(\"%s\", %x)\n", __FUNCTION__, path, opRequested);
 
-    pthread_mutex_lock(&accessCR);
-    int ret = soAccess(path, opRequested);
-    pthread_mutex_unlock(&accessCR);
+    SOInodeLock *il = sofs_enter(path, SOFS_LOCK_READ);
+    int ret = (il != NULL) ? soAccessInode(sofs_locked_inode(il), opRequested)
+        : soAccess(path, opRequested);
+    sofs_leave(il);
     return ret;
 }
 
@@ -167,9 +202,9 @@ fprintf(stderr, "=============================================\n");
     soProbe(SOPROBE_GREEN, 11, "%s(\"%s\", %x, %x)\n", __FUNCTION__, path, 
             (uint32_t) mode, (uint32_t) rdev);
 
-    pthread_mutex_lock(&accessCR);
+    SOInodeLock *il = sofs_enter(path, SOFS_LOCK_NAMESPACE);
     int ret = soMknod(path, mode);
-    pthread_mutex_unlock(&accessCR);
+    sofs_leave(il);
     return ret;
 }
 
@@ -190,9 +225,9 @@ static int sofs_mkdir(const char *path, mode_t mode)
 fprintf(stderr, "=============================================\n");
     soProbe(SOPROBE_GREEN, 11, "%s(\"%s\", %x)\n", __FUNCTION__, path, (uint32_t) mode);
 
-    pthread_mutex_lock(&accessCR);
+    SOInodeLock *il = sofs_enter(path, SOFS_LOCK_NAMESPACE);
     int ret = soMkdir(path, mode);
-    pthread_mutex_unlock(&accessCR);
+    sofs_leave(il);
     return ret;
 }
 
@@ -212,9 +247,9 @@ static int sofs_unlink(const char *path)
 fprintf(stderr, "=============================================\n");
     soProbe(SOPROBE_GREEN, 11, "%s(\"%s\")\n", __FUNCTION__, path);
 
-    pthread_mutex_lock(&accessCR);
+    SOInodeLock *il = sofs_enter(path, SOFS_LOCK_NAMESPACE);
     int ret = soUnlink(path);
-    pthread_mutex_unlock(&accessCR);
+    sofs_leave(il);
     return ret;
 }
 
@@ -234,9 +269,9 @@ static int sofs_rmdir(const char *path)
 fprintf(stderr, "=============================================\n");
     soProbe(SOPROBE_GREEN, 11, "%s(\"%s\")\n", __FUNCTION__, path);
 
-    pthread_mutex_lock(&accessCR);
+    SOInodeLock *il = sofs_enter(path, SOFS_LOCK_NAMESPACE);
     int ret = soRmdir(path);
-    pthread_mutex_unlock(&accessCR);
+    sofs_leave(il);
     return ret;
 }
 
@@ -249,17 +284,21 @@ fprintf(stderr, "=============================================\n");
  *
  *  \param path path to an existing file
  *  \param newPath new path to the same file in replacement of the old one
+ *  \param flags flags of renameat2 (man 2 renameat2), none being supported
  *
  *  \return 0, on success, and a negative value, on error
  */
-static int sofs_rename(const char *path, const char *newPath)
+static int sofs_rename(const char *path, const char *newPath, unsigned int flags)
 {
 fprintf(stderr, "=============================================\n");
-    soProbe(SOPROBE_GREEN, 11, "%s(\"%s\", \"%s\")\n", __FUNCTION__, path, newPath);
+    soProbe(SOPROBE_GREEN, 11, "%s(\"%s\", \"%s\", %x)\n", __FUNCTION__, path, newPath, flags);
 
-    pthread_mutex_lock(&accessCR);
+    if (flags != 0)
+        return -EINVAL;
+
+    SOInodeLock *il = sofs_enter(path, SOFS_LOCK_NAMESPACE);
     int ret = soRename(path, newPath);
-    pthread_mutex_unlock(&accessCR);
+    sofs_leave(il);
     return ret;
 }
 
@@ -279,9 +318,9 @@ static int sofs_link(const char *path, const char *newPath)
 fprintf(stderr, "=============================================\n");
     soProbe(SOPROBE_GREEN, 11, "%s(\"%s\", \"%s\")\n", __FUNCTION__, path, newPath);
 
-    pthread_mutex_lock(&accessCR);
+    SOInodeLock *il = sofs_enter(path, SOFS_LOCK_NAMESPACE);
     int ret = soLink(path, newPath);
-    pthread_mutex_unlock(&accessCR);
+    sofs_leave(il);
     return ret;
 }
 
@@ -293,17 +332,18 @@ fprintf(stderr, "=============================================\n");
  *
  *  \param path path to the file
  *  \param mode permissions to be set
+ *  \param fi pointer to fuse file information, if the file is open
  *
  *  \return 0, on success, and a negative value, on error
  */
-static int sofs_chmod(const char *path, mode_t mode)
+static int sofs_chmod(const char *path, mode_t mode, struct fuse_file_info *fi)
 {
 fprintf(stderr, "=============================================\n");
     soProbe(SOPROBE_GREEN, 11, "%s(\"%s\", 0%o)\n", __FUNCTION__, path, (uint32_t) mode);
 
-    pthread_mutex_lock(&accessCR);
+    SOInodeLock *il = sofs_enter(path, SOFS_LOCK_WRITE);
     int ret = soChmod(path, mode);
-    pthread_mutex_unlock(&accessCR);
+    sofs_leave(il);
     return ret;
 }
 
@@ -316,18 +356,19 @@ fprintf(stderr, "=============================================\n");
  *  \param path path to the file
  *  \param owner file user id (-1, if user is not to be changed)
  *  \param group file group id (-1, if group is not to be changed)
+ *  \param fi pointer to fuse file information, if the file is open
  *
  *  \return 0, on success, and a negative value, on error
  */
-static int sofs_chown(const char *path, uid_t owner, gid_t group)
+static int sofs_chown(const char *path, uid_t owner, gid_t group, struct fuse_file_info *fi)
 {
 fprintf(stderr, "=============================================\n");
     soProbe(SOPROBE_GREEN, 11, "%s(\"%s\", %" PRIu32 ", %" PRIu32 ")\n", __FUNCTION__, 
                 path, (uint32_t) owner, (uint32_t) group);
 
-    pthread_mutex_lock(&accessCR);
+    SOInodeLock *il = sofs_enter(path, SOFS_LOCK_WRITE);
     int ret = soChown(path, owner, group);
-    pthread_mutex_unlock(&accessCR);
+    sofs_leave(il);
     return ret;
 }
 
@@ -339,17 +380,18 @@ fprintf(stderr, "=============================================\n");
  *
  *  \param path path to the file
  *  \param length new size for the regular size
+ *  \param fi pointer to fuse file information, if the file is open
  *
  *  \return 0, on success, and a negative value, on error
  */
-static int sofs_truncate(const char *path, off_t length)
+static int sofs_truncate(const char *path, off_t length, struct fuse_file_info *fi)
 {
 fprintf(stderr, "=============================================\n");
     soProbe(SOPROBE_GREEN, 11, "%s(\"%s\", %u)\n", __FUNCTION__, path, (uint32_t) length);
 
-    pthread_mutex_lock(&accessCR);
+    SOInodeLock *il = sofs_enter(path, SOFS_LOCK_WRITE);
     int ret = soTruncate(path, length);
-    pthread_mutex_unlock(&accessCR);
+    sofs_leave(il);
     return ret;
 }
 
@@ -357,24 +399,35 @@ fprintf(stderr, "=============================================\n");
 
 /* \brief Change the access and/or modification times of a file.
  *
- *  Similar to system call utime (man 2 utime).
+ *  Similar to system call utimensat (man 2 utimensat).
  *
- *  Change the access and modification times of a file with nanosecond resolution.
+ *  Times are kept in seconds, so the nanoseconds given are dropped.
  *
  *  \param path path to the file
- *  \param times pointer to a structure where the last access and modification times are passed,
- *      if \c NULL, the last access and modification times are set to the current time
+ *  \param tv the last access and modification times,
+ *      each of which may be UTIME_NOW, for the current time, or UTIME_OMIT, to keep it
+ *  \param fi pointer to fuse file information, if the file is open
  *
  *  \return 0, on success, and a negative value, on error
  */
-static int sofs_utime(const char *path, struct utimbuf *times)
+static int sofs_utimens(const char *path, const struct timespec tv[2], struct fuse_file_info *fi)
 {
 fprintf(stderr, "=============================================\n");
-    soProbe(SOPROBE_GREEN, 11, "%s(\"%s\", %p)\n", __FUNCTION__, path, times);
+    soProbe(SOPROBE_GREEN, 11, "%s(\"%s\", %p, %p)\n", __FUNCTION__, path, tv, fi);
 
-    pthread_mutex_lock(&accessCR);
-    int ret = soUtime(path, times);
-    pthread_mutex_unlock(&accessCR);
+    SOInodeLock *il = sofs_enter(path, SOFS_LOCK_WRITE);
+    struct stat st;
+    int ret = soStat(path, &st);
+    if (ret == 0)
+    {
+        struct utimbuf times;
+        times.actime = (tv[0].tv_nsec == UTIME_NOW) ? time(NULL) :
+            (tv[0].tv_nsec == UTIME_OMIT) ? st.st_atime : tv[0].tv_sec;
+        times.modtime = (tv[1].tv_nsec == UTIME_NOW) ? time(NULL) :
+            (tv[1].tv_nsec == UTIME_OMIT) ? st.st_mtime : tv[1].tv_sec;
+        ret = soUtime(path, &times);
+    }
+    sofs_leave(il);
     return ret;
 }
 
@@ -397,9 +450,9 @@ static int sofs_statfs(const char *path, struct statvfs *st)
 fprintf(stderr, "=============================================\n");
     soProbe(SOPROBE_GREEN, 11, "%s(\"%s\", %p)\n", __FUNCTION__, path, st);
 
-    pthread_mutex_lock(&accessCR);
+    SOInodeLock *il = sofs_enter(path, SOFS_LOCK_READ);
     int ret = soStatFS(path, st);
-    pthread_mutex_unlock(&accessCR);
+    sofs_leave(il);
     return ret;
 }
 
@@ -428,10 +481,10 @@ static int sofs_open(const char *path, struct fuse_file_info *fi)
 fprintf(stderr, "=============================================\n");
     soProbe(SOPROBE_GREEN, 11, "%s(\"%s\", %p)\n", __FUNCTION__, path, fi);
 
-    pthread_mutex_lock(&accessCR);
+    SOInodeLock *il = sofs_enter(path, SOFS_LOCK_READ);
     int ret = soOpen(path, fi->flags);
     fi->fh = (uint64_t) 0;
-    pthread_mutex_unlock(&accessCR);
+    sofs_leave(il);
     return ret;
 }
 
@@ -464,9 +517,11 @@ fprintf(stderr, "=============================================\n");
     soProbe(SOPROBE_GREEN, 11, "%s(\"%s\", %p, %" PRIu32 ", %" PRId32 ", %p)\n", __FUNCTION__, path,
                  buff, (uint32_t) count, (int32_t) pos, fi);
 
-    pthread_mutex_lock(&accessCR);
-    int n = soRead(path, buff, (uint32_t) count, (int32_t) pos);
-    pthread_mutex_unlock(&accessCR);
+    /* access was checked on open */
+    SOInodeLock *il = sofs_enter(path, SOFS_LOCK_READ);
+    int n = (il != NULL) ? soReadInode(sofs_locked_inode(il), buff, (uint32_t) count, (int32_t) pos)
+        : soRead(path, buff, (uint32_t) count, (int32_t) pos);
+    sofs_leave(il);
     return n;
 }
 
@@ -498,9 +553,10 @@ fprintf(stderr, "=============================================\n");
     soProbe(SOPROBE_GREEN, 11, "%s(\"%s\", %p, %" PRIu32 ", %" PRId32 ", %p)\n", __FUNCTION__, path,
                  buff, (uint32_t) count, (int32_t) pos, fi);
 
-    pthread_mutex_lock(&accessCR);
-    int n = soWrite(path, (void *)buff, (uint32_t) count, (int32_t) pos);
-    pthread_mutex_unlock(&accessCR);
+    SOInodeLock *il = sofs_enter(path, SOFS_LOCK_WRITE);
+    int n = (il != NULL) ? soWriteInode(sofs_locked_inode(il), (void *)buff, (uint32_t) count, (int32_t) pos)
+        : soWrite(path, (void *)buff, (uint32_t) count, (int32_t) pos);
+    sofs_leave(il);
     return n;
 }
 
@@ -541,8 +597,6 @@ static int sofs_flush(const char *path, struct fuse_file_info *fi)
 fprintf(stderr, "=============================================\n");
     soProbe(SOPROBE_GREEN, 11, "%s(\"%s\", %p)\n", __FUNCTION__, path, fi);
 
-    //pthread_mutex_lock(&accessCR);
-    //pthread_mutex_unlock(&accessCR);
     return 0;
 }
 
@@ -573,9 +627,9 @@ static int sofs_release(const char *path, struct fuse_file_info *fi)
 fprintf(stderr, "=============================================\n");
     soProbe(SOPROBE_GREEN, 11, "%s(\"%s\", %p)\n", __FUNCTION__, path, fi);
 
-    pthread_mutex_lock(&accessCR);
+    SOInodeLock *il = sofs_enter(path, SOFS_LOCK_READ);
     int ret = soClose(path);
-    pthread_mutex_unlock(&accessCR);
+    sofs_leave(il);
     return ret;
 }
 
@@ -602,9 +656,10 @@ static int sofs_fsync(const char *path, int isdatasync, struct fuse_file_info *f
 fprintf(stderr, "=============================================\n");
     soProbe(SOPROBE_GREEN, 11, "%s(\"%s\", %d, %p)\n", __FUNCTION__, path, isdatasync, fi);
 
-    pthread_mutex_lock(&accessCR);
+    /* a sync writes back the delayed blocks of all files */
+    SOInodeLock *il = sofs_enter(path, SOFS_LOCK_NAMESPACE);
     int ret = soFsync(path);
-    pthread_mutex_unlock(&accessCR);
+    sofs_leave(il);
     return ret;
 }
 
@@ -629,15 +684,31 @@ static int sofs_opendir(const char *path, struct fuse_file_info *fi)
 fprintf(stderr, "=============================================\n");
     soProbe(SOPROBE_GREEN, 11, "%s(\"%s\", %p)\n", __FUNCTION__, path, fi);
 
-    pthread_mutex_lock(&accessCR);
+    SOInodeLock *il = sofs_enter(path, SOFS_LOCK_READ);
     int ret = soOpendir(path);
     fi->fh = (uint64_t) 0;
-    pthread_mutex_unlock(&accessCR);
+    sofs_leave(il);
     return ret;
 }
 
 /* ***************************************************** */
 
+/* the filler of a readdir call */
+struct SOReaddirFill
+{
+    void *buf;
+    fuse_fill_dir_t filler;
+};
+
+/* pass an entry to the filler of a readdir call */
+static int sofs_readdir_fill(void *ctx, const char *name, uint32_t in, int32_t next)
+{
+    SOReaddirFill *rf = (SOReaddirFill *)ctx;
+    return rf->filler(rf->buf, name, NULL, next, (enum fuse_fill_dir_flags) 0);
+}
+
+/* ***************************************************** */
+
 /*
  *  \brief Read directory.
  *
@@ -664,27 +735,33 @@ fprintf(stderr, "=============================================\n");
  *  \param filler pointer to the filler function
  *  \param offset starting [byte] position in the file data continuum where data is to be read from
  *  \param fi pointer to fuse file information
+ *  \param flags readdir flags (attributes are not given, so FUSE_READDIR_PLUS is ignored)
  *
  *  \return 0, on success, and a negative value, on error
  */
 static int sofs_readdir(const char *path, void *buf, fuse_fill_dir_t filler, off_t offset,
-                        struct fuse_file_info *fi)
+                        struct fuse_file_info *fi, enum fuse_readdir_flags flags)
 {
 fprintf(stderr, "=============================================\n");
-    soProbe(SOPROBE_GREEN, 11, "%s(\"%s\", %p, %p, %" PRId32 ", %p)\n", __FUNCTION__,
-                path, buf, filler, (int32_t) offset, fi);
+    soProbe(SOPROBE_GREEN, 11, "%s(\"%s\", %p, %p, %" PRId32 ", %p, %x)\n", __FUNCTION__,
+                path, buf, filler, (int32_t) offset, fi, (uint32_t) flags);
 
-    pthread_mutex_lock(&accessCR);
+    SOInodeLock *il = sofs_enter(path, SOFS_LOCK_READ);
 
-    char name[SOFS18_MAX_NAME + 1];
-    int stat = soReaddir(path, name, (int32_t) offset);
-    if (stat > 0)
+    /* entries are given until the buffer is full (mode 2); the path is left to report errors */
+    int stat;
+    if (il != NULL)
     {
-        offset += stat;
-        stat = filler(buf, name, NULL, offset);
+        SOReaddirFill rf = { buf, filler };
+        stat = soReaddirInode(sofs_locked_inode(il), (int32_t) offset, sofs_readdir_fill, &rf);
+    }
+    else
+    {
+        char name[SOFS18_MAX_NAME + 1];
+        stat = soReaddir(path, name, (int32_t) offset);
     }
 
-    pthread_mutex_unlock(&accessCR);
+    sofs_leave(il);
     return stat;
 }
 
@@ -707,9 +784,9 @@ static int sofs_releasedir(const char *path, struct fuse_file_info *fi)
 fprintf(stderr, "=============================================\n");
     soProbe(SOPROBE_GREEN, 11, "%s(\"%s\", %p)\n", __FUNCTION__, path, fi);
 
-    pthread_mutex_lock(&accessCR);
+    SOInodeLock *il = sofs_enter(path, SOFS_LOCK_READ);
     int ret = soClosedir(path);
-    pthread_mutex_unlock(&accessCR);
+    sofs_leave(il);
     return ret;
 }
 
@@ -734,9 +811,10 @@ static int sofs_fsyncdir(const char *path, int isdatasync, struct fuse_file_info
 fprintf(stderr, "=============================================\n");
     soProbe(SOPROBE_GREEN, 11, "%s(\"%s\", %d, %p)\n", __FUNCTION__, path, isdatasync, fi);
 
-    pthread_mutex_lock(&accessCR);
+    /* a sync writes back the delayed blocks of all files */
+    SOInodeLock *il = sofs_enter(path, SOFS_LOCK_NAMESPACE);
     int ret = soFsync(path);
-    pthread_mutex_unlock(&accessCR);
+    sofs_leave(il);
     return ret;
 }
 
@@ -757,9 +835,9 @@ static int sofs_symlink(const char *effPath, const char *path)
 fprintf(stderr, "=============================================\n");
     soProbe(SOPROBE_GREEN, 11, "%s(\"%s\", \"%s\")\n", __FUNCTION__, effPath, path);
 
-    pthread_mutex_lock(&accessCR);
+    SOInodeLock *il = sofs_enter(path, SOFS_LOCK_NAMESPACE);
     int ret = soSymlink(effPath, path);
-    pthread_mutex_unlock(&accessCR);
+    sofs_leave(il);
     return ret;
 }
 
@@ -787,9 +865,10 @@ fprintf(stderr, "=============================================\n");
     soProbe(SOPROBE_GREEN, 11, "%s(\"%s\", %p, %" PRIu32 ")\n", __FUNCTION__, path, buf,
                  (uint32_t) size);
 
-    pthread_mutex_lock(&accessCR);
-    /*int ret = */ soReadlink(path, buf, size);
-    pthread_mutex_unlock(&accessCR);
+    SOInodeLock *il = sofs_enter(path, SOFS_LOCK_READ);
+    /*int ret = */ (il != NULL) ? soReadlinkInode(sofs_locked_inode(il), buf, size)
+        : soReadlink(path, buf, size);
+    sofs_leave(il);
     return 0;
 }
 
@@ -870,29 +949,12 @@ fprintf(stderr, "=============================================\n");
 
 /* ***************************************************** */
 
-/*
- *  \brief Get directory contents.
- *
- *  \remarks Deprecated, use readdir() instead.
- */
-
-static int sofs_getdir(const char *path, fuse_dirh_t handle, fuse_dirfil_t filler)
-{
-fprintf(stderr, "=============================================\n");
-    soProbe(SOPROBE_GREEN, 11, "%s(\"%s\", ...)\n", __FUNCTION__, path);
-
-    return -ENOSYS;
-}
-
-/* ***************************************************** */
-
 /*
  *  Set of FUSE operations (required by the FUSE filesystem)
  */
 const struct fuse_operations sofs18_fuse_operations = {
     getattr:sofs_getattr,
     readlink:sofs_readlink,
-    getdir:sofs_getdir,           /* deprecated */
     mknod:sofs_mknod,
     mkdir:sofs_mkdir,
     unlink:sofs_unlink,
@@ -903,7 +965,6 @@ const struct fuse_operations sofs18_fuse_operations = {
     chmod:sofs_chmod,
     chown:sofs_chown,
     truncate:sofs_truncate,
-    utime:sofs_utime,             /* deprecated */
     open:sofs_open,
     read:sofs_read,
     write:sofs_write,
@@ -923,15 +984,9 @@ const struct fuse_operations sofs18_fuse_operations = {
     destroy:sofs_unmount,
     access:sofs_access,
     create:NULL,
-    ftruncate:NULL,
-    fgetattr:NULL,
     lock:NULL,
-    utimens:NULL,
+    utimens:sofs_utimens,
     bmap:NULL,
-    flag_nullpath_ok:0,
-    flag_nopath:0,
-    flag_utime_omit_ok:0,
-    flag_reserved:0,
     ioctl:NULL,
     poll:NULL
 };
@@ -948,6 +1003,17 @@ static void printUsage(char *cmd_name)
     printf("Sinopsis: %s [OPTIONS] supp-file mount-point\n"
            "  OPTIONS:\n"
            "  -d          --- set debugging mode (default: no debugging)\n"
+           "  -H          --- use the high-level (path based) FUSE interface\n"
+           "                  (default: low-level, inode based)\n"
+           "  -s          --- run a single-threaded session loop (default: multithreaded)\n"
+           "  -n num      --- set maximum number of worker threads (default: libfuse's)\n"
+           "  -C          --- give each worker thread its own /dev/fuse descriptor\n"
+           "  -W          --- enable the kernel writeback cache\n"
+           "  -S          --- move data through splice, instead of copying it\n"
+           "  -x num      --- set maximum size of read and write requests, in KiB\n"
+           "                  (default: libfuse's)\n"
+           "  -e secs     --- set validity of names given to the kernel (default: %.1f)\n"
+           "  -t secs     --- set validity of attributes given to the kernel (default: %.1f)\n"
            "  -p num-num  --- set probe ID range (default: 0-0)\n"
            "  -A num-num  --- add range of IDs to probe configuration\n"
            "  -R num-num  --- remove range of IDs from probe configuration\n"
@@ -956,7 +1022,22 @@ static void printUsage(char *cmd_name)
            "  -w          --- set bin configuration to 0-0 (default)\n"
            "  -a num-num  --- add range of IDs to bin configuration\n"
            "  -r num-num  --- remove range of IDs from bin configuration\n"
-           "  -h          --- print this help\n", cmd_name);
+           "  -c num      --- set block cache size, in blocks (default: %u)\n"
+           "  -k num      --- set maximum readahead window, in blocks,\n"
+           "                  0 disables readahead (default: %u)\n"
+           "  -m mode     --- set disk access mode: file, mmap, uring, direct,\n"
+           "                  ram or ramtmp (changes not saved) (default: file)\n"
+           "  -u secs     --- set maximum time the superblock is kept unsaved,\n"
+           "                  0 saves it on every change (default: %u)\n"
+           "  -g num      --- set number of free blocks an allocation group takes at a time,\n"
+           "                  0 disables allocation groups (default: %u)\n"
+           "  -D num      --- set maximum number of file blocks kept in memory before\n"
+           "                  being allocated, 0 disables delayed allocation (default: %u)\n"
+           "  -E          --- map the blocks of new regular files with extents\n"
+           "  -h          --- print this help\n", cmd_name, sofs_opts.entryTimeout,
+           sofs_opts.attrTimeout, RAWCACHE_DEFAULT_SIZE, READAHEAD_DEFAULT_MAX,
+           SUPERBLOCK_DEFAULT_SAVE_INTERVAL, ALLOC_GROUP_DEFAULT_CACHE,
+           FILEBLOCKS_DELAY_DEFAULT_MAX);
 }
 
 /* ***************************************************** */
@@ -964,11 +1045,15 @@ static void printUsage(char *cmd_name)
 int main(int argc, char *argv[])
 {
     bool debug_mode = false;           /* debugging mode? */
+    bool high_level = false;           /* path based FUSE interface? */
+    bool single_thread = false;        /* single-threaded session loop? */
+    bool clone_fd = false;             /* a /dev/fuse descriptor per thread? */
+    uint32_t max_threads = 0;          /* maximum number of worker threads (0: libfuse's) */
     FILE *probeStream = NULL;          /* probe stream */
 
     /* process command line options */
     int opt;
-    while ((opt = getopt(argc, argv, "P:p:A:R:bwa:r:dh")) != -1)
+    while ((opt = getopt(argc, argv, "P:p:A:R:bwa:r:c:k:m:u:g:D:EdHsn:CWSx:e:t:h")) != -1)
     {
         switch (opt)
         {
@@ -1078,11 +1163,180 @@ int main(int argc, char *argv[])
                 soBinRemoveIDs(lower, upper);
                 break;
             }
+            case 'm':   /* disk access mode */
+            {
+                if (strcmp(optarg, "file") == 0)
+                    soSetRawDiskMode(RAWDISK_FILE);
+                else if (strcmp(optarg, "mmap") == 0)
+                    soSetRawDiskMode(RAWDISK_MMAP);
+                else if (strcmp(optarg, "uring") == 0)
+                    soSetRawDiskMode(RAWDISK_URING);
+                else if (strcmp(optarg, "direct") == 0)
+                    soSetRawDiskMode(RAWDISK_DIRECT);
+                else if (strcmp(optarg, "ram") == 0)
+                    soSetRawDiskMode(RAWDISK_RAM);
+                else if (strcmp(optarg, "ramtmp") == 0)
+                {
+                    soSetRawDiskMode(RAWDISK_RAM);
+                    soSetRawRamFlags(RAWRAM_LOAD);
+                }
+                else
+                {
+                    fprintf(stderr, "%s: Bad argument to 'm' option.\n", basename(argv[0]));
+                    printUsage(basename(argv[0]));
+                    return EXIT_FAILURE;
+                }
+                break;
+            }
+            case 'c':   /* block cache size */
+            {
+                uint32_t n;
+                uint32_t cnt = 0;
+                if ( (sscanf(optarg, "%u %n", &n, &cnt) != 1) 
+                        or (cnt != strlen(optarg)) )
+                {
+                    fprintf(stderr, "%s: Bad argument to 'c' option.\n", basename(argv[0]));
+                    printUsage(basename(argv[0]));
+                    return EXIT_FAILURE;
+                }
+                soSetRawCacheSize(n);
+                break;
+            }
+            case 'k':   /* readahead window */
+            {
+                uint32_t n;
+                uint32_t cnt = 0;
+                if ( (sscanf(optarg, "%u %n", &n, &cnt) != 1) 
+                        or (cnt != strlen(optarg)) )
+                {
+                    fprintf(stderr, "%s: Bad argument to 'k' option.\n", basename(argv[0]));
+                    printUsage(basename(argv[0]));
+                    return EXIT_FAILURE;
+                }
+                soSetReadAheadMax(n);
+                break;
+            }
+            case 'g':   /* allocation group refill size */
+            {
+                uint32_t n;
+                uint32_t cnt = 0;
+                if ( (sscanf(optarg, "%u %n", &n, &cnt) != 1) 
+                        or (cnt != strlen(optarg)) )
+                {
+                    fprintf(stderr, "%s: Bad argument to 'g' option.\n", basename(argv[0]));
+                    printUsage(basename(argv[0]));
+                    return EXIT_FAILURE;
+                }
+                soSetAllocGroupCache(n);
+                break;
+            }
+            case 'D':   /* delayed allocation */
+            {
+                uint32_t n;
+                uint32_t cnt = 0;
+                if ( (sscanf(optarg, "%u %n", &n, &cnt) != 1) 
+                        or (cnt != strlen(optarg)) )
+                {
+                    fprintf(stderr, "%s: Bad argument to 'D' option.\n", basename(argv[0]));
+                    printUsage(basename(argv[0]));
+                    return EXIT_FAILURE;
+                }
+                soSetDelayMax(n);
+                break;
+            }
+            case 'E':          /* extents */
+            {
+                soSetFileExtents(true);
+                break;
+            }
+            case 'u':   /* superblock save interval */
+            {
+                uint32_t n;
+                uint32_t cnt = 0;
+                if ( (sscanf(optarg, "%u %n", &n, &cnt) != 1) 
+                        or (cnt != strlen(optarg)) )
+                {
+                    fprintf(stderr, "%s: Bad argument to 'u' option.\n", basename(argv[0]));
+                    printUsage(basename(argv[0]));
+                    return EXIT_FAILURE;
+                }
+                soSBSetSaveInterval(n);
+                break;
+            }
             case 'd':          /* debugging mode */
             {
                 debug_mode = true;
                 break;
             }
+            case 'H':          /* high-level interface */
+            {
+                high_level = true;
+                break;
+            }
+            case 's':          /* single-threaded loop */
+            {
+                single_thread = true;
+                break;
+            }
+            case 'n':   /* maximum number of worker threads */
+            {
+                uint32_t cnt = 0;
+                if ( (sscanf(optarg, "%u %n", &max_threads, &cnt) != 1) 
+                        or (cnt != strlen(optarg)) or (max_threads == 0) )
+                {
+                    fprintf(stderr, "%s: Bad argument to 'n' option.\n", basename(argv[0]));
+                    printUsage(basename(argv[0]));
+                    return EXIT_FAILURE;
+                }
+                break;
+            }
+            case 'C':          /* a /dev/fuse descriptor per thread */
+            {
+                clone_fd = true;
+                break;
+            }
+            case 'W':          /* kernel writeback cache */
+            {
+                sofs_opts.writeback = true;
+                break;
+            }
+            case 'S':          /* splice */
+            {
+                sofs_opts.splice = true;
+                break;
+            }
+            case 'x':   /* maximum size of read and write requests */
+            {
+                uint32_t n;
+                uint32_t cnt = 0;
+                if ( (sscanf(optarg, "%u %n", &n, &cnt) != 1) 
+                        or (cnt != strlen(optarg)) or (n == 0) or (n > 4096) )
+                {
+                    fprintf(stderr, "%s: Bad argument to 'x' option.\n", basename(argv[0]));
+                    printUsage(basename(argv[0]));
+                    return EXIT_FAILURE;
+                }
+                sofs_opts.maxio = n * 1024;
+                break;
+            }
+            case 'e':   /* validity of names */
+            case 't':   /* validity of attributes */
+            {
+                double secs;
+                uint32_t cnt = 0;
+                if ( (sscanf(optarg, "%lf %n", &secs, &cnt) != 1) 
+                        or (cnt != strlen(optarg)) or (secs < 0) )
+                {
+                    fprintf(stderr, "%s: Bad argument to '%c' option.\n", basename(argv[0]), opt);
+                    printUsage(basename(argv[0]));
+                    return EXIT_FAILURE;
+                }
+                if (opt == 'e')
+                    sofs_opts.entryTimeout = secs;
+                else
+                    sofs_opts.attrTimeout = secs;
+                break;
+            }
             case 'h':          /* help mode */
             {
                 printUsage(basename(argv[0]));
@@ -1113,19 +1367,31 @@ int main(int argc, char *argv[])
         return EXIT_FAILURE;
     }
 
-    /* build argv and argc for fuse_main */
+    /* build argv and argc for libfuse, which also runs the session loop as asked */
     char s1[] = "-d";
     char s2[] = "-o";
-    char s3[] = "nonempty";
-    char s4[] = "fsname=sofs18";
-    char s5[] = "subtype=ext-like";
-    char *fargv[] = {
-        argv[0],
-        argv[optind + 1],
-        s2, s3, s2, s4, s2, s5, s1,
-        NULL
-    };
-    int fargc = debug_mode ? 9 : 8;
+    char s3[] = "-s";
+    char s4[128];
+    int n = snprintf(s4, sizeof(s4), "fsname=sofs18,subtype=ext-like");
+    if (clone_fd)
+        n += snprintf(s4 + n, sizeof(s4) - n, ",clone_fd");
+    if (max_threads != 0)
+        n += snprintf(s4 + n, sizeof(s4) - n, ",max_threads=%u", max_threads);
+    if (sofs_opts.maxio != 0)
+        n += snprintf(s4 + n, sizeof(s4) - n, ",max_read=%u", sofs_opts.maxio);
+    char *fargv[7];
+    int fargc = 0;
+    fargv[fargc++] = argv[0];
+    fargv[fargc++] = argv[optind + 1];
+    fargv[fargc++] = s2;
+    fargv[fargc++] = s4;
+    if (debug_mode)
+        fargv[fargc++] = s1;
+    if (single_thread)
+        fargv[fargc++] = s3;
+    fargv[fargc] = NULL;
+    if (not high_level)
+        return sofs_ll_main(fargc, fargv);
     return fuse_main(fargc, fargv, &sofs18_fuse_operations, NULL);
 }
 
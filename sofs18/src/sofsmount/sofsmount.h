@@ -0,0 +1,131 @@
+/*
+ *  \brief Declarations shared by the parts of the sofs18 mounting program
+ */
+
+#ifndef __SOFS18_SOFSMOUNT__
+#define __SOFS18_SOFSMOUNT__
+
+#include <inttypes.h>
+
+/* ***************************************************** */
+
+/* SOFS18 support filename (should be the absolute path) */
+extern char *sofs_supp_file;
+
+/* ***************************************************** */
+
+/*
+ *  Tuning of the FUSE connection, given by the command line options;
+ *  the session loop is tuned through the options passed to libfuse itself
+ */
+struct SOMountOptions
+{
+    bool writeback;         /* let the kernel cache writes */
+    bool splice;            /* move data through pipes, instead of copying it */
+    uint32_t maxio;         /* maximum size of read and write requests, in bytes (0: libfuse default) */
+    double entryTimeout;    /* validity, in seconds, of the names given to the kernel */
+    double attrTimeout;     /* validity, in seconds, of the attributes given to the kernel */
+};
+
+extern SOMountOptions sofs_opts;
+
+struct fuse_conn_info;
+
+/*
+ *  \brief Ask the kernel for the connection capabilities chosen in sofs_opts.
+ *
+ *  Those it does not support are left off.
+ *
+ *  \param conn the connection, as given to the init operation
+ */
+void sofs_conn_setup(struct fuse_conn_info *conn);
+
+/* ***************************************************** */
+
+/*
+ *  Access by concurrent threads
+ *
+ *  The namespace lock is taken exclusively by the operations that change
+ *  directories, and shared by all the others, which also lock the inode
+ *  they work on: shared, if they only read it, exclusively, otherwise.
+ *  So, operations on different files, or reading the same file, run in parallel.
+ *  Syncs also take the namespace lock exclusively, as they write back the
+ *  delayed blocks of every file, and so does the flusher, while at work.
+ *  The lower layers have their own internal locks, always taken after these.
+ */
+
+/* ways of locking */
+#define SOFS_LOCK_READ 0        /* namespace shared, inode shared */
+#define SOFS_LOCK_WRITE 1       /* namespace shared, inode exclusive */
+#define SOFS_LOCK_NAMESPACE 2   /* namespace exclusive */
+
+/* the lock of an inode, kept while some thread is using it */
+struct SOInodeLock;
+
+/*
+ *  \brief Lock a path, as given by mode.
+ *
+ *  If the path can not be resolved, only the namespace is locked,
+ *  the operation itself being left to report the error.
+ *
+ *  \param path path to the file (ignored for SOFS_LOCK_NAMESPACE)
+ *  \param mode SOFS_LOCK_READ, SOFS_LOCK_WRITE or SOFS_LOCK_NAMESPACE
+ *
+ *  \return the inode lock taken, or NULL if none
+ */
+SOInodeLock *sofs_enter(const char *path, int mode);
+
+/*
+ *  \brief Lock an inode, as given by mode.
+ *
+ *  \param in number of the inode (ignored for SOFS_LOCK_NAMESPACE)
+ *  \param mode SOFS_LOCK_READ, SOFS_LOCK_WRITE or SOFS_LOCK_NAMESPACE
+ *
+ *  \return the inode lock taken, or NULL if none
+ */
+SOInodeLock *sofs_enter_inode(uint32_t in, int mode);
+
+/*
+ *  \brief Get the number of the inode locked.
+ *
+ *  \param il an inode lock returned by sofs_enter or sofs_enter_inode
+ *
+ *  \return the inode number
+ */
+uint32_t sofs_locked_inode(const SOInodeLock *il);
+
+/*
+ *  \brief Unlock what was locked by sofs_enter or sofs_enter_inode.
+ *
+ *  \param il the inode lock returned by them
+ */
+void sofs_leave(SOInodeLock *il);
+
+/*
+ *  \brief Start the thread that periodically flushes the delayed blocks
+ *  of files not written for a while (see soFlushAllOldDelayedBlocks),
+ *  the inodes (see soITFlushOldInodes) and the superblock (see soSBFlushOld)
+ *  once dirty for too long.
+ */
+void sofs_start_flusher();
+
+/*
+ *  \brief Stop the flusher, waiting for it to finish; it must be called before unmounting.
+ */
+void sofs_stop_flusher();
+
+/* ***************************************************** */
+
+/*
+ *  \brief Run the file system through the FUSE low-level (inode based) interface.
+ *
+ *  \param argc number of FUSE arguments
+ *  \param argv FUSE arguments, the mount point included
+ *
+ *  \return EXIT_SUCCESS or EXIT_FAILURE
+ */
+int sofs_ll_main(int argc, char *argv[]);
+
+/* ***************************************************** */
+
+#endif /* __SOFS18_SOFSMOUNT__ */
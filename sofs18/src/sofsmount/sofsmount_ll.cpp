@@ -0,0 +1,997 @@
+/*
+ *  \brief The low-level (inode based) FUSE interface of the sofs18 mounting program
+ *
+ *  The kernel identifies files by the inode numbers given to it by lookup,
+ *  so data operations reach the file directly, without resolving any path.
+ *  An open file keeps its inode open, in the file handle, until it is released.
+ *  Large reads and writes are mapped onto ranges of the support file, so libfuse
+ *  moves the data between the support file and the kernel, spliced if allowed.
+ *  Inode number 0 being valid in sofs18, FUSE inode numbers are sofs18 inode numbers plus 1.
+ *
+ *  Operations that change the namespace or the attributes of a file still run
+ *  through the path based system calls; the path is rebuilt from the names
+ *  the kernel has looked up, which are kept, with their lookup count, in a node table.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <utime.h>
+#include <limits.h>
+#include <pthread.h>
+#include <fuse3/fuse_lowlevel.h>
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "core.h"
+#include "dal.h"
+#include "syscalls.h"
+
+#include "sofsmount.h"
+
+using namespace sofs18;
+
+/* ***************************************************** */
+
+/* reads and writes of at least this many bytes are mapped onto the support file */
+#define SOFS_LL_MAP_MIN 4096
+
+/* FUSE and sofs18 inode numbers */
+static inline uint32_t sofs_ll_in(fuse_ino_t ino)
+{
+    return (uint32_t)(ino - 1);
+}
+
+static inline fuse_ino_t sofs_ll_ino(uint32_t in)
+{
+    return (fuse_ino_t)in + 1;
+}
+
+/* the open file kept in the FUSE file information, if any */
+static inline SOOpenFile *sofs_ll_file(struct fuse_file_info *fi)
+{
+    return (fi != NULL) ? (SOOpenFile *)(uintptr_t) fi->fh : NULL;
+}
+
+/* ***************************************************** */
+
+/* a name of a node, within a directory */
+struct SOName
+{
+    fuse_ino_t parent;      /* inode of the directory */
+    std::string name;       /* name within it */
+};
+
+/* a node known by the kernel */
+struct SONode
+{
+    std::vector<SOName> names;  /* names it was looked up by, as a file may have several links */
+    uint64_t nlookup;           /* number of lookups not yet forgotten */
+};
+
+static std::unordered_map<fuse_ino_t, SONode> nodes;
+static pthread_mutex_t nodesCR = PTHREAD_MUTEX_INITIALIZER;     /* access to nodes */
+
+/* ***************************************************** */
+
+/* count a lookup of ino, as name within parent */
+static void sofs_ll_remember(fuse_ino_t ino, fuse_ino_t parent, const char *name)
+{
+    pthread_mutex_lock(&nodesCR);
+    SONode & node = nodes[ino];
+    std::vector<SOName>::iterator it = node.names.begin();
+    while (it != node.names.end() and (it->parent != parent or it->name != name))
+        it++;
+    if (it == node.names.end())
+    {
+        SOName n = { parent, name };
+        node.names.push_back(n);
+    }
+    node.nlookup++;
+    pthread_mutex_unlock(&nodesCR);
+}
+
+/* ***************************************************** */
+
+/* 
+ * drop name within parent from the names of ino, which was unlinked or overwritten;
+ * if newparent is not 0, the name is replaced by newname within newparent 
+ */
+static void sofs_ll_rename_node(fuse_ino_t ino, fuse_ino_t parent, const char *name,
+        fuse_ino_t newparent, const char *newname)
+{
+    pthread_mutex_lock(&nodesCR);
+    std::unordered_map<fuse_ino_t, SONode>::iterator it = nodes.find(ino);
+    if (it != nodes.end())
+    {
+        std::vector<SOName> & names = it->second.names;
+        for (size_t i = 0; i < names.size(); i++)
+        {
+            if (names[i].parent != parent or names[i].name != name)
+                continue;
+            names.erase(names.begin() + i);
+            break;
+        }
+
+        /* the new name is the most recent one */
+        if (newparent != 0)
+        {
+            SOName n = { newparent, newname };
+            names.push_back(n);
+        }
+    }
+    pthread_mutex_unlock(&nodesCR);
+}
+
+/* ***************************************************** */
+
+/*
+ * build in path the path of ino, or of name within ino, if name is not NULL,
+ * through the most recent name of each node, as the others may be gone;
+ * return 0, -ESTALE, if the kernel refers to a node it has forgotten,
+ * or -ENOENT, if a node has no name left
+ */
+static int sofs_ll_path(fuse_ino_t ino, const char *name, std::string & path)
+{
+    path = (name != NULL) ? name : "";
+    pthread_mutex_lock(&nodesCR);
+    while (ino != FUSE_ROOT_ID)
+    {
+        std::unordered_map<fuse_ino_t, SONode>::iterator it = nodes.find(ino);
+        if (it == nodes.end() or it->second.names.empty())
+        {
+            pthread_mutex_unlock(&nodesCR);
+            return (it == nodes.end()) ? -ESTALE : -ENOENT;
+        }
+        const SOName & n = it->second.names.back();
+        path = (path.empty()) ? n.name : n.name + "/" + path;
+        ino = n.parent;
+    }
+    pthread_mutex_unlock(&nodesCR);
+    path = "/" + path;
+    return 0;
+}
+
+/* ***************************************************** */
+
+/* fill e with name within parent, counting the lookup; return 0 or -errno */
+static int sofs_ll_entry(fuse_ino_t parent, const char *name, struct fuse_entry_param *e)
+{
+    memset(e, 0, sizeof(struct fuse_entry_param));
+    e->entry_timeout = sofs_opts.entryTimeout;
+    e->attr_timeout = sofs_opts.attrTimeout;
+
+    uint32_t cin;
+    int ret = soLookup(sofs_ll_in(parent), name, &cin);
+    if (ret == 0)
+        ret = soStatInode(cin, &e->attr);
+    if (ret != 0)
+        return ret;
+
+    e->ino = e->attr.st_ino = sofs_ll_ino(cin);
+    sofs_ll_remember(e->ino, parent, name);
+    return 0;
+}
+
+/* ***************************************************** */
+
+/* reply an entry, or an error, to a request */
+static void sofs_ll_reply_entry(fuse_req_t req, int ret, struct fuse_entry_param *e)
+{
+    if (ret == 0)
+        fuse_reply_entry(req, e);
+    else
+        fuse_reply_err(req, -ret);
+}
+
+/* ***************************************************** */
+
+/* mount the file system */
+static void sofs_ll_mount(void *userdata, struct fuse_conn_info *conn)
+{
+    soProbe(SOPROBE_GREEN, 11, "%s()\n", __FUNCTION__);
+
+    int ret = soOpenFileSystem(sofs_supp_file);
+    if (ret != 0)
+        fprintf(stderr, "sofsmount: Opening the file system - %s.\n", strerror(-ret));
+    else
+        sofs_start_flusher();
+
+    /* the root is never looked up */
+    SONode & root = nodes[FUSE_ROOT_ID];
+    root.nlookup = 1;
+
+    sofs_conn_setup(conn);
+}
+
+/* ***************************************************** */
+
+/* unmount the file system */
+static void sofs_ll_unmount(void *userdata)
+{
+    soProbe(SOPROBE_GREEN, 11, "%s()\n", __FUNCTION__);
+
+    sofs_stop_flusher();
+    SOInodeLock *il = sofs_enter_inode(0, SOFS_LOCK_NAMESPACE);
+    soCloseFileSystem();
+    sofs_leave(il);
+}
+
+/* ***************************************************** */
+
+/* look up a name within a directory */
+static void sofs_ll_lookup(fuse_req_t req, fuse_ino_t parent, const char *name)
+{
+    soProbe(SOPROBE_GREEN, 11, "%s(%lu, \"%s\")\n", __FUNCTION__, parent, name);
+
+    SOInodeLock *il = sofs_enter_inode(sofs_ll_in(parent), SOFS_LOCK_READ);
+    struct fuse_entry_param e;
+    int ret = sofs_ll_entry(parent, name, &e);
+    sofs_leave(il);
+
+    /* a missing name is also worth caching */
+    if (ret == -ENOENT)
+    {
+        e.ino = 0;
+        ret = 0;
+    }
+    sofs_ll_reply_entry(req, ret, &e);
+}
+
+/* ***************************************************** */
+
+/* forget nlookup lookups of an inode */
+static void sofs_ll_forget(fuse_req_t req, fuse_ino_t ino, uint64_t nlookup)
+{
+    soProbe(SOPROBE_GREEN, 11, "%s(%lu, %" PRIu64 ")\n", __FUNCTION__, ino, nlookup);
+
+    pthread_mutex_lock(&nodesCR);
+    std::unordered_map<fuse_ino_t, SONode>::iterator it = nodes.find(ino);
+    if (it != nodes.end() and ino != FUSE_ROOT_ID)
+    {
+        if (it->second.nlookup <= nlookup)
+            nodes.erase(it);
+        else
+            it->second.nlookup -= nlookup;
+    }
+    pthread_mutex_unlock(&nodesCR);
+    fuse_reply_none(req);
+}
+
+/* ***************************************************** */
+
+/* get file attributes */
+static void sofs_ll_getattr(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *fi)
+{
+    soProbe(SOPROBE_GREEN, 11, "%s(%lu, %p)\n", __FUNCTION__, ino, fi);
+
+    SOInodeLock *il = sofs_enter_inode(sofs_ll_in(ino), SOFS_LOCK_READ);
+    struct stat st;
+    int ret = soStatInode(sofs_ll_in(ino), &st);
+    sofs_leave(il);
+
+    if (ret != 0)
+        fuse_reply_err(req, -ret);
+    else
+    {
+        st.st_ino = ino;
+        fuse_reply_attr(req, &st, sofs_opts.attrTimeout);
+    }
+}
+
+/* ***************************************************** */
+
+/* set file attributes, through the path based system calls */
+static void sofs_ll_setattr(fuse_req_t req, fuse_ino_t ino, struct stat *attr, int to_set,
+        struct fuse_file_info *fi)
+{
+    soProbe(SOPROBE_GREEN, 11, "%s(%lu, %p, %x, %p)\n", __FUNCTION__, ino, attr, to_set, fi);
+
+    /* an open file may have no name left, which only matters to the path based calls */
+    SOInodeLock *il = sofs_enter_inode(sofs_ll_in(ino), SOFS_LOCK_WRITE);
+    std::string path;
+    struct stat st;
+    int pret = sofs_ll_path(ino, NULL, path);
+    int ret = soStatInode(sofs_ll_in(ino), &st);
+
+    /* the type of the file is kept, and so is any time not given */
+    if (ret == 0 and (to_set & FUSE_SET_ATTR_MODE))
+        ret = (pret != 0) ? pret
+            : soChmod(path.c_str(), (st.st_mode & S_IFMT) | (attr->st_mode & 07777));
+    if (ret == 0 and (to_set & (FUSE_SET_ATTR_UID | FUSE_SET_ATTR_GID)))
+        ret = (pret != 0) ? pret : soChown(path.c_str(),
+                (to_set & FUSE_SET_ATTR_UID) ? attr->st_uid : (uid_t) -1,
+                (to_set & FUSE_SET_ATTR_GID) ? attr->st_gid : (gid_t) -1);
+    if (ret == 0 and (to_set & FUSE_SET_ATTR_SIZE))
+        ret = (sofs_ll_file(fi) != NULL) ? soTruncateHandle(sofs_ll_file(fi), attr->st_size)
+            : (pret != 0) ? pret : soTruncate(path.c_str(), attr->st_size);
+    if (ret == 0 and (to_set & (FUSE_SET_ATTR_ATIME | FUSE_SET_ATTR_MTIME)))
+    {
+        struct utimbuf times;
+        times.actime = (to_set & FUSE_SET_ATTR_ATIME_NOW) ? time(NULL) :
+            (to_set & FUSE_SET_ATTR_ATIME) ? attr->st_atime : st.st_atime;
+        times.modtime = (to_set & FUSE_SET_ATTR_MTIME_NOW) ? time(NULL) :
+            (to_set & FUSE_SET_ATTR_MTIME) ? attr->st_mtime : st.st_mtime;
+        ret = (pret != 0) ? pret : soUtime(path.c_str(), &times);
+    }
+    if (ret == 0)
+        ret = soStatInode(sofs_ll_in(ino), &st);
+    sofs_leave(il);
+
+    if (ret != 0)
+        fuse_reply_err(req, -ret);
+    else
+    {
+        st.st_ino = ino;
+        fuse_reply_attr(req, &st, sofs_opts.attrTimeout);
+    }
+}
+
+/* ***************************************************** */
+
+/* read the target of a symbolic link */
+static void sofs_ll_readlink(fuse_req_t req, fuse_ino_t ino)
+{
+    soProbe(SOPROBE_GREEN, 11, "%s(%lu)\n", __FUNCTION__, ino);
+
+    SOInodeLock *il = sofs_enter_inode(sofs_ll_in(ino), SOFS_LOCK_READ);
+    char buf[PATH_MAX];
+    int ret = soReadlinkInode(sofs_ll_in(ino), buf, sizeof(buf));
+    sofs_leave(il);
+
+    if (ret != 0)
+        fuse_reply_err(req, -ret);
+    else
+        fuse_reply_readlink(req, buf);
+}
+
+/* ***************************************************** */
+
+/* create a file node */
+static void sofs_ll_mknod(fuse_req_t req, fuse_ino_t parent, const char *name, mode_t mode,
+        dev_t rdev)
+{
+    soProbe(SOPROBE_GREEN, 11, "%s(%lu, \"%s\", %x, %x)\n", __FUNCTION__, parent, name,
+            (uint32_t) mode, (uint32_t) rdev);
+
+    SOInodeLock *il = sofs_enter_inode(0, SOFS_LOCK_NAMESPACE);
+    std::string path;
+    struct fuse_entry_param e;
+    int ret = sofs_ll_path(parent, name, path);
+    if (ret == 0)
+        ret = soMknod(path.c_str(), mode);
+    if (ret == 0)
+        ret = sofs_ll_entry(parent, name, &e);
+    sofs_leave(il);
+
+    sofs_ll_reply_entry(req, ret, &e);
+}
+
+/* ***************************************************** */
+
+/* create a directory */
+static void sofs_ll_mkdir(fuse_req_t req, fuse_ino_t parent, const char *name, mode_t mode)
+{
+    soProbe(SOPROBE_GREEN, 11, "%s(%lu, \"%s\", %x)\n", __FUNCTION__, parent, name,
+            (uint32_t) mode);
+
+    SOInodeLock *il = sofs_enter_inode(0, SOFS_LOCK_NAMESPACE);
+    std::string path;
+    struct fuse_entry_param e;
+    int ret = sofs_ll_path(parent, name, path);
+    if (ret == 0)
+        ret = soMkdir(path.c_str(), mode);
+    if (ret == 0)
+        ret = sofs_ll_entry(parent, name, &e);
+    sofs_leave(il);
+
+    sofs_ll_reply_entry(req, ret, &e);
+}
+
+/* ***************************************************** */
+
+/* remove a regular file */
+static void sofs_ll_unlink(fuse_req_t req, fuse_ino_t parent, const char *name)
+{
+    soProbe(SOPROBE_GREEN, 11, "%s(%lu, \"%s\")\n", __FUNCTION__, parent, name);
+
+    SOInodeLock *il = sofs_enter_inode(0, SOFS_LOCK_NAMESPACE);
+    std::string path;
+    uint32_t cin;
+    int ret = sofs_ll_path(parent, name, path);
+    if (ret == 0)
+        ret = soLookup(sofs_ll_in(parent), name, &cin);
+    if (ret == 0)
+        ret = soUnlink(path.c_str());
+
+    /* the other links of the file, if any, are left to reach it */
+    if (ret == 0)
+        sofs_ll_rename_node(sofs_ll_ino(cin), parent, name, 0, NULL);
+    sofs_leave(il);
+
+    fuse_reply_err(req, -ret);
+}
+
+/* ***************************************************** */
+
+/* remove a directory */
+static void sofs_ll_rmdir(fuse_req_t req, fuse_ino_t parent, const char *name)
+{
+    soProbe(SOPROBE_GREEN, 11, "%s(%lu, \"%s\")\n", __FUNCTION__, parent, name);
+
+    SOInodeLock *il = sofs_enter_inode(0, SOFS_LOCK_NAMESPACE);
+    std::string path;
+    uint32_t cin;
+    int ret = sofs_ll_path(parent, name, path);
+    if (ret == 0)
+        ret = soLookup(sofs_ll_in(parent), name, &cin);
+    if (ret == 0)
+        ret = soRmdir(path.c_str());
+    if (ret == 0)
+        sofs_ll_rename_node(sofs_ll_ino(cin), parent, name, 0, NULL);
+    sofs_leave(il);
+
+    fuse_reply_err(req, -ret);
+}
+
+/* ***************************************************** */
+
+/* create a symbolic link */
+static void sofs_ll_symlink(fuse_req_t req, const char *link, fuse_ino_t parent,
+        const char *name)
+{
+    soProbe(SOPROBE_GREEN, 11, "%s(\"%s\", %lu, \"%s\")\n", __FUNCTION__, link, parent, name);
+
+    SOInodeLock *il = sofs_enter_inode(0, SOFS_LOCK_NAMESPACE);
+    std::string path;
+    struct fuse_entry_param e;
+    int ret = sofs_ll_path(parent, name, path);
+    if (ret == 0)
+        ret = soSymlink(link, path.c_str());
+    if (ret == 0)
+        ret = sofs_ll_entry(parent, name, &e);
+    sofs_leave(il);
+
+    sofs_ll_reply_entry(req, ret, &e);
+}
+
+/* ***************************************************** */
+
+/* rename a file; none of the flags of renameat2 is supported */
+static void sofs_ll_rename(fuse_req_t req, fuse_ino_t parent, const char *name,
+        fuse_ino_t newparent, const char *newname, unsigned int flags)
+{
+    soProbe(SOPROBE_GREEN, 11, "%s(%lu, \"%s\", %lu, \"%s\", %x)\n", __FUNCTION__, parent, name,
+            newparent, newname, flags);
+
+    if (flags != 0)
+    {
+        fuse_reply_err(req, EINVAL);
+        return;
+    }
+
+    SOInodeLock *il = sofs_enter_inode(0, SOFS_LOCK_NAMESPACE);
+    std::string path, newPath;
+    uint32_t cin, tin = NullReference;
+    int ret = sofs_ll_path(parent, name, path);
+    if (ret == 0)
+        ret = sofs_ll_path(newparent, newname, newPath);
+    if (ret == 0)
+        ret = soLookup(sofs_ll_in(parent), name, &cin);
+    if (ret == 0 and soLookup(sofs_ll_in(newparent), newname, &tin) != 0)
+        tin = NullReference;
+    if (ret == 0)
+        ret = soRename(path.c_str(), newPath.c_str());
+
+    /* 
+     * the overwritten file, if any, loses the new name, while the paths of the file,
+     * and of what is below it, now go through it 
+     */
+    if (ret == 0 and tin != cin)
+    {
+        if (tin != NullReference)
+            sofs_ll_rename_node(sofs_ll_ino(tin), newparent, newname, 0, NULL);
+        sofs_ll_rename_node(sofs_ll_ino(cin), parent, name, newparent, newname);
+    }
+    sofs_leave(il);
+
+    fuse_reply_err(req, -ret);
+}
+
+/* ***************************************************** */
+
+/* create a hard link to a file */
+static void sofs_ll_link(fuse_req_t req, fuse_ino_t ino, fuse_ino_t newparent,
+        const char *newname)
+{
+    soProbe(SOPROBE_GREEN, 11, "%s(%lu, %lu, \"%s\")\n", __FUNCTION__, ino, newparent, newname);
+
+    SOInodeLock *il = sofs_enter_inode(0, SOFS_LOCK_NAMESPACE);
+    std::string path, newPath;
+    struct fuse_entry_param e;
+    int ret = sofs_ll_path(ino, NULL, path);
+    if (ret == 0)
+        ret = sofs_ll_path(newparent, newname, newPath);
+    if (ret == 0)
+        ret = soLink(path.c_str(), newPath.c_str());
+    if (ret == 0)
+        ret = sofs_ll_entry(newparent, newname, &e);
+    sofs_leave(il);
+
+    sofs_ll_reply_entry(req, ret, &e);
+}
+
+/* ***************************************************** */
+
+/* open a file, keeping it open until it is released */
+static void sofs_ll_open(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *fi)
+{
+    soProbe(SOPROBE_GREEN, 11, "%s(%lu, %p)\n", __FUNCTION__, ino, fi);
+
+    SOInodeLock *il = sofs_enter_inode(sofs_ll_in(ino), SOFS_LOCK_READ);
+    SOOpenFile *of;
+    int ret = soOpenHandle(sofs_ll_in(ino), fi->flags, &of);
+    sofs_leave(il);
+
+    if (ret != 0)
+        fuse_reply_err(req, -ret);
+    else
+    {
+        fi->fh = (uint64_t)(uintptr_t) of;
+        fuse_reply_open(req, fi);
+    }
+}
+
+/* ***************************************************** */
+
+/* make in mem a vector of FUSE buffers over the given ranges, holes being read from zeros */
+static struct fuse_bufvec *sofs_ll_bufvec(std::vector<SODataRange> & ranges,
+        std::vector<char> & mem, std::vector<char> & zeros)
+{
+    /* all holes share zeros, so it is sized before being pointed at */
+    size_t hole = 0;
+    for (size_t i = 0; i < ranges.size(); i++)
+        if (ranges[i].fd == -1)
+            hole = std::max(hole, (size_t) ranges[i].size);
+    zeros.assign(hole, 0);
+
+    mem.assign(sizeof(struct fuse_bufvec) + ranges.size() * sizeof(struct fuse_buf), 0);
+    struct fuse_bufvec *bufv = (struct fuse_bufvec *) mem.data();
+    bufv->count = ranges.size();
+
+    for (size_t i = 0; i < ranges.size(); i++)
+    {
+        struct fuse_buf & b = bufv->buf[i];
+        b.size = ranges[i].size;
+        b.fd = ranges[i].fd;
+        if (ranges[i].fd == -1)
+            b.mem = zeros.data();
+        else
+        {
+            b.flags = (enum fuse_buf_flags)(FUSE_BUF_IS_FD | FUSE_BUF_FD_SEEK);
+            b.pos = ranges[i].pos;
+        }
+    }
+    return bufv;
+}
+
+/* ***************************************************** */
+
+/*
+ * read data from an open file;
+ * large reads are replied from the support file, with no copy if splice is in use
+ */
+static void sofs_ll_read(fuse_req_t req, fuse_ino_t ino, size_t size, off_t off,
+        struct fuse_file_info *fi)
+{
+    soProbe(SOPROBE_GREEN, 11, "%s(%lu, %" PRIu32 ", %" PRId32 ", %p)\n", __FUNCTION__, ino,
+            (uint32_t) size, (int32_t) off, fi);
+
+    SOOpenFile *of = sofs_ll_file(fi);
+    SOInodeLock *il = sofs_enter_inode(sofs_ll_in(ino), SOFS_LOCK_READ);
+    std::vector<SODataRange> ranges;
+    int n = -ENOTSUP;
+    if (size >= SOFS_LL_MAP_MIN)
+        n = soMapHandle(of, (uint32_t) size, (int32_t) off, false, ranges);
+    if (n > 0)
+    {
+        /* the data is taken from the support file as it is sent, so the file is kept locked */
+        std::vector<char> mem, zeros;
+        fuse_reply_data(req, sofs_ll_bufvec(ranges, mem, zeros), FUSE_BUF_SPLICE_MOVE);
+        soUnmapHandle(of, n, (int32_t) off, false);
+        sofs_leave(il);
+        return;
+    }
+
+    std::vector<char> buf;
+    if (n == -ENOTSUP)
+    {
+        buf.resize(size);
+        n = soReadHandle(of, buf.data(), (uint32_t) size, (int32_t) off);
+    }
+    sofs_leave(il);
+
+    if (n < 0)
+        fuse_reply_err(req, -n);
+    else
+        fuse_reply_buf(req, buf.data(), n);
+}
+
+/* ***************************************************** */
+
+/* write count bytes, taken from bufv, at pos of an open file, copying them through memory */
+static int sofs_ll_write_copy(SOOpenFile *of, struct fuse_bufvec *bufv, uint32_t count,
+        int32_t pos)
+{
+    if (count == 0)
+        return 0;
+
+    std::vector<char> buf(count);
+    struct fuse_bufvec dst = FUSE_BUFVEC_INIT(count);
+    dst.buf[0].mem = buf.data();
+    ssize_t n = fuse_buf_copy(&dst, bufv, (enum fuse_buf_copy_flags) 0);
+    if (n != (ssize_t) count)
+        return (n < 0) ? n : -EIO;
+
+    n = soWriteHandle(of, buf.data(), count, pos);
+    return (n < 0) ? n : 0;
+}
+
+/* write count bytes, taken from bufv, at pos of an open file, straight into the support file */
+static int sofs_ll_write_mapped(SOOpenFile *of, struct fuse_bufvec *bufv, uint32_t count,
+        int32_t pos)
+{
+    std::vector<SODataRange> ranges;
+    int ret = soMapHandle(of, count, pos, true, ranges);
+    if (ret == -ENOTSUP)
+        return sofs_ll_write_copy(of, bufv, count, pos);
+    if (ret < 0)
+        return ret;
+
+    std::vector<char> mem, zeros;
+    ssize_t n = fuse_buf_copy(sofs_ll_bufvec(ranges, mem, zeros), bufv,
+            (enum fuse_buf_copy_flags) 0);
+    if (n != (ssize_t) count)
+        return (n < 0) ? n : -EIO;
+
+    return soUnmapHandle(of, count, pos, true);
+}
+
+/*
+ * write data to an open file;
+ * the whole blocks of large writes go straight into the support file, the rest is copied
+ */
+static void sofs_ll_write_buf(fuse_req_t req, fuse_ino_t ino, struct fuse_bufvec *bufv,
+        off_t off, struct fuse_file_info *fi)
+{
+    size_t size = fuse_buf_size(bufv);
+    soProbe(SOPROBE_GREEN, 11, "%s(%lu, %p, %" PRIu32 ", %" PRId32 ", %p)\n", __FUNCTION__, ino,
+            bufv, (uint32_t) size, (int32_t) off, fi);
+
+    uint32_t head = std::min((size_t)((BlockSize - off % BlockSize) % BlockSize), size);
+    uint32_t whole = (size - head) / BlockSize * BlockSize;
+    if (whole < SOFS_LL_MAP_MIN)
+    {
+        head = size;
+        whole = 0;
+    }
+    uint32_t tail = size - head - whole;
+
+    SOOpenFile *of = sofs_ll_file(fi);
+    SOInodeLock *il = sofs_enter_inode(sofs_ll_in(ino), SOFS_LOCK_WRITE);
+    int ret = sofs_ll_write_copy(of, bufv, head, (int32_t) off);
+    if (ret == 0 and whole > 0)
+        ret = sofs_ll_write_mapped(of, bufv, whole, (int32_t) off + head);
+    if (ret == 0)
+        ret = sofs_ll_write_copy(of, bufv, tail, (int32_t) off + head + whole);
+    sofs_leave(il);
+
+    if (ret < 0)
+        fuse_reply_err(req, -ret);
+    else
+        fuse_reply_write(req, size);
+}
+
+/* ***************************************************** */
+
+/* flush and releasedir have nothing to do */
+static void sofs_ll_done(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *fi)
+{
+    soProbe(SOPROBE_GREEN, 11, "%s(%lu, %p)\n", __FUNCTION__, ino, fi);
+
+    fuse_reply_err(req, 0);
+}
+
+/* ***************************************************** */
+
+/* release an open file */
+static void sofs_ll_release(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *fi)
+{
+    soProbe(SOPROBE_GREEN, 11, "%s(%lu, %p)\n", __FUNCTION__, ino, fi);
+
+    SOInodeLock *il = sofs_enter_inode(sofs_ll_in(ino), SOFS_LOCK_WRITE);
+    int ret = soCloseHandle(sofs_ll_file(fi));
+    sofs_leave(il);
+
+    fuse_reply_err(req, -ret);
+}
+
+/* ***************************************************** */
+
+/* synchronize file or directory contents */
+static void sofs_ll_fsync(fuse_req_t req, fuse_ino_t ino, int datasync,
+        struct fuse_file_info *fi)
+{
+    soProbe(SOPROBE_GREEN, 11, "%s(%lu, %d, %p)\n", __FUNCTION__, ino, datasync, fi);
+
+    /* directories are not kept open; a sync writes back the delayed blocks of all files */
+    SOInodeLock *il = sofs_enter_inode(0, SOFS_LOCK_NAMESPACE);
+    int ret = 0;
+    if (sofs_ll_file(fi) != NULL)
+        ret = soFsyncHandle(sofs_ll_file(fi));
+    else
+    {
+        try
+        {
+            soSyncDisk();
+        }
+        catch (SOException & err)
+        {
+            ret = -err.en;
+        }
+    }
+    sofs_leave(il);
+
+    fuse_reply_err(req, -ret);
+}
+
+/* ***************************************************** */
+
+/* open a directory, checking it can be read */
+static void sofs_ll_opendir(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *fi)
+{
+    soProbe(SOPROBE_GREEN, 11, "%s(%lu, %p)\n", __FUNCTION__, ino, fi);
+
+    SOInodeLock *il = sofs_enter_inode(sofs_ll_in(ino), SOFS_LOCK_READ);
+    struct stat st;
+    int ret = soStatInode(sofs_ll_in(ino), &st);
+    if (ret == 0 and not S_ISDIR(st.st_mode))
+        ret = -ENOTDIR;
+    if (ret == 0)
+        ret = soAccessInode(sofs_ll_in(ino), R_OK);
+    sofs_leave(il);
+
+    if (ret != 0)
+        fuse_reply_err(req, -ret);
+    else
+    {
+        fi->fh = (uint64_t) 0;
+        fuse_reply_open(req, fi);
+    }
+}
+
+/* ***************************************************** */
+
+/* a reply to readdir being filled */
+struct SODirBuf
+{
+    fuse_req_t req;
+    fuse_ino_t ino;         /* the directory */
+    char *buf;
+    size_t size;            /* room in buf */
+    size_t len;             /* bytes used */
+};
+
+/* add an entry to a reply to readdir; stop when it is full */
+static int sofs_ll_dirfill(void *ctx, const char *name, uint32_t in, int32_t next)
+{
+    SODirBuf *db = (SODirBuf *)ctx;
+
+    /* only the inode number is given; the kernel gets the type when needed */
+    struct stat st;
+    memset(&st, 0, sizeof(struct stat));
+    st.st_ino = sofs_ll_ino(in);
+
+    size_t n = fuse_add_direntry(db->req, db->buf + db->len, db->size - db->len, name, &st, next);
+    if (n > db->size - db->len)
+        return 1;
+    db->len += n;
+    return 0;
+}
+
+/* ***************************************************** */
+
+/* read directory, as many entries as fit in the reply */
+static void sofs_ll_readdir(fuse_req_t req, fuse_ino_t ino, size_t size, off_t off,
+        struct fuse_file_info *fi)
+{
+    soProbe(SOPROBE_GREEN, 11, "%s(%lu, %" PRIu32 ", %" PRId32 ", %p)\n", __FUNCTION__, ino,
+            (uint32_t) size, (int32_t) off, fi);
+
+    std::vector<char> buf(size);
+    SODirBuf db = { req, ino, buf.data(), size, 0 };
+    SOInodeLock *il = sofs_enter_inode(sofs_ll_in(ino), SOFS_LOCK_READ);
+    int ret = soReaddirInode(sofs_ll_in(ino), (int32_t) off, sofs_ll_dirfill, &db);
+    sofs_leave(il);
+
+    if (ret != 0)
+        fuse_reply_err(req, -ret);
+    else
+        fuse_reply_buf(req, buf.data(), db.len);
+}
+
+/* ***************************************************** */
+
+/* add an entry, with its attributes, to a reply to readdirplus; stop when it is full */
+static int sofs_ll_dirfillplus(void *ctx, const char *name, const struct stat *st, int32_t next)
+{
+    SODirBuf *db = (SODirBuf *)ctx;
+
+    struct fuse_entry_param e;
+    memset(&e, 0, sizeof(struct fuse_entry_param));
+    e.entry_timeout = sofs_opts.entryTimeout;
+    e.attr_timeout = sofs_opts.attrTimeout;
+    e.attr = *st;
+    e.ino = e.attr.st_ino = sofs_ll_ino(st->st_ino);
+
+    size_t n = fuse_add_direntry_plus(db->req, db->buf + db->len, db->size - db->len, name, &e, next);
+    if (n > db->size - db->len)
+        return 1;
+    db->len += n;
+
+    /* the entries given, but . and .., count as looked up */
+    if (strcmp(name, ".") != 0 and strcmp(name, "..") != 0)
+        sofs_ll_remember(e.ino, db->ino, name);
+    return 0;
+}
+
+/* ***************************************************** */
+
+/*
+ * read directory, as many entries as fit in the reply, with their attributes,
+ * so the kernel needs no lookup for them
+ */
+static void sofs_ll_readdirplus(fuse_req_t req, fuse_ino_t ino, size_t size, off_t off,
+        struct fuse_file_info *fi)
+{
+    soProbe(SOPROBE_GREEN, 11, "%s(%lu, %" PRIu32 ", %" PRId32 ", %p)\n", __FUNCTION__, ino,
+            (uint32_t) size, (int32_t) off, fi);
+
+    std::vector<char> buf(size);
+    SODirBuf db = { req, ino, buf.data(), size, 0 };
+    SOInodeLock *il = sofs_enter_inode(sofs_ll_in(ino), SOFS_LOCK_READ);
+    int ret = soReaddirPlusInode(sofs_ll_in(ino), (int32_t) off, sofs_ll_dirfillplus, &db);
+    sofs_leave(il);
+
+    if (ret != 0)
+        fuse_reply_err(req, -ret);
+    else
+        fuse_reply_buf(req, buf.data(), db.len);
+}
+
+/* ***************************************************** */
+
+/* get file system statistics */
+static void sofs_ll_statfs(fuse_req_t req, fuse_ino_t ino)
+{
+    soProbe(SOPROBE_GREEN, 11, "%s(%lu)\n", __FUNCTION__, ino);
+
+    SOInodeLock *il = sofs_enter_inode(0, SOFS_LOCK_READ);
+    struct statvfs st;
+    int ret = soStatFS("/", &st);
+    sofs_leave(il);
+
+    if (ret != 0)
+        fuse_reply_err(req, -ret);
+    else
+        fuse_reply_statfs(req, &st);
+}
+
+/* ***************************************************** */
+
+/* check file access permissions */
+static void sofs_ll_access(fuse_req_t req, fuse_ino_t ino, int mask)
+{
+    soProbe(SOPROBE_GREEN, 11, "%s(%lu, %x)\n", __FUNCTION__, ino, mask);
+
+    SOInodeLock *il = sofs_enter_inode(sofs_ll_in(ino), SOFS_LOCK_READ);
+    int ret = soAccessInode(sofs_ll_in(ino), mask);
+    sofs_leave(il);
+
+    fuse_reply_err(req, -ret);
+}
+
+/* ***************************************************** */
+
+/*
+ *  Set of FUSE low-level operations;
+ *  those not given (extended attributes, create, locks) are replied with ENOSYS
+ */
+static struct fuse_lowlevel_ops sofs18_ll_operations;
+
+static void sofs_ll_set_operations(struct fuse_lowlevel_ops *ops)
+{
+    memset(ops, 0, sizeof(struct fuse_lowlevel_ops));
+    ops->init = sofs_ll_mount;
+    ops->destroy = sofs_ll_unmount;
+    ops->lookup = sofs_ll_lookup;
+    ops->forget = sofs_ll_forget;
+    ops->getattr = sofs_ll_getattr;
+    ops->setattr = sofs_ll_setattr;
+    ops->readlink = sofs_ll_readlink;
+    ops->mknod = sofs_ll_mknod;
+    ops->mkdir = sofs_ll_mkdir;
+    ops->unlink = sofs_ll_unlink;
+    ops->rmdir = sofs_ll_rmdir;
+    ops->symlink = sofs_ll_symlink;
+    ops->rename = sofs_ll_rename;
+    ops->link = sofs_ll_link;
+    ops->open = sofs_ll_open;
+    ops->read = sofs_ll_read;
+    ops->write_buf = sofs_ll_write_buf;
+    ops->flush = sofs_ll_done;
+    ops->release = sofs_ll_release;
+    ops->fsync = sofs_ll_fsync;
+    ops->opendir = sofs_ll_opendir;
+    ops->readdir = sofs_ll_readdir;
+    ops->readdirplus = sofs_ll_readdirplus;
+    ops->releasedir = sofs_ll_done;
+    ops->fsyncdir = sofs_ll_fsync;
+    ops->statfs = sofs_ll_statfs;
+    ops->access = sofs_ll_access;
+}
+
+/* ***************************************************** */
+
+int sofs_ll_main(int argc, char *argv[])
+{
+    sofs_ll_set_operations(&sofs18_ll_operations);
+
+    struct fuse_args args = FUSE_ARGS_INIT(argc, argv);
+    struct fuse_cmdline_opts opts;
+    if (fuse_parse_cmdline(&args, &opts) != 0)
+        return EXIT_FAILURE;
+
+    int err = -1;
+    struct fuse_session *se = fuse_session_new(&args, &sofs18_ll_operations,
+            sizeof(sofs18_ll_operations), NULL);
+    if (se != NULL)
+    {
+        if (fuse_set_signal_handlers(se) == 0)
+        {
+            if (fuse_session_mount(se, opts.mountpoint) == 0)
+            {
+                if (fuse_daemonize(opts.foreground) == 0)
+                {
+                    if (opts.singlethread)
+                        err = fuse_session_loop(se);
+                    else
+                    {
+                        /* as given by the clone_fd, max_threads and max_idle_threads options */
+                        struct fuse_loop_config *config = fuse_loop_cfg_create();
+                        fuse_loop_cfg_set_clone_fd(config, opts.clone_fd);
+                        fuse_loop_cfg_set_max_threads(config, opts.max_threads);
+                        fuse_loop_cfg_set_idle_threads(config, opts.max_idle_threads);
+                        err = fuse_session_loop_mt(se, config);
+                        fuse_loop_cfg_destroy(config);
+                    }
+                }
+                fuse_session_unmount(se);
+            }
+            fuse_remove_signal_handlers(se);
+        }
+        fuse_session_destroy(se);
+    }
+    free(opts.mountpoint);
+    fuse_opt_free_args(&args);
+
+    return (err == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* ***************************************************** */
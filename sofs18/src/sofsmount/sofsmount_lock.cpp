@@ -0,0 +1,216 @@
+/*
+ *  \brief Locking of the sofs18 mounting program
+ */
+
+#include <pthread.h>
+#include <time.h>
+
+#include <string>
+#include <unordered_map>
+
+#include "core.h"
+#include "dal.h"
+#include "rawdisk.h"
+#include "direntries.h"
+#include "fileblocks.h"
+
+#include "sofsmount.h"
+
+using namespace sofs18;
+
+/* ***************************************************** */
+
+static pthread_rwlock_t namespaceLock = PTHREAD_RWLOCK_INITIALIZER;
+
+/* the lock of an inode, kept while some thread is using it */
+struct SOInodeLock
+{
+    uint32_t in;            /* inode number */
+    uint32_t users;         /* number of threads holding or waiting for the lock */
+    pthread_rwlock_t rw;
+};
+
+static std::unordered_map<uint32_t, SOInodeLock *> inodeLocks;
+static pthread_mutex_t inodeLocksCR = PTHREAD_MUTEX_INITIALIZER;    /* access to inodeLocks */
+
+/* the flusher of delayed blocks, inodes and superblock, and how it is told to stop */
+static pthread_t flusher;
+static bool flusherRunning = false;
+static bool flusherStop = false;
+static pthread_mutex_t flusherCR = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t flusherWake = PTHREAD_COND_INITIALIZER;
+
+/* ***************************************************** */
+
+/* lock inode in, with the namespace already locked shared */
+static SOInodeLock *sofs_lock_inode(uint32_t in, int mode)
+{
+    pthread_mutex_lock(&inodeLocksCR);
+    SOInodeLock *il;
+    std::unordered_map<uint32_t, SOInodeLock *>::iterator it = inodeLocks.find(in);
+    if (it != inodeLocks.end())
+        il = it->second;
+    else
+    {
+        il = new SOInodeLock;
+        il->in = in;
+        il->users = 0;
+        pthread_rwlock_init(&il->rw, NULL);
+        inodeLocks[in] = il;
+    }
+    il->users++;
+    pthread_mutex_unlock(&inodeLocksCR);
+
+    if (mode == SOFS_LOCK_WRITE)
+        pthread_rwlock_wrlock(&il->rw);
+    else
+        pthread_rwlock_rdlock(&il->rw);
+    return il;
+}
+
+/* ***************************************************** */
+
+SOInodeLock *sofs_enter(const char *path, int mode)
+{
+    if (mode == SOFS_LOCK_NAMESPACE)
+    {
+        pthread_rwlock_wrlock(&namespaceLock);
+        return NULL;
+    }
+    pthread_rwlock_rdlock(&namespaceLock);
+
+    /* the namespace can not change from now on, so the inode number remains valid */
+    std::string cpath(path);
+    uint32_t in;
+    try
+    {
+        in = soTraversePath(&cpath[0]);
+    }
+    catch (SOException & err)
+    {
+        return NULL;
+    }
+
+    return sofs_lock_inode(in, mode);
+}
+
+/* ***************************************************** */
+
+SOInodeLock *sofs_enter_inode(uint32_t in, int mode)
+{
+    if (mode == SOFS_LOCK_NAMESPACE)
+    {
+        pthread_rwlock_wrlock(&namespaceLock);
+        return NULL;
+    }
+    pthread_rwlock_rdlock(&namespaceLock);
+
+    return sofs_lock_inode(in, mode);
+}
+
+/* ***************************************************** */
+
+uint32_t sofs_locked_inode(const SOInodeLock *il)
+{
+    return il->in;
+}
+
+/* ***************************************************** */
+
+void sofs_leave(SOInodeLock *il)
+{
+    if (il != NULL)
+    {
+        pthread_rwlock_unlock(&il->rw);
+
+        /* the lock is dropped when no other thread needs it */
+        pthread_mutex_lock(&inodeLocksCR);
+        if (--il->users == 0)
+        {
+            inodeLocks.erase(il->in);
+            pthread_rwlock_destroy(&il->rw);
+            delete il;
+        }
+        pthread_mutex_unlock(&inodeLocksCR);
+    }
+
+    pthread_rwlock_unlock(&namespaceLock);
+}
+
+/* ***************************************************** */
+
+/* ***************************************************** */
+
+/*
+ * flush old delayed blocks, old dirty inodes, and a superblock dirty for longer than
+ * its save interval, every second, until told to stop
+ */
+static void *sofs_flusher(void *arg)
+{
+    pthread_mutex_lock(&flusherCR);
+    while (not flusherStop)
+    {
+        struct timespec t;
+        clock_gettime(CLOCK_REALTIME, &t);
+        t.tv_sec += 1;
+        pthread_cond_timedwait(&flusherWake, &flusherCR, &t);
+        if (flusherStop)
+            break;
+        pthread_mutex_unlock(&flusherCR);
+
+        /* the inodes are flushed with no operation going on */
+        if (soDelayedBlockCount() != 0)
+        {
+            SOInodeLock *il = sofs_enter_inode(0, SOFS_LOCK_NAMESPACE);
+            soFlushAllOldDelayedBlocks();
+            sofs_leave(il);
+        }
+
+        /*
+         * the superblock and the inodes are also written out of the raw block cache;
+         * on failure they stay dirty, and are tried again on the next wake up
+         */
+        try
+        {
+            bool flushed = soITFlushOldInodes();
+            if (soSBFlushOld() or flushed)
+                soSyncRawDisk();
+        }
+        catch (SOException & err)
+        {
+        }
+        pthread_mutex_lock(&flusherCR);
+    }
+    pthread_mutex_unlock(&flusherCR);
+    return NULL;
+}
+
+/* ***************************************************** */
+
+void sofs_start_flusher()
+{
+    pthread_mutex_lock(&flusherCR);
+    if (not flusherRunning)
+    {
+        flusherStop = false;
+        flusherRunning = (pthread_create(&flusher, NULL, sofs_flusher, NULL) == 0);
+    }
+    pthread_mutex_unlock(&flusherCR);
+}
+
+/* ***************************************************** */
+
+void sofs_stop_flusher()
+{
+    pthread_mutex_lock(&flusherCR);
+    bool running = flusherRunning;
+    flusherStop = true;
+    flusherRunning = false;
+    pthread_cond_signal(&flusherWake);
+    pthread_mutex_unlock(&flusherCR);
+
+    if (running)
+        pthread_join(flusher, NULL);
+}
+
+/* ***************************************************** */
@@ -0,0 +1,371 @@
+/**
+ *  \defgroup sofsstress sofsstress
+ *  \ingroup tools
+ *  \brief The \b sofs18 concurrency stress program.
+ *
+ *  \details
+ *      It measures how the throughput of a mounted file system scales
+ *      with the number of threads using it.<br/>
+ *      In the \c read test, each thread reads its own file over and over;
+ *      in the \c stat test, all threads get the attributes of the same file;
+ *      in the \c mixed test, one thread reads a file while the others
+ *      get the attributes of other files.
+ *      Each test runs for a fixed time, for each number of threads given.
+ *
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <libgen.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <vector>
+
+/*
+ * print help message
+ */
+static void printUsage(char *cmd_name)
+{
+    printf("Sinopsis: %s [ OPTION ] directory\n"
+           "  OPTIONS:\n"
+           "  -t list    --- comma separated list of numbers of threads (default: 1,2,4,8)\n"
+           "  -s num     --- size of each test file, in KiB (default: 1024)\n"
+           "  -b num     --- size of each read, in KiB (default: 64)\n"
+           "  -d num     --- duration of each run, in seconds (default: 5)\n"
+           "  -o list    --- comma separated list of tests: read, stat, mixed\n"
+           "                 (default: read,stat,mixed)\n"
+           "  -k         --- keep the test files (default: remove them at the end)\n"
+           "  -h         --- print this help\n", cmd_name);
+}
+
+/* print error message */
+static void printError(int errcode, const char *what, char *cmd_name)
+{
+    fprintf(stderr, "%s: %s: error #%d - %s.\n", cmd_name, what, errcode,
+        strerror(errcode));
+}
+
+/* ***************************************************** */
+
+/* kinds of work a thread can do */
+#define WORK_READ 0
+#define WORK_STAT 1
+
+/* what a thread does, and what it achieved */
+struct SOStressThread
+{
+    pthread_t tid;
+    int work;                   ///< WORK_READ or WORK_STAT
+    std::string path;           ///< file to work on
+    uint32_t bsize;             ///< size of each read
+    uint64_t ops;               ///< number of operations done
+    uint64_t bytes;             ///< number of bytes read
+    int err;                    ///< errno of the first failure, 0 if none
+};
+
+static std::atomic<bool> running;   ///< cleared when the run time is over
+
+/* ***************************************************** */
+
+/* the body of a thread */
+static void *stressThread(void *arg)
+{
+    SOStressThread *st = (SOStressThread *)arg;
+
+    if (st->work == WORK_STAT)
+    {
+        struct stat sb;
+        while (running)
+        {
+            if (stat(st->path.c_str(), &sb) == -1)
+            {
+                st->err = errno;
+                break;
+            }
+            st->ops++;
+        }
+        return NULL;
+    }
+
+    int fd = open(st->path.c_str(), O_RDONLY);
+    if (fd == -1)
+    {
+        st->err = errno;
+        return NULL;
+    }
+    std::vector<char> buf(st->bsize);
+    off_t pos = 0;
+    while (running)
+    {
+        ssize_t n = pread(fd, buf.data(), st->bsize, pos);
+        if (n == -1)
+        {
+            st->err = errno;
+            break;
+        }
+        st->ops++;
+        st->bytes += n;
+        pos = (n < (ssize_t)st->bsize) ? 0 : pos + n;
+    }
+    close(fd);
+    return NULL;
+}
+
+/* ***************************************************** */
+
+/* create a test file, filled with a pattern; return 0 or an errno */
+static int makeFile(const std::string & path, uint32_t size)
+{
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1)
+        return errno;
+
+    std::vector<char> buf(64 * 1024);
+    for (uint32_t i = 0; i < buf.size(); i++)
+        buf[i] = 'a' + i % 26;
+    for (uint32_t done = 0; done < size; )
+    {
+        uint32_t n = std::min((uint32_t)buf.size(), size - done);
+        if (write(fd, buf.data(), n) != (ssize_t)n)
+        {
+            int en = errno;
+            close(fd);
+            return en;
+        }
+        done += n;
+    }
+    if (close(fd) == -1)
+        return errno;
+    return 0;
+}
+
+/* ***************************************************** */
+
+/*
+ * run a test with nthreads threads for duration seconds, printing the throughput;
+ * return 0 or the errno of the first failure
+ */
+static int runOnce(const char *test, const std::vector<std::string> & files,
+        uint32_t nthreads, uint32_t bsize, uint32_t duration)
+{
+    std::vector<SOStressThread> threads(nthreads);
+    for (uint32_t i = 0; i < nthreads; i++)
+    {
+        SOStressThread & st = threads[i];
+        if (strcmp(test, "read") == 0)
+        {
+            st.work = WORK_READ;
+            st.path = files[i];
+        }
+        else if (strcmp(test, "stat") == 0)
+        {
+            st.work = WORK_STAT;
+            st.path = files[0];
+        }
+        else
+        {
+            st.work = (i == 0) ? WORK_READ : WORK_STAT;
+            st.path = files[i];
+        }
+        st.bsize = bsize;
+        st.ops = st.bytes = 0;
+        st.err = 0;
+    }
+
+    struct timespec t0, t1;
+    running = true;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (uint32_t i = 0; i < nthreads; i++)
+        if ((errno = pthread_create(&threads[i].tid, NULL, stressThread, &threads[i])) != 0)
+        {
+            running = false;
+            for (uint32_t j = 0; j < i; j++)
+                pthread_join(threads[j].tid, NULL);
+            return errno;
+        }
+    sleep(duration);
+    running = false;
+    for (uint32_t i = 0; i < nthreads; i++)
+        pthread_join(threads[i].tid, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+    /* read and stat operations are accounted separately */
+    uint64_t rops = 0, sops = 0, bytes = 0;
+    for (uint32_t i = 0; i < nthreads; i++)
+    {
+        if (threads[i].err != 0)
+            return threads[i].err;
+        if (threads[i].work == WORK_READ)
+            rops += threads[i].ops;
+        else
+            sops += threads[i].ops;
+        bytes += threads[i].bytes;
+    }
+
+    printf("%-6s %8" PRIu32 " %12.0f %12.2f %12.0f\n", test, nthreads,
+            rops / secs, bytes / secs / (1024 * 1024), sops / secs);
+    return 0;
+}
+
+/* ***************************************************** */
+
+/* The main function */
+
+int main(int argc, char *argv[])
+{
+    /* process command line options */
+    int opt;
+    const char *tlist = "1,2,4,8";
+    const char *olist = "read,stat,mixed";
+    uint32_t fsize = 1024;
+    uint32_t bsize = 64;
+    uint32_t duration = 5;
+    bool keep = false;
+
+    while ((opt = getopt(argc, argv, "t:s:b:d:o:kh")) != -1)
+    {
+        switch (opt)
+        {
+            case 't':
+            {
+                tlist = optarg;
+                break;
+            }
+            case 's':
+            {
+                fsize = atoi(optarg);
+                if (fsize == 0)
+                {
+                    fprintf(stderr, "%s: Bad argument to 's' option.\n", basename(argv[0]));
+                    printUsage(basename(argv[0]));
+                    return EXIT_FAILURE;
+                }
+                break;
+            }
+            case 'b':
+            {
+                bsize = atoi(optarg);
+                if (bsize == 0)
+                {
+                    fprintf(stderr, "%s: Bad argument to 'b' option.\n", basename(argv[0]));
+                    printUsage(basename(argv[0]));
+                    return EXIT_FAILURE;
+                }
+                break;
+            }
+            case 'd':
+            {
+                duration = atoi(optarg);
+                if (duration == 0)
+                {
+                    fprintf(stderr, "%s: Bad argument to 'd' option.\n", basename(argv[0]));
+                    printUsage(basename(argv[0]));
+                    return EXIT_FAILURE;
+                }
+                break;
+            }
+            case 'o':
+            {
+                olist = optarg;
+                break;
+            }
+            case 'k':
+            {
+                keep = true;
+                break;
+            }
+            case 'h':
+            {
+                printUsage(basename(argv[0]));
+                return EXIT_SUCCESS;
+            }
+            default:
+            {
+                fprintf(stderr, "%s: Wrong option.\n", basename(argv[0]));
+                printUsage(basename(argv[0]));
+                return EXIT_FAILURE;
+            }
+        }
+    }
+
+    /* check existence of mandatory argument: directory */
+    if ((argc - optind) != 1)
+    {
+        fprintf(stderr, "%s: Wrong number of mandatory arguments.\n", basename(argv[0]));
+        printUsage(basename(argv[0]));
+        return EXIT_FAILURE;
+    }
+    std::string dir(argv[optind]);
+
+    /* parse the lists */
+    std::vector<uint32_t> nthreads;
+    char tbuf[strlen(tlist) + 1];
+    strcpy(tbuf, tlist);
+    uint32_t maxthreads = 0;
+    for (char *tok = strtok(tbuf, ","); tok != NULL; tok = strtok(NULL, ","))
+    {
+        uint32_t n = atoi(tok);
+        if (n == 0)
+        {
+            fprintf(stderr, "%s: Bad argument to 't' option.\n", basename(argv[0]));
+            printUsage(basename(argv[0]));
+            return EXIT_FAILURE;
+        }
+        nthreads.push_back(n);
+        maxthreads = std::max(maxthreads, n);
+    }
+    std::vector<std::string> tests;
+    char obuf[strlen(olist) + 1];
+    strcpy(obuf, olist);
+    for (char *tok = strtok(obuf, ","); tok != NULL; tok = strtok(NULL, ","))
+    {
+        if (strcmp(tok, "read") != 0 and strcmp(tok, "stat") != 0 and strcmp(tok, "mixed") != 0)
+        {
+            fprintf(stderr, "%s: Bad argument to 'o' option.\n", basename(argv[0]));
+            printUsage(basename(argv[0]));
+            return EXIT_FAILURE;
+        }
+        tests.push_back(tok);
+    }
+
+    /* one file per thread */
+    std::vector<std::string> files;
+    for (uint32_t i = 0; i < maxthreads; i++)
+    {
+        char name[32];
+        sprintf(name, "/stress%03" PRIu32, i);
+        files.push_back(dir + name);
+        int en = makeFile(files.back(), fsize * 1024);
+        if (en != 0)
+        {
+            printError(en, files.back().c_str(), basename(argv[0]));
+            return EXIT_FAILURE;
+        }
+    }
+
+    /* run the tests */
+    int en = 0;
+    printf("%-6s %8s %12s %12s %12s\n", "test", "threads", "reads/s", "MiB/s", "stats/s");
+    for (uint32_t k = 0; k < tests.size() and en == 0; k++)
+        for (uint32_t i = 0; i < nthreads.size() and en == 0; i++)
+            en = runOnce(tests[k].c_str(), files, nthreads[i], bsize * 1024, duration);
+    if (en != 0)
+        printError(en, "test run", basename(argv[0]));
+
+    if (not keep)
+        for (uint32_t i = 0; i < files.size(); i++)
+            unlink(files[i].c_str());
+
+    return (en == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
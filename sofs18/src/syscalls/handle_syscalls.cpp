@@ -0,0 +1,493 @@
+/*
+ *  \brief System calls on open files
+ *
+ *  The inode of an open file is kept open, so its attributes are at hand, and
+ *  the last file block translated is kept in a cursor, so small reads and writes
+ *  within the same block go straight to the data block.
+ *  Large transfers may also be mapped onto the support file, to be done without copies.
+ *  Blocks written for the first time are delayed (see soDelayFileBlock), so they are
+ *  allocated together when the file is flushed, on close or sync, or once they get old.
+ */
+
+#include "syscalls.h"
+
+#include "core.h"
+#include "dal.h"
+#include "fileblocks.h"
+#include "freelists.h"
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+
+namespace sofs18
+{
+
+    /* ********************************************************* */
+
+    /* maximum size of a file, in bytes */
+    static const uint64_t MaxFileSize = (uint64_t)BlockSize * (N_DIRECT
+            + N_INDIRECT * ReferencesPerBlock
+            + N_DOUBLE_INDIRECT * ReferencesPerBlock * ReferencesPerBlock);
+
+    /* ********************************************************* */
+
+    /* translate file block fbn of an open file, through its cursor */
+    static uint32_t soHandleGetBlock(SOOpenFile *of, uint32_t fbn)
+    {
+        std::lock_guard<std::mutex> guard(of->cursorLock);
+
+        /* the version is got first, so a change made meanwhile is noticed next time */
+        uint64_t version = soBlockMapVersion(of->in);
+        if (fbn != of->cfbn or version != of->cversion)
+        {
+            of->cbn = soGetFileBlock(of->ih, fbn);
+            of->cfbn = fbn;
+            of->cversion = version;
+        }
+        return of->cbn;
+    }
+
+    /* ********************************************************* */
+
+    /*
+     * reserve data blocks for the file blocks of [pos, pos + count) that extend the file,
+     * so they are laid out sequentially on disk
+     */
+    static void soHandleReserve(SOOpenFile *of, uint32_t count, int32_t pos)
+    {
+        uint32_t start = std::max((uint32_t)pos, of->ip->size);
+        if (count == 0 or start >= pos + count)
+            return;
+        uint32_t ffbn = start / BlockSize;
+        soReserveFileBlocks(of->ih, ffbn, (pos + count - 1) / BlockSize - ffbn + 1);
+    }
+
+    /* ********************************************************* */
+
+    int soOpenHandle(uint32_t in, int flags, SOOpenFile **ofp)
+    {
+        soProbe(131, "%s(%u, %x, %p)\n", __FUNCTION__, in, flags, ofp);
+
+        if (ofp == NULL)
+            return -EINVAL;
+
+        int access;
+        switch (flags & O_ACCMODE)
+        {
+            case O_RDONLY: access = R_OK; break;
+            case O_WRONLY: access = W_OK; break;
+            default: access = R_OK | W_OK; break;
+        }
+
+        try
+        {
+            int ih = soITOpenInode(in);
+            int ret = 0;
+            try
+            {
+                SOInode *ip = soITGetInodePointer(ih);
+                if ((ip->mode & S_IFMT) == S_IFDIR and (access & W_OK))
+                    ret = -EISDIR;
+                else if (not soCheckInodeAccess(ih, access))
+                    ret = -EACCES;
+                else
+                {
+                    SOOpenFile *of = new SOOpenFile;
+                    of->in = in;
+                    of->ih = ih;
+                    of->ip = ip;
+                    of->flags = flags;
+                    of->cfbn = of->cbn = NullReference;
+                    of->cversion = 0;
+                    *ofp = of;
+                }
+            }
+            catch (SOException & err)
+            {
+                soITCloseInode(ih);
+                throw;
+            }
+
+            /* on success, the inode is kept open */
+            if (ret != 0)
+                soITCloseInode(ih);
+            return ret;
+        }
+        catch (SOException & err)
+        {
+            return -err.en;
+        }
+    }
+
+    /* ********************************************************* */
+
+    int soCloseHandle(SOOpenFile *of)
+    {
+        soProbe(132, "%s(%p)\n", __FUNCTION__, of);
+
+        if (of == NULL)
+            return -EINVAL;
+
+        /* the inode is closed even if the delayed blocks could not be flushed */
+        int ret = 0;
+        try
+        {
+            soFlushDelayedBlocks(of->ih);
+        }
+        catch (SOException & err)
+        {
+            ret = -err.en;
+        }
+        try
+        {
+            soITCloseInode(of->ih);
+        }
+        catch (SOException & err)
+        {
+            if (ret == 0)
+                ret = -err.en;
+        }
+        delete of;
+        return ret;
+    }
+
+    /* ********************************************************* */
+
+    int soReadHandle(SOOpenFile *of, void *buff, uint32_t count, int32_t pos)
+    {
+        soProbe(133, "%s(%p, %p, %u, %d)\n", __FUNCTION__, of, buff, count, pos);
+
+        if (of == NULL or (buff == NULL and count > 0) or pos < 0)
+            return -EINVAL;
+
+        try
+        {
+            SOInode *ip = of->ip;
+            if ((ip->mode & S_IFMT) == S_IFDIR)
+                return -EISDIR;
+            if ((uint32_t)pos >= ip->size)
+                return 0;
+            count = std::min(count, ip->size - pos);
+
+            /*
+             * runs of whole blocks are read together, the others through the cursor;
+             * if there are no whole blocks, readahead is left to be told here
+             */
+            uint8_t *buf = (uint8_t *)buff;
+            uint8_t block[BlockSize];
+            bool whole = false;
+            uint32_t done = 0;
+            while (done < count)
+            {
+                uint32_t fbn = (pos + done) / BlockSize;
+                uint32_t off = (pos + done) % BlockSize;
+                uint32_t n = std::min(BlockSize - off, count - done);
+                if (n == BlockSize)
+                {
+                    uint32_t nblocks = (count - done) / BlockSize;
+                    soReadFileBlocks(of->ih, fbn, nblocks, buf + done);
+                    n = nblocks * BlockSize;
+                    whole = true;
+                }
+                else
+                {
+                    uint32_t bn = soHandleGetBlock(of, fbn);
+                    if (bn != NullReference)
+                        soReadDataBlock(bn, block);
+                    else if (soReadDelayedBlocks(of->ih, fbn, 1, block) == 0)
+                        memset(block, '\0', BlockSize);
+                    memcpy(buf + done, block + off, n);
+                }
+                done += n;
+            }
+            if (not whole)
+            {
+                uint32_t ffbn = pos / BlockSize;
+                soReadAhead(of->ih, ffbn, (pos + count - 1) / BlockSize - ffbn + 1);
+            }
+
+            /* other readers may share the inode, so it is only touched */
+            soITTouchInode(of->ih);
+            return count;
+        }
+        catch (SOException & err)
+        {
+            return -err.en;
+        }
+    }
+
+    /* ********************************************************* */
+
+    int soWriteHandle(SOOpenFile *of, void *buff, uint32_t count, int32_t pos)
+    {
+        soProbe(134, "%s(%p, %p, %u, %d)\n", __FUNCTION__, of, buff, count, pos);
+
+        if (of == NULL or (buff == NULL and count > 0) or pos < 0)
+            return -EINVAL;
+        if ((uint64_t)pos + count > MaxFileSize)
+            return -EFBIG;
+
+        try
+        {
+            SOInode *ip = of->ip;
+            if ((ip->mode & S_IFMT) == S_IFDIR)
+                return -EISDIR;
+
+            /*
+             * blocks already mapped are written directly;
+             * the others are delayed, or else allocated on the way,
+             * with their missing part filled with zeros
+             */
+            uint8_t *buf = (uint8_t *)buff;
+            uint8_t block[BlockSize];
+            uint32_t done = 0;
+            bool reserved = false;
+            while (done < count)
+            {
+                uint32_t fbn = (pos + done) / BlockSize;
+                uint32_t off = (pos + done) % BlockSize;
+                uint32_t n = std::min(BlockSize - off, count - done);
+                uint32_t bn = soHandleGetBlock(of, fbn);
+                uint8_t *data = buf + done;
+                if (n != BlockSize)
+                {
+                    if (bn != NullReference)
+                        soReadDataBlock(bn, block);
+                    else if (soReadDelayedBlocks(of->ih, fbn, 1, block) == 0)
+                        memset(block, '\0', BlockSize);
+                    memcpy(block + off, buf + done, n);
+                    data = block;
+                }
+
+                if (bn != NullReference)
+                    soWriteDataBlock(bn, data);
+                else if (not soDelayFileBlock(of->ih, fbn, data))
+                {
+                    if (not reserved)
+                    {
+                        soHandleReserve(of, count - done, pos + done);
+                        reserved = true;
+                    }
+                    soWriteFileBlock(of->ih, fbn, data);
+                }
+                done += n;
+            }
+            soReleaseDataBlocks();
+            soFlushOldDelayedBlocks(of->ih);
+
+            if (pos + count > ip->size)
+                ip->size = pos + count;
+            ip->mtime = ip->ctime = time(NULL);
+            soITSaveInode(of->ih);
+            return count;
+        }
+        catch (SOException & err)
+        {
+            soReleaseDataBlocks();
+            return -err.en;
+        }
+    }
+
+    /* ********************************************************* */
+
+    int soTruncateHandle(SOOpenFile *of, off_t length)
+    {
+        soProbe(135, "%s(%p, %u)\n", __FUNCTION__, of, (uint32_t) length);
+
+        if (of == NULL or length < 0)
+            return -EINVAL;
+        if ((uint64_t)length > MaxFileSize)
+            return -EFBIG;
+
+        try
+        {
+            SOInode *ip = of->ip;
+            if ((ip->mode & S_IFMT) == S_IFDIR)
+                return -EISDIR;
+
+            /*
+             * blocks past the new end are freed, and the tail of the last one is cleaned,
+             * so the file reads zeros there if it grows again
+             */
+            if (length < ip->size)
+            {
+                soFreeFileBlocks(of->ih, (length + BlockSize - 1) / BlockSize);
+                uint32_t off = length % BlockSize;
+                if (off != 0)
+                {
+                    uint32_t bn = soGetFileBlock(of->ih, length / BlockSize);
+                    if (bn != NullReference)
+                    {
+                        uint8_t block[BlockSize];
+                        soReadDataBlock(bn, block);
+                        memset(block + off, '\0', BlockSize - off);
+                        soWriteDataBlock(bn, block);
+                    }
+                }
+            }
+
+            ip->size = length;
+            ip->mtime = ip->ctime = time(NULL);
+            soITSaveInode(of->ih);
+            return 0;
+        }
+        catch (SOException & err)
+        {
+            return -err.en;
+        }
+    }
+
+    /* ********************************************************* */
+
+    int soFsyncHandle(SOOpenFile *of)
+    {
+        soProbe(136, "%s(%p)\n", __FUNCTION__, of);
+
+        if (of == NULL)
+            return -EINVAL;
+
+        try
+        {
+            soFlushDelayedBlocks(of->ih);
+            soSyncDisk();
+            return 0;
+        }
+        catch (SOException & err)
+        {
+            return -err.en;
+        }
+    }
+
+    /* ********************************************************* */
+
+    int soMapHandle(SOOpenFile *of, uint32_t count, int32_t pos, bool write,
+            std::vector<SODataRange> & ranges)
+    {
+        soProbe(137, "%s(%p, %u, %d, %d, %p)\n", __FUNCTION__, of, count, pos, write, &ranges);
+
+        ranges.clear();
+        if (of == NULL or pos < 0)
+            return -EINVAL;
+        if (write and (pos % BlockSize != 0 or count % BlockSize != 0))
+            return -EINVAL;
+        if (write and (uint64_t)pos + count > MaxFileSize)
+            return -EFBIG;
+
+        try
+        {
+            SOInode *ip = of->ip;
+            if ((ip->mode & S_IFMT) == S_IFDIR)
+                return -EISDIR;
+            if (not write)
+            {
+                if ((uint32_t)pos >= ip->size)
+                    return 0;
+                count = std::min(count, ip->size - pos);
+            }
+            if (count == 0)
+                return 0;
+
+            /*
+             * the blocks are translated, or allocated, first;
+             * delayed blocks have no place in the support file, so they are flushed
+             * before writing, while reads of them are left to soReadHandle
+             */
+            uint32_t ffbn = pos / BlockSize;
+            uint32_t nblocks = (pos + count - 1) / BlockSize - ffbn + 1;
+            std::vector<uint32_t> bns(nblocks);
+            if (not write and soReadDelayedBlocks(of->ih, ffbn, nblocks, NULL) > 0)
+                return -ENOTSUP;
+            if (write)
+            {
+                soFlushDelayedBlocks(of->ih);
+                soHandleReserve(of, count, pos);
+            }
+            for (uint32_t i = 0; i < nblocks; i++)
+            {
+                bns[i] = soHandleGetBlock(of, ffbn + i);
+                if (bns[i] == NullReference and write)
+                    bns[i] = soAllocFileBlock(of->ih, ffbn + i);
+            }
+            soReleaseDataBlocks();
+
+            /* then, runs of consecutive blocks, or of holes, make the ranges */
+            uint32_t off = pos % BlockSize;
+            uint32_t left = count;
+            uint32_t i = 0;
+            while (i < nblocks)
+            {
+                uint32_t j = i + 1;
+                if (bns[i] == NullReference)
+                    while (j < nblocks and bns[j] == NullReference)
+                        j++;
+                else
+                    while (j < nblocks and bns[j] == bns[j - 1] + 1)
+                        j++;
+
+                SODataRange r;
+                r.size = std::min(left, (j - i) * BlockSize - off);
+                r.fd = -1;
+                r.pos = 0;
+                if (bns[i] != NullReference)
+                {
+                    r.fd = soDataBlocksFd(bns[i], j - i, write, &r.pos);
+                    if (r.fd == -1)
+                    {
+                        ranges.clear();
+                        return -ENOTSUP;
+                    }
+                    r.pos += off;
+                }
+                ranges.push_back(r);
+
+                left -= r.size;
+                off = 0;
+                i = j;
+            }
+            return count;
+        }
+        catch (SOException & err)
+        {
+            soReleaseDataBlocks();
+            ranges.clear();
+            return -err.en;
+        }
+    }
+
+    /* ********************************************************* */
+
+    int soUnmapHandle(SOOpenFile *of, uint32_t count, int32_t pos, bool write)
+    {
+        soProbe(138, "%s(%p, %u, %d, %d)\n", __FUNCTION__, of, count, pos, write);
+
+        if (of == NULL or pos < 0)
+            return -EINVAL;
+
+        try
+        {
+            /* as done by soReadHandle and soWriteHandle */
+            SOInode *ip = of->ip;
+            if (not write)
+            {
+                soITTouchInode(of->ih);
+                return 0;
+            }
+
+            if (pos + count > ip->size)
+                ip->size = pos + count;
+            ip->mtime = ip->ctime = time(NULL);
+            soITSaveInode(of->ih);
+            return 0;
+        }
+        catch (SOException & err)
+        {
+            return -err.en;
+        }
+    }
+
+    /* ********************************************************* */
+
+};
@@ -0,0 +1,519 @@
+/*
+ *  \brief System calls on files given by inode number
+ *
+ *  They work on open inodes directly, through the dal, fileblocks and
+ *  direntries layers, so no path is ever resolved.
+ */
+
+#include "syscalls.h"
+
+#include "core.h"
+#include "dal.h"
+#include "fileblocks.h"
+#include "freelists.h"
+#include "direntries.h"
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+
+namespace sofs18
+{
+
+    /* ********************************************************* */
+
+    /* maximum size of a file, in bytes */
+    static const uint64_t MaxFileSize = (uint64_t)BlockSize * (N_DIRECT
+            + N_INDIRECT * ReferencesPerBlock
+            + N_DOUBLE_INDIRECT * ReferencesPerBlock * ReferencesPerBlock);
+
+    /* ********************************************************* */
+
+    int soLookup(uint32_t pin, const char *name, uint32_t *cinp)
+    {
+        soProbe(121, "%s(%u, \"%s\", %p)\n", __FUNCTION__, pin, name, cinp);
+
+        if (name == NULL or cinp == NULL)
+            return -EINVAL;
+        if (strlen(name) > SOFS18_MAX_NAME)
+            return -ENAMETOOLONG;
+
+        try
+        {
+            int pih = soITOpenInode(pin);
+            int ret = 0;
+            try
+            {
+                SOInode *ip = soITGetInodePointer(pih);
+                if ((ip->mode & S_IFMT) != S_IFDIR)
+                    ret = -ENOTDIR;
+                else if (not soCheckInodeAccess(pih, X_OK))
+                    ret = -EACCES;
+                else if ((*cinp = soGetDirEntry(pih, name)) == NullReference)
+                    ret = -ENOENT;
+            }
+            catch (SOException & err)
+            {
+                soITCloseInode(pih);
+                throw;
+            }
+            soITCloseInode(pih);
+            return ret;
+        }
+        catch (SOException & err)
+        {
+            return -err.en;
+        }
+    }
+
+    /* ********************************************************* */
+
+    /* fill st with the attributes of inode in */
+    static void soFillStat(uint32_t in, struct stat *st)
+    {
+        int ih = soITOpenInode(in);
+        SOInode *ip = soITGetInodePointer(ih);
+
+        memset(st, 0, sizeof(struct stat));
+        st->st_ino = in;
+        st->st_mode = ip->mode;
+        st->st_nlink = ip->lnkcnt;
+        st->st_uid = ip->owner;
+        st->st_gid = ip->group;
+        st->st_size = ip->size;
+        st->st_blksize = BlockSize;
+        st->st_blocks = ip->blkcnt * (BlockSize / 512);
+        /* readers may be updating it meanwhile (see soITTouchInode) */
+        st->st_atime = __atomic_load_n(&ip->atime, __ATOMIC_RELAXED);
+        st->st_mtime = ip->mtime;
+        st->st_ctime = ip->ctime;
+
+        soITCloseInode(ih);
+    }
+
+    /* ********************************************************* */
+
+    int soStatInode(uint32_t in, struct stat *st)
+    {
+        soProbe(122, "%s(%u, %p)\n", __FUNCTION__, in, st);
+
+        if (st == NULL)
+            return -EINVAL;
+
+        try
+        {
+            soFillStat(in, st);
+            return 0;
+        }
+        catch (SOException & err)
+        {
+            return -err.en;
+        }
+    }
+
+    /* ********************************************************* */
+
+    int soAccessInode(uint32_t in, int opRequested)
+    {
+        soProbe(123, "%s(%u, %x)\n", __FUNCTION__, in, opRequested);
+
+        try
+        {
+            int ih = soITOpenInode(in);
+            bool granted = (opRequested == F_OK) or soCheckInodeAccess(ih, opRequested);
+            soITCloseInode(ih);
+            return granted ? 0 : -EACCES;
+        }
+        catch (SOException & err)
+        {
+            return -err.en;
+        }
+    }
+
+    /* ********************************************************* */
+
+    /* read count bytes from position pos of an open inode, within its size */
+    static uint32_t soReadData(int ih, uint8_t *buf, uint32_t count, uint32_t pos)
+    {
+        SOInode *ip = soITGetInodePointer(ih);
+        if (pos >= ip->size)
+            return 0;
+        count = std::min(count, ip->size - pos);
+
+        uint8_t block[BlockSize];
+        uint32_t done = 0;
+        while (done < count)
+        {
+            uint32_t fbn = (pos + done) / BlockSize;
+            uint32_t off = (pos + done) % BlockSize;
+            uint32_t n = std::min(BlockSize - off, count - done);
+            if (n == BlockSize)
+                soReadFileBlock(ih, fbn, buf + done);
+            else
+            {
+                soReadFileBlock(ih, fbn, block);
+                memcpy(buf + done, block + off, n);
+            }
+            done += n;
+        }
+        return count;
+    }
+
+    /* ********************************************************* */
+
+    int soReadInode(uint32_t in, void *buff, uint32_t count, int32_t pos)
+    {
+        soProbe(124, "%s(%u, %p, %u, %d)\n", __FUNCTION__, in, buff, count, pos);
+
+        if (buff == NULL or pos < 0)
+            return -EINVAL;
+
+        try
+        {
+            int ih = soITOpenInode(in);
+            int ret;
+            try
+            {
+                SOInode *ip = soITGetInodePointer(ih);
+                if ((ip->mode & S_IFMT) == S_IFDIR)
+                    ret = -EISDIR;
+                else
+                {
+                    ret = soReadData(ih, (uint8_t *)buff, count, pos);
+                    soITTouchInode(ih);
+                }
+            }
+            catch (SOException & err)
+            {
+                soITCloseInode(ih);
+                throw;
+            }
+            soITCloseInode(ih);
+            return ret;
+        }
+        catch (SOException & err)
+        {
+            return -err.en;
+        }
+    }
+
+    /* ********************************************************* */
+
+    int soWriteInode(uint32_t in, void *buff, uint32_t count, int32_t pos)
+    {
+        soProbe(125, "%s(%u, %p, %u, %d)\n", __FUNCTION__, in, buff, count, pos);
+
+        if (buff == NULL or pos < 0)
+            return -EINVAL;
+        if ((uint64_t)pos + count > MaxFileSize)
+            return -EFBIG;
+
+        try
+        {
+            int ih = soITOpenInode(in);
+            int ret = count;
+            try
+            {
+                SOInode *ip = soITGetInodePointer(ih);
+                if ((ip->mode & S_IFMT) == S_IFDIR)
+                    ret = -EISDIR;
+                else
+                {
+                    /* partial blocks are merged with their current contents */
+                    uint8_t *buf = (uint8_t *)buff;
+                    uint8_t block[BlockSize];
+                    uint32_t done = 0;
+
+                    /* blocks extending the file are reserved together, to be laid out sequentially */
+                    uint32_t start = std::max((uint32_t)pos, ip->size);
+                    if (count > 0 and start < pos + count)
+                        soReserveFileBlocks(ih, start / BlockSize,
+                                (pos + count - 1) / BlockSize - start / BlockSize + 1);
+
+                    while (done < count)
+                    {
+                        uint32_t fbn = (pos + done) / BlockSize;
+                        uint32_t off = (pos + done) % BlockSize;
+                        uint32_t n = std::min(BlockSize - off, count - done);
+                        if (n == BlockSize)
+                            soWriteFileBlock(ih, fbn, buf + done);
+                        else
+                        {
+                            soReadFileBlock(ih, fbn, block);
+                            memcpy(block + off, buf + done, n);
+                            soWriteFileBlock(ih, fbn, block);
+                        }
+                        done += n;
+                    }
+
+                    soReleaseDataBlocks();
+
+                    if (pos + count > ip->size)
+                        ip->size = pos + count;
+                    ip->mtime = ip->ctime = time(NULL);
+                    soITSaveInode(ih);
+                }
+            }
+            catch (SOException & err)
+            {
+                soReleaseDataBlocks();
+                soITCloseInode(ih);
+                throw;
+            }
+            soITCloseInode(ih);
+            return ret;
+        }
+        catch (SOException & err)
+        {
+            return -err.en;
+        }
+    }
+
+    /* ********************************************************* */
+
+    int soReadlinkInode(uint32_t in, char *buff, size_t size)
+    {
+        soProbe(126, "%s(%u, %p, %u)\n", __FUNCTION__, in, buff, (uint32_t) size);
+
+        if (buff == NULL or size == 0)
+            return -EINVAL;
+
+        try
+        {
+            int ih = soITOpenInode(in);
+            int ret = 0;
+            try
+            {
+                SOInode *ip = soITGetInodePointer(ih);
+                if ((ip->mode & S_IFMT) != S_IFLNK)
+                    ret = -EINVAL;
+                else
+                {
+                    uint32_t n = soReadData(ih, (uint8_t *)buff, size - 1, 0);
+                    buff[n] = '\0';
+                }
+            }
+            catch (SOException & err)
+            {
+                soITCloseInode(ih);
+                throw;
+            }
+            soITCloseInode(ih);
+            return ret;
+        }
+        catch (SOException & err)
+        {
+            return -err.en;
+        }
+    }
+
+    /* ********************************************************* */
+
+    /* the filler, and its context, of the reading of an indexed directory */
+    struct SODirIndexRead
+    {
+        SODirFiller filler;
+        void *ctx;
+    };
+
+    /* pass a batch of entries of an indexed directory to the filler of soReaddirInode */
+    static int soReaddirIndexed(void *ctx, SODirEntry *de, int32_t *next, uint32_t n)
+    {
+        SODirIndexRead *r = (SODirIndexRead *)ctx;
+        for (uint32_t i = 0; i < n; i++)
+            if (r->filler(r->ctx, de[i].name, de[i].in, next[i]) != 0)
+                return 1;
+        return 0;
+    }
+
+    /* ********************************************************* */
+
+    int soReaddirInode(uint32_t in, int32_t pos, SODirFiller filler, void *ctx)
+    {
+        soProbe(127, "%s(%u, %d, %p, %p)\n", __FUNCTION__, in, pos, filler, ctx);
+
+        if (filler == NULL or pos < 0)
+            return -EINVAL;
+
+        try
+        {
+            int ih = soITOpenInode(in);
+            int ret = 0;
+            try
+            {
+                SOInode *ip = soITGetInodePointer(ih);
+                if ((ip->mode & S_IFMT) != S_IFDIR)
+                    ret = -ENOTDIR;
+                else if (not soCheckInodeAccess(ih, R_OK))
+                    ret = -EACCES;
+                else
+                {
+                    /*
+                     * each block is read once, from the entry at pos on;
+                     * an indexed directory only has "." and ".." in slots, the others
+                     * being read in hash order, as their slots change when leaves are split
+                     */
+                    bool indexed = soDirIndexed(ih);
+                    SODirEntry dir[DirentriesPerBlock];
+                    uint32_t slot = pos / sizeof(SODirEntry);
+                    uint32_t nslots = indexed ? 2 : ip->size / sizeof(SODirEntry);
+                    bool stop = false;
+                    while (slot < nslots and not stop)
+                    {
+                        soReadFileBlock(ih, slot / DirentriesPerBlock, dir);
+                        do
+                        {
+                            SODirEntry & de = dir[slot % DirentriesPerBlock];
+                            slot++;
+                            if (de.name[0] != '\0')
+                                stop = filler(ctx, de.name, de.in, slot * sizeof(SODirEntry)) != 0;
+                        } while (slot < nslots and slot % DirentriesPerBlock != 0 and not stop);
+                    }
+                    if (indexed and not stop)
+                    {
+                        SODirIndexRead r = { filler, ctx };
+                        soDirIndexReaddir(ih, std::max(pos, (int32_t)DIRINDEX_FIRST_POS),
+                                soReaddirIndexed, &r);
+                    }
+                }
+            }
+            catch (SOException & err)
+            {
+                soITCloseInode(ih);
+                throw;
+            }
+            soITCloseInode(ih);
+            return ret;
+        }
+        catch (SOException & err)
+        {
+            return -err.en;
+        }
+    }
+
+    /* ********************************************************* */
+
+    /* 
+     * load ahead the inode table blocks of the entries in use of dir, from first to end;
+     * inodes close enough to share, or to follow, a block are loaded in the same run
+     */
+    static void soPrefetchEntryInodes(SODirEntry dir[], uint32_t first, uint32_t end)
+    {
+        uint32_t ins[DirentriesPerBlock];
+        uint32_t n = 0;
+        for (uint32_t i = first; i < end; i++)
+            if (dir[i].name[0] != '\0')
+                ins[n++] = dir[i].in;
+        std::sort(ins, ins + n);
+
+        uint32_t i = 0;
+        while (i < n)
+        {
+            uint32_t j = i + 1;
+            while (j < n and ins[j] / InodesPerBlock <= ins[j - 1] / InodesPerBlock + 1)
+                j++;
+            soITPrefetchInodes(ins[i], ins[j - 1] - ins[i] + 1);
+            i = j;
+        }
+    }
+
+    /* ********************************************************* */
+
+    /* the filler, and its context, of the reading of an indexed directory with attributes */
+    struct SODirIndexReadPlus
+    {
+        SODirPlusFiller filler;
+        void *ctx;
+    };
+
+    /* pass a batch of entries of an indexed directory to the filler of soReaddirPlusInode */
+    static int soReaddirPlusIndexed(void *ctx, SODirEntry *de, int32_t *next, uint32_t n)
+    {
+        SODirIndexReadPlus *r = (SODirIndexReadPlus *)ctx;
+        for (uint32_t i = 0; i < n; i++)
+        {
+            if (i % DirentriesPerBlock == 0)
+                soPrefetchEntryInodes(de, i, std::min(n, i + (uint32_t)DirentriesPerBlock));
+            struct stat st;
+            soFillStat(de[i].in, &st);
+            if (r->filler(r->ctx, de[i].name, &st, next[i]) != 0)
+                return 1;
+        }
+        return 0;
+    }
+
+    /* ********************************************************* */
+
+    int soReaddirPlusInode(uint32_t in, int32_t pos, SODirPlusFiller filler, void *ctx)
+    {
+        soProbe(128, "%s(%u, %d, %p, %p)\n", __FUNCTION__, in, pos, filler, ctx);
+
+        if (filler == NULL or pos < 0)
+            return -EINVAL;
+
+        try
+        {
+            int ih = soITOpenInode(in);
+            int ret = 0;
+            try
+            {
+                SOInode *ip = soITGetInodePointer(ih);
+                if ((ip->mode & S_IFMT) != S_IFDIR)
+                    ret = -ENOTDIR;
+                else if (not soCheckInodeAccess(ih, R_OK))
+                    ret = -EACCES;
+                else
+                {
+                    /*
+                     * the inodes of the entries of a block are loaded before being read;
+                     * positions are those of soReaddirInode
+                     */
+                    bool indexed = soDirIndexed(ih);
+                    SODirEntry dir[DirentriesPerBlock];
+                    uint32_t slot = pos / sizeof(SODirEntry);
+                    uint32_t nslots = indexed ? 2 : ip->size / sizeof(SODirEntry);
+                    bool stop = false;
+                    while (slot < nslots and not stop)
+                    {
+                        uint32_t base = slot - slot % DirentriesPerBlock;
+                        uint32_t end = std::min((uint32_t)DirentriesPerBlock, nslots - base);
+                        soReadFileBlock(ih, base / DirentriesPerBlock, dir);
+                        soPrefetchEntryInodes(dir, slot - base, end);
+                        for (uint32_t i = slot - base; i < end and not stop; i++)
+                        {
+                            slot = base + i + 1;
+                            if (dir[i].name[0] != '\0')
+                            {
+                                struct stat st;
+                                soFillStat(dir[i].in, &st);
+                                stop = filler(ctx, dir[i].name, &st, slot * sizeof(SODirEntry)) != 0;
+                            }
+                        }
+                    }
+                    if (indexed and not stop)
+                    {
+                        SODirIndexReadPlus r = { filler, ctx };
+                        soDirIndexReaddir(ih, std::max(pos, (int32_t)DIRINDEX_FIRST_POS),
+                                soReaddirPlusIndexed, &r);
+                    }
+                }
+            }
+            catch (SOException & err)
+            {
+                soITCloseInode(ih);
+                throw;
+            }
+            soITCloseInode(ih);
+            return ret;
+        }
+        catch (SOException & err)
+        {
+            return -err.en;
+        }
+    }
+
+    /* ********************************************************* */
+
+};
@@ -25,6 +25,9 @@
 #include <utime.h>
 #include <libgen.h>
 
+#include <mutex>
+#include <vector>
+
 namespace sofs18
 {
 
@@ -655,6 +658,391 @@ namespace sofs18
     /** @} close group other_syscalls */
     /* ******************************************************************* */
 
+    /* ******************************************************************* */
+    /** 
+     * \defgroup inode_syscalls inode syscalls
+     * \brief System calls on files given by inode number
+     * \details They are meant for front ends that keep track of inode numbers,
+     *      such as the FUSE low-level interface, so that paths are not resolved again.
+     * @{ 
+     */
+    /* ******************************************************************* */
+
+    /**
+     *  \brief Look a name up in a directory.
+     *
+     *  \param pin number of the inode of the directory
+     *  \param name name of the entry
+     *  \param cinp pointer to where the number of the inode of the entry is to be stored
+     *
+     *  \remarks
+     *  - \c pin must be a directory, and traverse (x) permission on it is required
+     *
+     *  \return 0 on success; 
+     *      -errno in case of error,
+     *      being errno the system error that better represents the cause of failure
+     */
+    int soLookup(uint32_t pin, const char *name, uint32_t *cinp);
+
+    /* ******************************************************************* */
+
+    /**
+     *  \brief Get file status, given the inode number.
+     *
+     *  Same as soStat, but no path is resolved nor access checked.
+     *
+     *  \param in number of the inode
+     *  \param st pointer to a stat structure
+     *
+     *  \return 0 on success; 
+     *      -errno in case of error,
+     *      being errno the system error that better represents the cause of failure
+     */
+    int soStatInode(uint32_t in, struct stat *st);
+
+    /* ******************************************************************* */
+
+    /**
+     *  \brief Check real user's permissions for a file, given the inode number.
+     *
+     *  \param in number of the inode
+     *  \param opRequested operation to be performed:
+     *                    F_OK (check if file exists)
+     *                    a bitwise combination of R_OK, W_OK, and X_OK
+     *
+     *  \return 0 on success; 
+     *      -errno in case of error,
+     *      being errno the system error that better represents the cause of failure
+     */
+    int soAccessInode(uint32_t in, int opRequested);
+
+    /* ******************************************************************* */
+
+    /**
+     *  \brief Read data from a regular file, given the inode number.
+     *
+     *  Same as soRead, but access is not checked, as it is supposed to have been
+     *  when the file was opened.
+     *
+     *  \param in number of the inode
+     *  \param buff pointer to the buffer where data to be read is to be stored
+     *  \param count number of bytes to be read
+     *  \param pos starting [byte] position in the file data continuum where data is to be read from
+     *
+     *  \return the number of bytes read, on success; 
+     *      -errno in case of error,
+     *      being errno the system error that better represents the cause of failure
+     */
+    int soReadInode(uint32_t in, void *buff, uint32_t count, int32_t pos);
+
+    /* ******************************************************************* */
+
+    /**
+     *  \brief Write data into a regular file, given the inode number.
+     *
+     *  Same as soWrite, but access is not checked, as it is supposed to have been
+     *  when the file was opened.
+     *
+     *  \param in number of the inode
+     *  \param buff pointer to the buffer where data to be written is stored
+     *  \param count number of bytes to be written
+     *  \param pos starting [byte] position in the file data continuum where data is to be written into
+     *
+     *  \return the number of bytes written, on success; 
+     *      -errno in case of error,
+     *      being errno the system error that better represents the cause of failure
+     */
+    int soWriteInode(uint32_t in, void *buff, uint32_t count, int32_t pos);
+
+    /* ******************************************************************* */
+
+    /**
+     *  \brief Read the value of a symbolic link, given the inode number.
+     *
+     *  \param in number of the inode
+     *  \param buff pointer to the buffer where data to be read is to be stored
+     *  \param size buffer size in bytes
+     *
+     *  \return 0 on success; 
+     *      -errno in case of error,
+     *      being errno the system error that better represents the cause of failure
+     */
+    int soReadlinkInode(uint32_t in, char *buff, size_t size);
+
+    /* ******************************************************************* */
+
+    /**
+     *  \brief Function called by soReaddirInode for each entry of a directory.
+     *
+     *  \param ctx the context given to soReaddirInode
+     *  \param name name of the entry
+     *  \param in number of the inode of the entry
+     *  \param next position of the next entry, to resume reading from
+     *
+     *  \return 0, to go on; non-zero, to stop
+     */
+    typedef int (*SODirFiller)(void *ctx, const char *name, uint32_t in, int32_t next);
+
+    /**
+     *  \brief Read the entries of a directory, given the inode number.
+     *
+     *  The directory blocks are read once, from \c pos on, and each entry in use is
+     *  passed to \c filler, until the end of the directory or until \c filler asks to stop.
+     *  Positions are those of soReaddir, so they do not change when other entries
+     *  are added or deleted; in a directory with a hashed index, past "." and "..",
+     *  they are based on the hashes of the names (see soDirIndexReaddir), as entries
+     *  move when leaves are split.
+     *
+     *  \param in number of the inode of the directory
+     *  \param pos starting [byte] position in the directory
+     *  \param filler function called for each entry
+     *  \param ctx context passed to \c filler
+     *
+     *  \remarks
+     *  - read (r) permission on the directory is required
+     *
+     *  \return 0 on success; 
+     *      -errno in case of error,
+     *      being errno the system error that better represents the cause of failure
+     */
+    int soReaddirInode(uint32_t in, int32_t pos, SODirFiller filler, void *ctx);
+
+    /* ******************************************************************* */
+
+    /**
+     *  \brief Function called by soReaddirPlusInode for each entry of a directory.
+     *
+     *  \param ctx the context given to soReaddirPlusInode
+     *  \param name name of the entry
+     *  \param st attributes of the inode of the entry, as given by soStatInode
+     *  \param next position of the next entry, to resume reading from
+     *
+     *  \return 0, to go on; non-zero, to stop
+     */
+    typedef int (*SODirPlusFiller)(void *ctx, const char *name, const struct stat *st, int32_t next);
+
+    /**
+     *  \brief Read the entries of a directory, with their attributes, given the inode number.
+     *
+     *  As soReaddirInode, but the inode of each entry is also read; the inode table
+     *  blocks needed by the entries of a directory block are loaded together, before them.
+     *
+     *  \param in number of the inode of the directory
+     *  \param pos starting [byte] position in the directory
+     *  \param filler function called for each entry
+     *  \param ctx context passed to \c filler
+     *
+     *  \remarks
+     *  - read (r) permission on the directory is required
+     *
+     *  \return 0 on success; 
+     *      -errno in case of error,
+     *      being errno the system error that better represents the cause of failure
+     */
+    int soReaddirPlusInode(uint32_t in, int32_t pos, SODirPlusFiller filler, void *ctx);
+
+    /* ******************************************************************* */
+    /** @} close group inode_syscalls */
+    /* ******************************************************************* */
+
+    /* ******************************************************************* */
+    /** 
+     * \defgroup handle_syscalls handle syscalls
+     * \brief System calls on open files
+     * \details An open file keeps its inode open, so reading and writing it
+     *      neither resolve a path nor open the inode again.
+     * @{ 
+     */
+    /* ******************************************************************* */
+
+    struct SOInode;
+
+    /**
+     *  \brief An open file
+     */
+    struct SOOpenFile
+    {
+        uint32_t in;            ///< number of the inode
+        int ih;                 ///< inode handler, kept open while the file is
+        SOInode *ip;            ///< attributes, as kept in the table of open inodes
+        int flags;              ///< flags given to open
+
+        std::mutex cursorLock;  ///< access to the cursor by concurrent threads
+        uint32_t cfbn;          ///< block-map cursor: last file block translated,
+        uint32_t cbn;           ///< the data block it is mapped onto,
+        uint64_t cversion;      ///< and the version of the references it was got from
+    };
+
+    /* ******************************************************************* */
+
+    /**
+     *  \brief Open a file, given the inode number.
+     *
+     *  Read (r) and/or write (w) permission is checked as given by the access mode in \c flags.
+     *
+     *  \param in number of the inode
+     *  \param flags flags, as given to open
+     *  \param ofp pointer to where the open file is to be stored
+     *
+     *  \return 0 on success; 
+     *      -errno in case of error,
+     *      being errno the system error that better represents the cause of failure
+     */
+    int soOpenHandle(uint32_t in, int flags, SOOpenFile **ofp);
+
+    /* ******************************************************************* */
+
+    /**
+     *  \brief Close an open file.
+     *
+     *  Delayed blocks are flushed (see soFlushDelayedBlocks), and
+     *  the inode is written if this was its last open.
+     *  The error of a failed flush of the file not reported yet is returned;
+     *  blocks that could not be flushed are kept, to be flushed later.
+     *
+     *  \param of the open file, which is released
+     *
+     *  \return 0 on success; 
+     *      -errno in case of error,
+     *      being errno the system error that better represents the cause of failure
+     */
+    int soCloseHandle(SOOpenFile *of);
+
+    /* ******************************************************************* */
+
+    /**
+     *  \brief Read data from an open file.
+     *
+     *  Same as soReadInode.
+     *  The time of last access is set with soITTouchInode, so
+     *  the file can be read by several threads at once.
+     *
+     *  \param of the open file
+     *  \param buff pointer to the buffer where data to be read is to be stored
+     *  \param count number of bytes to be read
+     *  \param pos starting [byte] position in the file data continuum where data is to be read from
+     *
+     *  \return the number of bytes read, on success; 
+     *      -errno in case of error,
+     *      being errno the system error that better represents the cause of failure
+     */
+    int soReadHandle(SOOpenFile *of, void *buff, uint32_t count, int32_t pos);
+
+    /* ******************************************************************* */
+
+    /**
+     *  \brief Write data into an open file.
+     *
+     *  File blocks not allocated yet are delayed, if possible (see soDelayFileBlock);
+     *  those of the file are flushed once the oldest of them gets old.
+     *  The error of a failed flush of the file not reported yet is returned.
+     *
+     *  \param of the open file
+     *  \param buff pointer to the buffer where data to be written is stored
+     *  \param count number of bytes to be written
+     *  \param pos starting [byte] position in the file data continuum where data is to be written into
+     *
+     *  \return the number of bytes written, on success; 
+     *      -errno in case of error,
+     *      being errno the system error that better represents the cause of failure
+     */
+    int soWriteHandle(SOOpenFile *of, void *buff, uint32_t count, int32_t pos);
+
+    /* ******************************************************************* */
+
+    /**
+     *  \brief Truncate an open file to a specified length.
+     *
+     *  \param of the open file
+     *  \param length new size for the regular file
+     *
+     *  \return 0 on success; 
+     *      -errno in case of error,
+     *      being errno the system error that better represents the cause of failure
+     */
+    int soTruncateHandle(SOOpenFile *of, off_t length);
+
+    /* ******************************************************************* */
+
+    /**
+     *  \brief Synchronize an open file with storage.
+     *
+     *  Delayed blocks are flushed first, and the error of a failed flush of the file
+     *  not reported yet is returned.
+     *
+     *  \param of the open file
+     *
+     *  \return 0 on success; 
+     *      -errno in case of error,
+     *      being errno the system error that better represents the cause of failure
+     */
+    int soFsyncHandle(SOOpenFile *of);
+
+    /* ******************************************************************* */
+
+    /**
+     *  \brief A piece of the data of an open file, as kept in the support file
+     */
+    struct SODataRange
+    {
+        int fd;                 ///< descriptor of the support file, or -1 for a hole (zeros)
+        off_t pos;              ///< byte position in the support file
+        uint32_t size;          ///< number of bytes
+    };
+
+    /**
+     *  \brief Map data of an open file onto ranges of the support file.
+     *
+     *  The data can then be transferred directly between the support file and
+     *  other descriptors, through \c fd, without being copied through memory;
+     *  consecutive blocks of the file lying in consecutive blocks of the disk
+     *  make a single range.
+     *  For reading, the data is clipped at the end of the file, and holes are given
+     *  as ranges with no descriptor; -ENOTSUP is returned if there are delayed blocks.
+     *  For writing, \c pos and \c count must be multiples of the block size,
+     *  the delayed blocks of the file are flushed, and the blocks missing are allocated;
+     *  no data is written.
+     *  The ranges are only valid until the file is changed by other means,
+     *  and soUnmapHandle must be called once the transfer is done.
+     *
+     *  \param of the open file
+     *  \param count number of bytes to be mapped
+     *  \param pos starting [byte] position in the file data continuum
+     *  \param write true, if the data is to be written
+     *  \param ranges where the ranges are stored, in file order
+     *
+     *  \return the number of bytes mapped, on success; 
+     *      -ENOTSUP, if the access mode of the disk does not keep data in the support file,
+     *      or the data is not there yet
+     *      (missing blocks may have been allocated, so the data must then be written by other means);
+     *      -errno in case of other error,
+     *      being errno the system error that better represents the cause of failure
+     */
+    int soMapHandle(SOOpenFile *of, uint32_t count, int32_t pos, bool write,
+            std::vector<SODataRange> & ranges);
+
+    /* ******************************************************************* */
+
+    /**
+     *  \brief Account for a transfer done through the ranges given by soMapHandle.
+     *
+     *  The times and, for writing, the size of the file are updated.
+     *
+     *  \param of the open file
+     *  \param count number of bytes transferred
+     *  \param pos starting [byte] position in the file data continuum
+     *  \param write true, if the data was written
+     *
+     *  \return 0 on success; 
+     *      -errno in case of error,
+     *      being errno the system error that better represents the cause of failure
+     */
+    int soUnmapHandle(SOOpenFile *of, uint32_t count, int32_t pos, bool write);
+
+    /* ******************************************************************* */
+    /** @} close group handle_syscalls */
+    /* ******************************************************************* */
+
     /* ******************************************************************* */
     /** @} close group syscalls */
     /* ******************************************************************* */
@@ -3,6 +3,12 @@
  */
 
 #include "bin_syscalls.h"
+#include "dal.h"
+#include "fileblocks.h"
+#include "freelists.h"
+#include "core.h"
+
+#include <algorithm>
 
 namespace sofs18
 {
@@ -15,14 +21,48 @@ namespace sofs18
 
     int soCloseFileSystem(void)
     {
-        return bin::soCloseFileSystem();
+        /*
+         * delayed file blocks are given their place, and then
+         * blocks kept by the allocation groups go back to the free list;
+         * delayed blocks that could not be flushed are lost, but the disk is still closed
+         */
+        int ret = 0;
+        try
+        {
+            soFlushAllDelayedBlocks();
+        }
+        catch (SOException & err)
+        {
+            soDiscardAllDelayedBlocks();
+            ret = -err.en;
+        }
+        try
+        {
+            soReturnGroupBlocks();
+        }
+        catch (SOException & err)
+        {
+            if (ret == 0)
+                ret = -err.en;
+        }
+        int stat = bin::soCloseFileSystem();
+        return ret != 0 ? ret : stat;
     }
 
     /* ********************************************************* */
 
     int soStatFS(const char *path, struct statvfs *st)
     {
-        return bin::soStatFS(path, st);
+        int ret = bin::soStatFS(path, st);
+        if (ret != 0)
+            return ret;
+
+        /* blocks kept by the allocation groups are free, those to be taken by delayed blocks are not */
+        fsblkcnt_t cached = soGroupCachedBlocks();
+        fsblkcnt_t delayed = soDelayedBlockCount();
+        st->f_bfree = std::max(st->f_bfree + cached, delayed) - delayed;
+        st->f_bavail = std::max(st->f_bavail + cached, delayed) - delayed;
+        return 0;
     }
 
     /* ********************************************************* */
@@ -85,7 +125,20 @@ namespace sofs18
 
     int soFsync(const char *path)
     {
-        return bin::soFsync(path);
+        int ret = bin::soFsync(path);
+        if (ret != 0)
+            return ret;
+
+        /* write back blocks kept dirty in memory */
+        try
+        {
+            soSyncDisk();
+        }
+        catch (SOException & err)
+        {
+            return -err.en;
+        }
+        return 0;
     }
 
     /* ********************************************************* */
@@ -24,6 +24,9 @@
 
 #include "core.h"
 #include "dal.h"
+#include "rawdisk.h"
+#include "freelists.h"
+#include "fileblocks.h"
 
 using namespace sofs18;
 
@@ -51,7 +54,16 @@ static void printUsage(char *cmd_name)
            "  -w          --- set bin configuration to 0-0 (default)\n"
            "  -a num-num  --- add range of IDs to bin configuration\n"
            "  -r num-num  --- remove range of IDs from bin configuration\n"
-           "  -h          --- print this help\n", cmd_name);
+           "  -c num      --- set block cache size, in blocks (default: %u)\n"
+           "  -k num      --- set maximum readahead window, in blocks,\n"
+           "                  0 disables readahead (default: %u)\n"
+           "  -g num      --- set number of free blocks an allocation group takes at a time,\n"
+           "                  0 disables allocation groups (default: %u)\n"
+           "  -m mode     --- set disk access mode: file, mmap, uring, direct,\n"
+           "                  ram or ramtmp (changes not saved) (default: file)\n"
+           "  -E          --- map the blocks of new regular files with extents\n"
+           "  -h          --- print this help\n", cmd_name, RAWCACHE_DEFAULT_SIZE,
+           READAHEAD_DEFAULT_MAX, ALLOC_GROUP_DEFAULT_CACHE);
 }
 
 /* ******************************************** */
@@ -204,7 +216,7 @@ int main(int argc, char *argv[])
 
     /* process command line options */
     int opt;
-    while ((opt = getopt(argc, argv, "p:A:R:q:bwa:r:h")) != -1)
+    while ((opt = getopt(argc, argv, "p:A:R:q:bwa:r:c:k:g:m:Eh")) != -1)
     {
         switch (opt)
         {
@@ -295,6 +307,78 @@ int main(int argc, char *argv[])
                 soBinRemoveIDs(lower, upper);
                 break;
             }
+            case 'm':   /* disk access mode */
+            {
+                if (strcmp(optarg, "file") == 0)
+                    soSetRawDiskMode(RAWDISK_FILE);
+                else if (strcmp(optarg, "mmap") == 0)
+                    soSetRawDiskMode(RAWDISK_MMAP);
+                else if (strcmp(optarg, "uring") == 0)
+                    soSetRawDiskMode(RAWDISK_URING);
+                else if (strcmp(optarg, "direct") == 0)
+                    soSetRawDiskMode(RAWDISK_DIRECT);
+                else if (strcmp(optarg, "ram") == 0)
+                    soSetRawDiskMode(RAWDISK_RAM);
+                else if (strcmp(optarg, "ramtmp") == 0)
+                {
+                    soSetRawDiskMode(RAWDISK_RAM);
+                    soSetRawRamFlags(RAWRAM_LOAD);
+                }
+                else
+                {
+                    fprintf(stderr, "%s: Bad argument to 'm' option.\n", basename(argv[0]));
+                    printUsage(basename(argv[0]));
+                    return EXIT_FAILURE;
+                }
+                break;
+            }
+            case 'c':   /* block cache size */
+            {
+                uint32_t n;
+                uint32_t cnt = 0;
+                if ( (sscanf(optarg, "%u %n", &n, &cnt) != 1) 
+                        or (cnt != strlen(optarg)) )
+                {
+                    fprintf(stderr, "%s: Bad argument to 'c' option.\n", basename(argv[0]));
+                    printUsage(basename(argv[0]));
+                    return EXIT_FAILURE;
+                }
+                soSetRawCacheSize(n);
+                break;
+            }
+            case 'k':   /* readahead window */
+            {
+                uint32_t n;
+                uint32_t cnt = 0;
+                if ( (sscanf(optarg, "%u %n", &n, &cnt) != 1) 
+                        or (cnt != strlen(optarg)) )
+                {
+                    fprintf(stderr, "%s: Bad argument to 'k' option.\n", basename(argv[0]));
+                    printUsage(basename(argv[0]));
+                    return EXIT_FAILURE;
+                }
+                soSetReadAheadMax(n);
+                break;
+            }
+            case 'g':   /* allocation group refill size */
+            {
+                uint32_t n;
+                uint32_t cnt = 0;
+                if ( (sscanf(optarg, "%u %n", &n, &cnt) != 1) 
+                        or (cnt != strlen(optarg)) )
+                {
+                    fprintf(stderr, "%s: Bad argument to 'g' option.\n", basename(argv[0]));
+                    printUsage(basename(argv[0]));
+                    return EXIT_FAILURE;
+                }
+                soSetAllocGroupCache(n);
+                break;
+            }
+            case 'E':   /* extents */
+            {
+                soSetFileExtents(true);
+                break;
+            }
             case 'h':    /* help mode */
             {
                 printUsage(progName);
@@ -351,6 +435,7 @@ int main(int argc, char *argv[])
     /* close the unbuffered communication channel with the storage device */
     try
     {
+        soReturnGroupBlocks();
         soCloseDisk();
     }
     catch(SOException & err)
@@ -2,6 +2,7 @@
 
 #include "core.h"
 #include "dal.h"
+#include "freelists.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -273,6 +274,7 @@ void formatDisk(void)
     /* close disk */
     try
     {
+        soReturnGroupBlocks();
         soCloseDisk();
     }
     catch(SOException & err)
@@ -326,6 +328,9 @@ void showBlock(void)
     fscanf(fin, "%s", range);
     fPurge(fin);
 
+    /* make blocks kept dirty in memory visible to showblock */
+    soSyncDisk();
+
     /* call showblock */
     char cmd[1000];
     sprintf(cmd, "%s/showblock %s -%c %s", 
@@ -37,7 +37,8 @@ namespace sofs18
 				if(tmpBlk != NullReference) {
 					sofs18::soReadFileBlock(ih,blkNum,buff);
 				
-					for(uint32_t i = 2; i < DirentriesPerBlock; i++) {
+					/* only block 0 holds "." and ".." */
+					for(uint32_t i = (blkNum == 0 ? 2 : 0); i < DirentriesPerBlock; i++) {
 						if(strcmp(buff[i].name,"\0") != 0){
 							return false;
 						}
@@ -25,41 +25,48 @@ namespace sofs18
             /* change the following line by your code */
             //return bin::soTraversePath(path);
 
-            // solution by Maria João, student 84681 DETI - UA
-
-			//stop condition
-            if(strcmp(path, "/") == 0){
-            	return 0;
+            /*
+             * the path is walked one component at a time, from the root down,
+             * each one being looked up in the directory reached so far
+             */
+            uint32_t in = 0;
+            const char *p = path;
+            char name[SOFS18_MAX_NAME + 1];
+            while (true)
+            {
+                while (*p == '/')
+                    p++;
+                if (*p == '\0')
+                    return in;
+
+                size_t len = strcspn(p, "/");
+                if (len > SOFS18_MAX_NAME)
+                    throw SOException(ENAMETOOLONG, __FUNCTION__);
+                memcpy(name, p, len);
+                name[len] = '\0';
+                p += len;
+
+                int ih = soITOpenInode(in);
+                try
+                {
+                    /* the component must be within a directory that can be searched */
+                    SOInode *ip = soITGetInodePointer(ih);
+                    if ((ip->mode & S_IFMT) != S_IFDIR)
+                        throw SOException(ENOENT, __FUNCTION__);
+                    if (not sofs18::soCheckInodeAccess(ih, X_OK))
+                        throw SOException(EACCES, __FUNCTION__);
+
+                    in = sofs18::soGetDirEntry(ih, name);
+                    if (in == NullReference)
+                        throw SOException(ENOENT, __FUNCTION__);
+                }
+                catch (SOException & err)
+                {
+                    soITCloseInode(ih);
+                    throw;
+                }
+                soITCloseInode(ih);
             }
-
-            char * baseName = basename(strdupa(path));
-            char * dirName = dirname(strdupa(path));
-
-            uint32_t inp = soTraversePath(dirName);
-
-            //verify if is dir or symlink
-			uint32_t ih = soITOpenInode(inp);
-			SOInode * ip = soITGetInodePointer(ih);
-
-			if((ip->mode & S_IFDIR) != S_IFDIR){
-				throw SOException(ENOENT , __FUNCTION__);
-			}
-
-            //verify permissions of execution
-			if(!sofs18::soCheckInodeAccess(ih, X_OK)) {
-				throw SOException(EACCES , __FUNCTION__);
-			}
-
-			uint32_t in = soGetDirEntry(ih, baseName);
-
-			if((int)in < 0){
-				throw SOException(ENOENT , __FUNCTION__);
-			}
-
-            // close open inode
-            soITCloseInode(ih);
-
-			return in;
         }
 
     };
@@ -27,6 +27,8 @@ namespace sofs18
 
         void soReadFileBlock(int ih, uint32_t fbn, void *buf);
 
+        void soReadFileBlocks(int ih, uint32_t ffbn, uint32_t count, void *buf);
+
         void soWriteFileBlock(int ih, uint32_t fbn, void *buf);
 
     };
@@ -14,8 +14,8 @@ namespace sofs18
         /* ********************************************************* */
 
 
-        static uint32_t soGetIndirectFileBlock(SOInode * ip, uint32_t fbn);
-        static uint32_t soGetDoubleIndirectFileBlock(SOInode * ip, uint32_t fbn);
+        static uint32_t soGetIndirectFileBlock(uint32_t in, SOInode * ip, uint32_t fbn);
+        static uint32_t soGetDoubleIndirectFileBlock(uint32_t in, SOInode * ip, uint32_t fbn);
 
         /* ********************************************************* */
 
@@ -26,6 +26,7 @@ namespace sofs18
             /* change the following line by your code */
 
 			SOInode* ip = soITGetInodePointer(ih);
+			uint32_t in = soITGetInodeID(ih);
 			uint32_t IndirectBegin = N_DIRECT;
 			uint32_t DoubleIndirectBegin = (N_INDIRECT * ReferencesPerBlock) + IndirectBegin;
 			uint32_t DoubleIndirectEnd = (ReferencesPerBlock * ReferencesPerBlock * N_DOUBLE_INDIRECT) + DoubleIndirectBegin -1;
@@ -36,10 +37,10 @@ namespace sofs18
 					return ip->d[fbn];
 				}
 				else if(fbn < DoubleIndirectBegin){
-					return soGetIndirectFileBlock(ip,fbn-IndirectBegin);
+					return soGetIndirectFileBlock(in,ip,fbn-IndirectBegin);
 				}
 				else {
-					return soGetDoubleIndirectFileBlock(ip,fbn-DoubleIndirectBegin);
+					return soGetDoubleIndirectFileBlock(in,ip,fbn-DoubleIndirectBegin);
 				}
 
 			}
@@ -52,13 +53,12 @@ namespace sofs18
         /* ********************************************************* */
 
 
-        static uint32_t soGetIndirectFileBlock(SOInode * ip, uint32_t afbn)
+        static uint32_t soGetIndirectFileBlock(uint32_t in, SOInode * ip, uint32_t afbn)
         {
             soProbe(301, "%s(%d, ...)\n", __FUNCTION__, afbn);
 
             /* change the following line by your code */
 
-            uint32_t db[ReferencesPerBlock];
             uint32_t pos1=afbn / ReferencesPerBlock;
             uint32_t pos2= afbn % ReferencesPerBlock;
 
@@ -66,8 +66,8 @@ namespace sofs18
             	return NullReference;
             }
             else{
-                soReadDataBlock(ip->i1[pos1],&db);
-                return db[pos2];
+                /* the references come from the block map cache */
+                return soBlockMapGetRef(in, ip->i1[pos1], pos2);
             }
 
         }
@@ -75,13 +75,12 @@ namespace sofs18
         /* ********************************************************* */
 
 
-        static uint32_t soGetDoubleIndirectFileBlock(SOInode * ip, uint32_t afbn)
+        static uint32_t soGetDoubleIndirectFileBlock(uint32_t in, SOInode * ip, uint32_t afbn)
         {
             soProbe(301, "%s(%d, ...)\n", __FUNCTION__, afbn);
 
             /* change the following line by your code */
 
-            uint32_t db[ReferencesPerBlock];
             uint32_t pos1 = afbn / (ReferencesPerBlock*ReferencesPerBlock);
             uint32_t pos2 = afbn / ReferencesPerBlock-(pos1*ReferencesPerBlock);
             uint32_t pos3 = afbn  % ReferencesPerBlock;
@@ -90,14 +89,14 @@ namespace sofs18
             	return NullReference;
             }
             else{
-                soReadDataBlock(ip->i2[pos1],&db);
+                /* the references come from the block map cache */
+                uint32_t ref = soBlockMapGetRef(in, ip->i2[pos1], pos2);
 
-                if(db[pos2] == NullReference){
+                if(ref == NullReference){
                 	return NullReference;
                 }
                 else{
-                	soReadDataBlock(db[pos2],&db);
-                	return db[pos3];
+                	return soBlockMapGetRef(in, ref, pos3);
                 }
 
             }
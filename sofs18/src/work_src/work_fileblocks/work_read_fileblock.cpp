@@ -33,6 +33,42 @@ namespace sofs18
             }
         }
 
+        /* ********************************************************* */
+
+        void soReadFileBlocks(int ih, uint32_t ffbn, uint32_t count, void *buf)
+        {
+            soProbe(333, "%s(%d, %u, %u, %p)\n", __FUNCTION__, ih, ffbn, count, buf);
+
+            if (count == 0)
+                return;
+
+            uint8_t *p = (uint8_t *)buf;
+            uint32_t next = sofs18::soGetFileBlock(ih, ffbn);
+            uint32_t i = 0;
+            while (i < count)
+            {
+                /* 
+                 * grow the run while file blocks map onto contiguous data blocks,
+                 * or onto consecutive holes 
+                 */
+                uint32_t bn = next;
+                uint32_t n = 1;
+                for (; i + n < count; n++)
+                {
+                    next = sofs18::soGetFileBlock(ih, ffbn + i + n);
+                    if (next != (bn == NullReference ? NullReference : bn + n))
+                        break;
+                }
+
+                /* transfer the run */
+                if (bn == NullReference)
+                    memset(p + (size_t)i * BlockSize, 0, (size_t)n * BlockSize);
+                else
+                    soReadDataBlocks(bn, n, p + (size_t)i * BlockSize);
+                i += n;
+            }
+        }
+
     };
 
 };
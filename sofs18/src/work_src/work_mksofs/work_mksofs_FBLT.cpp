@@ -18,27 +18,35 @@ namespace sofs18
         {
             soProbe(605, "%s(%u, %u, %u)\n", __FUNCTION__, first_block, btotal, rdsize);
 
-            uint32_t blocktab [ReferencesPerBlock];
             uint32_t blocknumb = btotal / ReferencesPerBlock;
 
             if( btotal % ReferencesPerBlock != 0 ){
                 blocknumb = blocknumb+1;
             }
 
-            for(uint32_t i=0 ; i<blocknumb ; i++){
+            /* fill in the table in chunks, each written with a single disk operation */
+            const uint32_t chunk = 64;
+            uint32_t blocktab [chunk][ReferencesPerBlock];
 
-                for(uint32_t k=0 ; k<ReferencesPerBlock ; k++){
+            for(uint32_t i=0 ; i<blocknumb ; i+=chunk){
 
-					if( btotal > rdsize ){
-						blocktab[k] = rdsize++;
-					}
-					else{
-						blocktab [k] = NullReference;
-					}
+                uint32_t nb = (blocknumb - i < chunk) ? blocknumb - i : chunk;
+
+                for(uint32_t j=0 ; j<nb ; j++){
+
+                    for(uint32_t k=0 ; k<ReferencesPerBlock ; k++){
+
+                        if( btotal > rdsize ){
+                            blocktab[j][k] = rdsize++;
+                        }
+                        else{
+                            blocktab[j][k] = NullReference;
+                        }
+                    }
                 }
 
-                soWriteRawBlock(first_block,&blocktab);
-                first_block++;
+                soWriteRawBlocks(first_block, nb, blocktab);
+                first_block += nb;
             }
 
             return blocknumb;
@@ -20,12 +20,21 @@ namespace sofs18
             //bin::resetBlocks(first_block, cnt);
 
             // solution by Luis Moura, student 83808 DETI - UA
-            uint8_t reset [BlockSize];
-            memset(reset, 0, BlockSize);
+            /* 
+             * reset blocks in chunks, each written with a single disk operation;
+             * all chunks are submitted before waiting, so they can be in flight together
+             */
+            const uint32_t chunk = 64;
+            uint8_t reset [chunk * BlockSize];
+            memset(reset, 0, sizeof(reset));
             
-            for (; first_block < cnt; first_block++) {
-                soWriteRawBlock(first_block, &reset);
+            while (cnt > 0) {
+                uint32_t nb = (cnt < chunk) ? cnt : chunk;
+                soSubmitWriteRawBlocks(first_block, nb, reset);
+                first_block += nb;
+                cnt -= nb;
             }
+            soWaitRawBlocks();
             
         }
 